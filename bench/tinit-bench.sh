@@ -0,0 +1,198 @@
+#!/bin/bash -e
+#
+# Supervision benchmark suite.
+#
+# Requires bash 5 or later for EPOCHREALTIME, as well as init, svctl and
+# tinit-loadgen built with CONFIG_TINIT_BENCH enabled and with SYSCONFDIR /
+# RUNSTATEDIR pointing to a writable location, e.g.:
+#   make SYSCONFDIR=/tmp/tinit-bench/etc RUNSTATEDIR=/tmp/tinit-bench/run
+#
+# Synthesizes a set of services made of:
+# - a deep chain of services, each one starting once the previous is ready,
+# - a wide fan-out of services starting once a single root service is ready,
+# - crash-looping services exiting right after being spawned,
+# then measures boot-to-all-ready time, respawn latency, control request
+# throughput and shutdown time.
+
+usage()
+{
+	cat >&2 <<_EOF
+Usage: $(basename $0) [OPTIONS] INIT SVCTL SYSCONFDIR RUNSTATEDIR
+Run tinit benchmarks.
+
+With OPTIONS:
+    -d DEPTH    depth of starton chain (default: $depth)
+    -w WIDTH    width of fan-out (default: $width)
+    -c CRASH    number of crash-looping services (default: $crash)
+    -r REQS     number of control requests (default: $reqs)
+    -u          run init as PID 1 of a user + PID namespace
+    -l LOADGEN  path to tinit-loadgen used to load control socket
+    -P USEC     fail when loadgen 99th percentile latency exceeds USEC
+    -T RATE     fail when loadgen throughput is below RATE req/s
+_EOF
+}
+
+depth=32
+width=64
+crash=4
+reqs=1000
+userns=0
+loadgen=
+max_p99=
+min_rate=
+
+while getopts "d:w:c:r:ul:P:T:h" opt; do
+	case $opt in
+	d) depth=$OPTARG;;
+	w) width=$OPTARG;;
+	c) crash=$OPTARG;;
+	r) reqs=$OPTARG;;
+	u) userns=1;;
+	l) loadgen=$(realpath $OPTARG);;
+	P) max_p99=$OPTARG;;
+	T) min_rate=$OPTARG;;
+	h) usage; exit 0;;
+	*) usage; exit 1;;
+	esac
+done
+shift $((OPTIND - 1))
+
+if [ $# -ne 4 ]; then
+	usage
+	exit 1
+fi
+
+init=$(realpath $1)
+svctl=$(realpath $2)
+etcdir=$3/tinit
+rundir=$4
+
+# Current time in milliseconds, out of microseconds since Epoch whatever the
+# locale decimal separator is.
+now()
+{
+	local usec=${EPOCHREALTIME//[!0-9]/}
+
+	echo $((10#$usec / 1000))
+}
+
+# gen_svc NAME STARTON DAEMON...
+gen_svc()
+{
+	local name=$1
+	local starton=$2
+
+	shift 2
+	{
+		echo "name = \"$name\""
+		[ -n "$starton" ] && echo "starton = [ \"$starton\" ]"
+		printf 'daemon = [ "%s"' "$1"
+		shift
+		for arg in "$@"; do
+			printf ', "%s"' "$arg"
+		done
+		echo ' ]'
+	} > $etcdir/services/$name.conf
+	ln -s ../services/$name.conf $etcdir/current/$name
+}
+
+gen_svcs()
+{
+	local s
+	local prev=
+
+	rm -rf $etcdir
+	mkdir -p $etcdir/services $etcdir/current $rundir
+
+	for s in $(seq 0 $((depth - 1))); do
+		gen_svc chain$s "$prev" /bin/sleep 3600
+		prev=chain$s
+	done
+
+	gen_svc root "" /bin/sleep 3600
+	for s in $(seq 0 $((width - 1))); do
+		gen_svc fan$s root /bin/sleep 3600
+	done
+
+	for s in $(seq 0 $((crash - 1))); do
+		gen_svc crash$s "" /bin/false
+	done
+}
+
+# Number of services in ready state.
+count_ready()
+{
+	$svctl status '*' 2>/dev/null | grep -c ' ready' || true
+}
+
+gen_svcs
+expect=$((depth + 1 + width))
+
+echo "services: $depth chained, $width fanned out, $crash crash-looping"
+
+start=$(now)
+if [ $userns -eq 1 ]; then
+	unshare --user --map-root-user --pid --fork $init &
+else
+	$init &
+fi
+pid=$!
+
+while [ $(count_ready) -lt $expect ]; do
+	if ! kill -0 $pid 2>/dev/null; then
+		echo "init exited prematurely" >&2
+		exit 1
+	fi
+	sleep 0.01
+done
+echo "boot-to-all-ready: $(($(now) - start)) ms"
+
+# Let crash-loopers respawn a few times, then compute the mean delay between
+# process exit and next spawn from event records.
+sleep 5
+$svctl events | awk '
+/: exited \[/ { sub(/^\[ */, ""); sub(/\]/, "", $1); exit_ts[$2] = $1 }
+/: spawned \[/ {
+	sub(/^\[ */, ""); sub(/\]/, "", $1)
+	if ($2 in exit_ts) {
+		sum += $1 - exit_ts[$2]
+		cnt++
+		delete exit_ts[$2]
+	}
+}
+END {
+	if (cnt)
+		printf "respawn latency: %.3f ms (%d samples)\n",
+		       sum * 1000 / cnt, cnt
+}'
+
+start=$(now)
+for s in $(seq 1 $reqs); do
+	$svctl status chain0 >/dev/null
+done
+elapsed=$(($(now) - start))
+echo "control requests: $reqs in $elapsed ms" \
+     "($((reqs * 1000 / (elapsed + 1))) req/s, svctl spawn included)"
+
+# Concurrent control requests from long-lived clients, optionally gated
+# against latency / throughput regressions.
+gate=0
+if [ -n "$loadgen" ]; then
+	$loadgen -c 16 -n $reqs -o status,reload \
+	         ${max_p99:+-p $max_p99} ${min_rate:+-t $min_rate} chain0 || \
+	gate=1
+fi
+
+# When run from a namespace, init is the child of unshare.
+if [ $userns -eq 1 ]; then
+	ipid=$(pgrep -P $pid)
+else
+	ipid=$pid
+fi
+
+start=$(now)
+kill -TERM $ipid
+wait $pid || true
+echo "shutdown: $(($(now) - start)) ms"
+
+exit $gate
@@ -0,0 +1,498 @@
+#include "builtin.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pwd.h>
+#include <grp.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/mount.h>
+
+#define BUILTIN_DIR_MODE  (0755U)
+#define BUILTIN_FILE_MODE (0644U)
+
+/*
+ * Built-ins are run by PID 1 itself: none of them may block on a network
+ * service, a user space daemon or a device, i.e.:
+ * - user and group names are resolved from local databases only, bypassing
+ *   NSS backends such as LDAP,
+ * - only virtual filesystems may be mounted, besides bind mounts, since
+ *   mounting a block device filesystem may block on journal replay and remote
+ *   ones on network.
+ * Spawn regular commands when such operations are needed.
+ */
+
+typedef int (builtin_fn)(const char * const * args);
+
+struct builtin {
+	const char * name;
+	unsigned int min_nr;
+	unsigned int max_nr;
+	builtin_fn * check;
+	builtin_fn * run;
+};
+
+static int
+builtin_parse_mode(const char * arg, mode_t * mode)
+{
+	assert(arg);
+	assert(mode);
+
+	char *        end;
+	unsigned long val;
+
+	errno = 0;
+	val = strtoul(arg, &end, 8);
+	if (errno || (end == arg) || *end || (val > 07777))
+		return -EINVAL;
+
+	*mode = (mode_t)val;
+
+	return 0;
+}
+
+static int
+builtin_parse_id(const char * arg, unsigned int * id)
+{
+	assert(arg);
+	assert(id);
+
+	char *        end;
+	unsigned long val;
+
+	errno = 0;
+	val = strtoul(arg, &end, 10);
+	if (errno || (end == arg) || *end || (val >= (unsigned int)-1))
+		return -EINVAL;
+
+	*id = (unsigned int)val;
+
+	return 0;
+}
+
+/* [ "@mkdir", PATH, [MODE] ]: an already existing path is not an error. */
+static int
+builtin_mkdir(const char * const * args)
+{
+	mode_t mode = BUILTIN_DIR_MODE;
+
+	if (args[2] && builtin_parse_mode(args[2], &mode))
+		return -EINVAL;
+
+	if (mkdir(args[1], mode) && (errno != EEXIST))
+		return -errno;
+
+	return 0;
+}
+
+/* [ "@touch", PATH ] */
+static int
+builtin_touch(const char * const * args)
+{
+	int fd;
+	int err = 0;
+
+	fd = open(args[1],
+	          O_WRONLY | O_CREAT | O_NOCTTY | O_NONBLOCK | O_CLOEXEC,
+	          BUILTIN_FILE_MODE);
+	if (fd < 0)
+		return -errno;
+
+	if (futimens(fd, NULL))
+		err = -errno;
+
+	close(fd);
+
+	return err;
+}
+
+/* [ "@chmod", MODE, PATH ] */
+static int
+builtin_chmod(const char * const * args)
+{
+	mode_t mode;
+
+	if (builtin_parse_mode(args[1], &mode))
+		return -EINVAL;
+
+	if (chmod(args[2], mode))
+		return -errno;
+
+	return 0;
+}
+
+static int
+builtin_lookup_uid(const char * name, uid_t * uid)
+{
+	assert(name);
+	assert(uid);
+
+	FILE *                db;
+	const struct passwd * ent;
+	int                   err = -ENOENT;
+
+	db = fopen("/etc/passwd", "re");
+	if (!db)
+		return -errno;
+
+	while ((ent = fgetpwent(db))) {
+		if (!strcmp(ent->pw_name, name)) {
+			*uid = ent->pw_uid;
+			err = 0;
+			break;
+		}
+	}
+
+	fclose(db);
+
+	return err;
+}
+
+static int
+builtin_lookup_gid(const char * name, gid_t * gid)
+{
+	assert(name);
+	assert(gid);
+
+	FILE *               db;
+	const struct group * ent;
+	int                  err = -ENOENT;
+
+	db = fopen("/etc/group", "re");
+	if (!db)
+		return -errno;
+
+	while ((ent = fgetgrent(db))) {
+		if (!strcmp(ent->gr_name, name)) {
+			*gid = ent->gr_gid;
+			err = 0;
+			break;
+		}
+	}
+
+	fclose(db);
+
+	return err;
+}
+
+static int
+builtin_parse_owner(const char * arg, uid_t * uid)
+{
+	assert(arg);
+	assert(uid);
+
+	if (!builtin_parse_id(arg, uid))
+		return 0;
+
+	return builtin_lookup_uid(arg, uid);
+}
+
+/*
+ * [ "@chown", OWNER[:GROUP], PATH ]
+ *
+ * OWNER and GROUP may be given as numerical ids or as names defined into
+ * /etc/passwd and /etc/group. As for legacy chown(1), '.' is accepted as
+ * separator, unless the whole argument names an existing owner so that user
+ * names containing dots are supported.
+ */
+static int
+builtin_chown(const char * const * args)
+{
+	size_t       len = strcspn(args[1], ":");
+	char         owner[len + 1];
+	const char * group = NULL;
+	uid_t        uid;
+	gid_t        gid = (gid_t)-1;
+	int          err;
+
+	memcpy(owner, args[1], len);
+	owner[len] = '\0';
+	if (args[1][len])
+		group = &args[1][len + 1];
+
+	err = builtin_parse_owner(owner, &uid);
+	if (err && !group) {
+		char * sep = strchr(owner, '.');
+
+		if (!sep)
+			return err;
+
+		*sep = '\0';
+		group = &args[1][sep - owner + 1];
+
+		err = builtin_parse_owner(owner, &uid);
+	}
+	if (err)
+		return err;
+
+	if (group && builtin_parse_id(group, &gid)) {
+		err = builtin_lookup_gid(group, &gid);
+		if (err)
+			return err;
+	}
+
+	if (chown(args[2], uid, gid))
+		return -errno;
+
+	return 0;
+}
+
+/* [ "@symlink", TARGET, PATH ] */
+static int
+builtin_symlink(const char * const * args)
+{
+	if (symlink(args[1], args[2]))
+		return -errno;
+
+	return 0;
+}
+
+/*
+ * [ "@write", PATH, DATA ]: meant for short writes to sysctl / sysfs
+ * attributes.
+ *
+ * O_NONBLOCK only fails with -EAGAIN instead of blocking when PATH is a FIFO, a
+ * TTY or the like: it is ignored for regular files as well as sysfs and procfs
+ * attributes, which writes still run synchronously.
+ */
+static int
+builtin_write(const char * const * args)
+{
+	const char * data = args[2];
+	size_t       len = strlen(data);
+	int          fd;
+	int          err = 0;
+
+	fd = open(args[1], O_WRONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	while (len) {
+		ssize_t ret;
+
+		ret = write(fd, data, len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			err = -errno;
+			break;
+		}
+
+		data += ret;
+		len -= (size_t)ret;
+	}
+
+	close(fd);
+
+	return err;
+}
+
+struct builtin_mnt_opt {
+	const char *  name;
+	unsigned long flag;
+};
+
+static const struct builtin_mnt_opt builtin_mnt_opts[] = {
+	{ .name = "ro",         .flag = MS_RDONLY },
+	{ .name = "nosuid",     .flag = MS_NOSUID },
+	{ .name = "nodev",      .flag = MS_NODEV },
+	{ .name = "noexec",     .flag = MS_NOEXEC },
+	{ .name = "sync",       .flag = MS_SYNCHRONOUS },
+	{ .name = "noatime",    .flag = MS_NOATIME },
+	{ .name = "nodiratime", .flag = MS_NODIRATIME },
+	{ .name = "relatime",   .flag = MS_RELATIME },
+	{ .name = "bind",       .flag = MS_BIND }
+};
+
+/*
+ * Split mount options into mount(2) flags and filesystem specific data.
+ * @data should be at least as large as @opts.
+ */
+static unsigned long
+builtin_parse_mnt_opts(const char * opts, char * data)
+{
+	assert(opts);
+	assert(data);
+
+	unsigned long flags = 0;
+	char *        end = data;
+
+	*data = '\0';
+	while (*opts) {
+		size_t       len = strcspn(opts, ",");
+		unsigned int o;
+
+		for (o = 0; o < stroll_array_nr(builtin_mnt_opts); o++) {
+			const char * name = builtin_mnt_opts[o].name;
+
+			if ((strlen(name) == len) && !strncmp(opts, name, len))
+				break;
+		}
+
+		if (o < stroll_array_nr(builtin_mnt_opts))
+			flags |= builtin_mnt_opts[o].flag;
+		else if (len) {
+			if (end != data)
+				*end++ = ',';
+			memcpy(end, opts, len);
+			end += len;
+			*end = '\0';
+		}
+
+		opts += len;
+		if (*opts)
+			opts++;
+	}
+
+	return flags;
+}
+
+/* Filesystems which are not backed by any device nor network. */
+static const char * const builtin_virtual_fstypes[] = {
+	"proc",
+	"sysfs",
+	"devtmpfs",
+	"devpts",
+	"tmpfs",
+	"ramfs",
+	"mqueue",
+	"cgroup",
+	"cgroup2",
+	"debugfs",
+	"tracefs",
+	"securityfs",
+	"configfs",
+	"pstore",
+	"bpf",
+	"hugetlbfs",
+	"efivarfs",
+	"binfmt_misc",
+	"fusectl"
+};
+
+/*
+ * Refuse mounting filesystems which are neither virtual ones nor bind mounts
+ * at configuration load time.
+ */
+static int
+builtin_check_mount(const char * const * args)
+{
+	const char * opts = args[4] ? args[4] : "";
+	char         data[strlen(opts) + 1];
+	unsigned int t;
+
+	if (builtin_parse_mnt_opts(opts, data) & MS_BIND)
+		return 0;
+
+	for (t = 0; t < stroll_array_nr(builtin_virtual_fstypes); t++)
+		if (!strcmp(args[3], builtin_virtual_fstypes[t]))
+			return 0;
+
+	return -EPERM;
+}
+
+/* [ "@mount", SOURCE, TARGET, TYPE, [OPTIONS] ] */
+static int
+builtin_mount(const char * const * args)
+{
+	const char *  opts = args[4] ? args[4] : "";
+	char          data[strlen(opts) + 1];
+	unsigned long flags;
+
+	flags = builtin_parse_mnt_opts(opts, data);
+	if (mount(args[1], args[2], args[3], flags, data[0] ? data : NULL))
+		return -errno;
+
+	return 0;
+}
+
+static const struct builtin builtins[] = {
+	{
+		.name   = "@mkdir",
+		.min_nr = 2,
+		.max_nr = 3,
+		.run    = builtin_mkdir
+	},
+	{
+		.name   = "@touch",
+		.min_nr = 2,
+		.max_nr = 2,
+		.run    = builtin_touch
+	},
+	{
+		.name   = "@chmod",
+		.min_nr = 3,
+		.max_nr = 3,
+		.run    = builtin_chmod
+	},
+	{
+		.name   = "@chown",
+		.min_nr = 3,
+		.max_nr = 3,
+		.run    = builtin_chown
+	},
+	{
+		.name   = "@symlink",
+		.min_nr = 3,
+		.max_nr = 3,
+		.run    = builtin_symlink
+	},
+	{
+		.name   = "@write",
+		.min_nr = 3,
+		.max_nr = 3,
+		.run    = builtin_write
+	},
+	{
+		.name   = "@mount",
+		.min_nr = 4,
+		.max_nr = 5,
+		.check  = builtin_check_mount,
+		.run    = builtin_mount
+	}
+};
+
+static const struct builtin *
+builtin_find(const char * name)
+{
+	assert(name);
+
+	unsigned int b;
+
+	for (b = 0; b < stroll_array_nr(builtins); b++)
+		if (!strcmp(name, builtins[b].name))
+			return &builtins[b];
+
+	return NULL;
+}
+
+int
+builtin_check(const char * const * args)
+{
+	assert(builtin_is_cmd(args));
+
+	const struct builtin * bltin;
+	unsigned int           nr = 0;
+
+	bltin = builtin_find(args[0]);
+	if (!bltin)
+		return -ENOENT;
+
+	while (args[nr])
+		nr++;
+
+	if ((nr < bltin->min_nr) || (nr > bltin->max_nr))
+		return -EINVAL;
+
+	return bltin->check ? bltin->check(args) : 0;
+}
+
+int
+builtin_run(const char * const * args)
+{
+	assert(!builtin_check(args));
+
+	return builtin_find(args[0])->run(args);
+}
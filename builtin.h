@@ -0,0 +1,47 @@
+#ifndef _TINIT_BUILTIN_H
+#define _TINIT_BUILTIN_H
+
+#include "common.h"
+#include <stdbool.h>
+#include <assert.h>
+
+/*
+ * Start / stop sequence commands whose first argument starts with this
+ * character are run by init itself, without forking, e.g.:
+ *     [ "@chmod", "0620", "/dev/log" ]
+ */
+#define BUILTIN_CHAR '@'
+
+static inline bool
+builtin_is_cmd(const char * const * args)
+{
+	assert(args);
+	assert(args[0]);
+
+	return args[0][0] == BUILTIN_CHAR;
+}
+
+/*
+ * builtin_check() - Validate a built-in command.
+ *
+ * @args: NULL terminated built-in command arguments
+ *
+ * Return: 0 if valid, -ENOENT if the built-in is unknown, -EINVAL if the
+ *         number of arguments is invalid, -EPERM if the built-in might block
+ *         init.
+ */
+extern int
+builtin_check(const char * const * args);
+
+/*
+ * builtin_run() - Run a built-in command in-process.
+ *
+ * @args: NULL terminated built-in command arguments, validated with
+ *        builtin_check()
+ *
+ * Return: 0 if successful, a negative errno like value otherwise.
+ */
+extern int
+builtin_run(const char * const * args);
+
+#endif /* _TINIT_BUILTIN_H */
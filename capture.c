@@ -0,0 +1,250 @@
+#include "capture.h"
+#include "svc.h"
+#include "conf.h"
+#include "log.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <assert.h>
+#include <errno.h>
+#include <sys/uio.h>
+
+static const struct upoll * capture_poller;
+
+static struct capture *
+capture_from_worker(const struct upoll_worker * worker)
+{
+	return containerof(worker, struct capture, work);
+}
+
+static void
+capture_flush_line(struct capture * capt)
+{
+	assert(capt);
+	assert(capt->line_len);
+
+	tinit_info("%s: %.*s",
+	           conf_get_name(capt->svc->conf),
+	           (int)capt->line_len,
+	           capt->line);
+
+	capt->line_len = 0;
+}
+
+/*
+ * Split data just read into lines and forward them to init logs. Lines longer
+ * than CAPTURE_LINE_MAX are broken into multiple records.
+ */
+static void
+capture_forward(struct capture * capt, const char * data, size_t size)
+{
+	assert(capt);
+	assert(data);
+
+	while (size) {
+		const char * eol;
+		size_t       len;
+
+		eol = memchr(data, '\n', size);
+		len = eol ? (size_t)(eol - data) : size;
+		len = stroll_min(len, CAPTURE_LINE_MAX - capt->line_len);
+
+		memcpy(&capt->line[capt->line_len], data, len);
+		capt->line_len += len;
+		data += len;
+		size -= len;
+
+		if (size && (*data == '\n')) {
+			data++;
+			size--;
+		}
+		else if (capt->line_len < CAPTURE_LINE_MAX)
+			/* Partial line: wait for more data. */
+			break;
+
+		if (capt->line_len)
+			capture_flush_line(capt);
+	}
+}
+
+/*
+ * Read pipe content straight into the ring buffer free area, wrapping around
+ * thanks to readv(2) so that no intermediate copy is needed.
+ */
+static ssize_t
+capture_read(struct capture * capt)
+{
+	assert(capt);
+
+	size_t       off = (size_t)(capt->head % CAPTURE_RING_SIZE);
+	struct iovec iov[2] = {
+		{
+			.iov_base = &capt->ring[off],
+			.iov_len  = CAPTURE_RING_SIZE - off
+		},
+		{
+			.iov_base = capt->ring,
+			.iov_len  = off
+		}
+	};
+	ssize_t      ret;
+
+	ret = readv(capt->fds[0], iov, off ? 2 : 1);
+	if (ret < 0)
+		return -errno;
+
+	capt->head += (unsigned long long)ret;
+
+	if (conf_get_capture(capt->svc->conf) == CONF_FORWARD_CAPTURE) {
+		size_t len = stroll_min((size_t)ret, iov[0].iov_len);
+
+		capture_forward(capt, iov[0].iov_base, len);
+		if ((size_t)ret > len)
+			capture_forward(capt, capt->ring, (size_t)ret - len);
+	}
+
+	return ret;
+}
+
+static int
+capture_dispatch(struct upoll_worker * worker,
+                 uint32_t              state __unused,
+                 const struct upoll *  poller __unused)
+{
+	assert(worker);
+	assert(state & EPOLLIN);
+	assert(!(state & EPOLLOUT));
+	assert(!(state & EPOLLRDHUP));
+	assert(!(state & EPOLLPRI));
+	assert(poller);
+
+	struct capture * capt = capture_from_worker(worker);
+	ssize_t          ret;
+
+	/*
+	 * Bound the amount of data processed at once so that a service flooding
+	 * its output cannot starve other workers.
+	 */
+	ret = capture_read(capt);
+	if (ret >= 0)
+		return 0;
+
+	if ((ret == -EAGAIN) || (ret == -EINTR))
+		return 0;
+
+	tinit_warn("%s: cannot capture output: %s (%d).",
+	           conf_get_name(capt->svc->conf),
+	           strerror((int)-ret),
+	           (int)-ret);
+
+	return 0;
+}
+
+size_t
+capture_read_tail(const struct capture * capt, char * buff, size_t size)
+{
+	assert(capt);
+	assert(buff);
+
+	size_t len;
+	size_t off;
+	size_t cnt;
+
+	len = (size_t)stroll_min(capt->head, (unsigned long long)size);
+	len = stroll_min(len, CAPTURE_RING_SIZE);
+	if (!len)
+		return 0;
+
+	off = (size_t)((capt->head - len) % CAPTURE_RING_SIZE);
+	cnt = stroll_min(len, CAPTURE_RING_SIZE - off);
+
+	memcpy(buff, &capt->ring[off], cnt);
+	if (cnt < len)
+		memcpy(&buff[cnt], capt->ring, len - cnt);
+
+	return len;
+}
+
+struct capture *
+capture_create(const struct svc * svc, const int fds[2])
+{
+	assert(svc);
+	assert(capture_poller);
+
+	struct capture * capt;
+	int              err;
+
+	capt = malloc(sizeof(*capt));
+	if (!capt)
+		return NULL;
+
+	if (!fds) {
+		if (pipe2(capt->fds, O_CLOEXEC)) {
+			err = -errno;
+			goto free;
+		}
+	}
+	else {
+		capt->fds[0] = fds[0];
+		capt->fds[1] = fds[1];
+	}
+
+	/* Only the read end is non-blocking: services block on full pipe. */
+	if (fcntl(capt->fds[0], F_SETFL, O_NONBLOCK)) {
+		err = -errno;
+		goto close;
+	}
+
+	capt->work.dispatch = capture_dispatch;
+	err = upoll_register(capture_poller,
+	                     capt->fds[0],
+	                     EPOLLIN,
+	                     &capt->work);
+	if (err)
+		goto close;
+
+	capt->svc = svc;
+	capt->head = 0;
+	capt->line_len = 0;
+
+	return capt;
+
+close:
+	close(capt->fds[0]);
+	close(capt->fds[1]);
+free:
+	free(capt);
+
+	tinit_err("%s: cannot setup output capture: %s (%d).",
+	          conf_get_name(svc->conf),
+	          strerror(-err),
+	          -err);
+
+	errno = -err;
+
+	return NULL;
+}
+
+void
+capture_destroy(struct capture * capt)
+{
+	assert(capt);
+
+	/* Poller may already be closed at shutdown time. */
+	if (capture_poller)
+		upoll_unregister(capture_poller, capt->fds[0]);
+
+	if (capt->line_len)
+		capture_flush_line(capt);
+
+	close(capt->fds[0]);
+	close(capt->fds[1]);
+
+	free(capt);
+}
+
+void
+capture_setup(const struct upoll * poller)
+{
+	capture_poller = poller;
+}
@@ -0,0 +1,81 @@
+#ifndef _TINIT_CAPTURE_H
+#define _TINIT_CAPTURE_H
+
+#include "common.h"
+#include <utils/poll.h>
+#include <assert.h>
+
+struct svc;
+
+/* Size of per-service output ring buffer (bytes, power of 2). */
+#define CAPTURE_RING_SIZE (16384U)
+
+/* Maximum length of a line forwarded to init logs. */
+#define CAPTURE_LINE_MAX  (256U)
+
+/*
+ * struct capture - Service standard output / error capture.
+ *
+ * Service processes are given the write end of a pipe as standard output and
+ * error. Init drains the read end from within its main poll loop and keeps the
+ * most recent output into a fixed-size ring buffer.
+ *
+ * Init holds on to the write end so that the pipe survives service process
+ * respawns and output is retained across service restarts.
+ */
+struct capture {
+	struct upoll_worker work;
+	const struct svc *  svc;
+	int                 fds[2];
+	unsigned long long  head;
+	unsigned int        line_len;
+	char                line[CAPTURE_LINE_MAX];
+	char                ring[CAPTURE_RING_SIZE];
+};
+
+static inline int
+capture_get_sink(const struct capture * capt)
+{
+	assert(capt);
+	assert(capt->fds[1] >= 0);
+
+	return capt->fds[1];
+}
+
+/*
+ * capture_read_tail() - Copy the most recent captured output.
+ *
+ * @capt: capture to read from
+ * @buff: where to copy output to
+ * @size: size of @buff
+ *
+ * Return: number of bytes copied into @buff.
+ */
+extern size_t
+capture_read_tail(const struct capture * capt, char * buff, size_t size);
+
+/*
+ * capture_create() - Create a service output capture.
+ *
+ * @svc: the service to capture output of
+ * @fds: pipe file descriptors to adopt or NULL to create a new pipe
+ *
+ * Return: capture if successful, NULL otherwise with errno set accordingly.
+ */
+extern struct capture *
+capture_create(const struct svc * svc, const int fds[2]);
+
+extern void
+capture_destroy(struct capture * capt);
+
+/*
+ * capture_setup() - Give captures the poller to register pipes to.
+ *
+ * @poller: init main poller or NULL once it has been closed
+ *
+ * Must be called before any capture is created.
+ */
+extern void
+capture_setup(const struct upoll * poller);
+
+#endif /* _TINIT_CAPTURE_H */
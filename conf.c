@@ -1,4 +1,5 @@
 #include "conf.h"
+#include "builtin.h"
 #include <stroll/cdefs.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -21,6 +22,18 @@
  * Logging / printing helpers.
  ******************************************************************************/
 
+/*
+ * Set while parsing on behalf of conf_probe_file() so that errors are not
+ * reported. Thread local since parsing may run from a background thread.
+ */
+static __thread bool conf_quiet;
+
+#define conf_err(_format, ...) \
+	do { \
+		if (!conf_quiet) \
+			tinit_err(_format, ## __VA_ARGS__); \
+	} while (0)
+
 #define conf_log_err(_setting, _format, ...) \
 	conf_vlog(_setting, "   ERROR", _format ".\n", ## __VA_ARGS__)
 
@@ -43,6 +56,9 @@ conf_vlog(const config_setting_t * setting,
 	const char * name;
 	va_list      args;
 
+	if (conf_quiet)
+		return;
+
 	path = config_setting_source_file(setting);
 	assert(path);
 	line = config_setting_source_line(setting);
@@ -140,7 +156,7 @@ conf_seq_put_cmd(const struct conf_seq * seq,
 }
 
 static int
-conf_seq_setup(struct conf_seq * seq, unsigned int nr)
+conf_seq_setup(struct conf_seq * seq, unsigned int nr, bool grouped)
 {
 	assert(seq);
 	assert(nr);
@@ -149,6 +165,18 @@ conf_seq_setup(struct conf_seq * seq, unsigned int nr)
 	if (!seq->cmds)
 		return -errno;
 
+	if (grouped) {
+		seq->ends = malloc(nr * sizeof(seq->ends[0]));
+		if (!seq->ends) {
+			int err = -errno;
+
+			free(seq->cmds);
+			return err;
+		}
+	}
+	else
+		seq->ends = NULL;
+
 	seq->nr = nr;
 
 	return 0;
@@ -167,6 +195,7 @@ conf_seq_release(struct conf_seq * seq)
 			strarr_destroy((struct strarr *)seq->cmds[c]);
 
 		free(seq->cmds);
+		free(seq->ends);
 	}
 }
 
@@ -388,21 +417,63 @@ destroy:
 }
 
 static int
-conf_load_seq_setting(const config_setting_t * setting,
-                      struct conf_seq *        seq)
+conf_load_seq_cmd(const config_setting_t * setting,
+                  struct conf_seq *        seq,
+                  unsigned int             cmd)
 {
 	assert(setting);
 	assert(seq);
 
-	int nr;
-	int c;
-	int err;
+	const struct strarr * args;
+	int                   err;
 
-	if (!config_setting_is_list(setting)) {
-		conf_log_err(setting, "list required");
-		return -EBADMSG;
+	err = conf_load_strarr_setting(setting,
+	                               &args,
+	                               conf_parse_cmd_arg,
+	                               true);
+	if (err) {
+		conf_log_err(setting, "command %u: parsing failed", cmd + 1);
+		return err;
 	}
 
+	conf_seq_put_cmd(seq, cmd, args);
+
+	if (builtin_is_cmd(strarr_get_members(args))) {
+		err = builtin_check(strarr_get_members(args));
+		if (err) {
+			conf_log_err(setting,
+			             "command %u: %s",
+			             cmd + 1,
+			             (err == -ENOENT) ?
+			             "unknown built-in" :
+			             (err == -EPERM) ?
+			             "built-in might block init" :
+			             "invalid built-in arguments");
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Count commands of a sequence made of commands and / or groups of commands,
+ * i.e. lists of commands to run concurrently, e.g.:
+ *     ( [ "/bin/cmd0" ], ( [ "/bin/cmd1" ], [ "/bin/cmd2" ] ) )
+ */
+static int
+conf_count_seq_cmds(const config_setting_t * setting,
+                    bool                     grouping,
+                    bool *                   grouped)
+{
+	assert(setting);
+	assert(config_setting_is_list(setting));
+	assert(grouped);
+
+	int nr;
+	int c;
+	int cnt = 0;
+
 	nr = config_setting_length(setting);
 	assert(nr >= 0);
 	if (!nr) {
@@ -410,28 +481,97 @@ conf_load_seq_setting(const config_setting_t * setting,
 		return  -ENODATA;
 	}
 
-	if (conf_seq_setup(seq, nr))
+	*grouped = false;
+	for (c = 0; c < nr; c++) {
+		const config_setting_t * elm;
+		int                      len;
+
+		elm = config_setting_get_elem(setting, c);
+		assert(elm);
+
+		if (!config_setting_is_list(elm)) {
+			cnt++;
+			continue;
+		}
+
+		if (!grouping) {
+			conf_log_err(elm, "command groups not allowed");
+			return -EINVAL;
+		}
+
+		len = config_setting_length(elm);
+		assert(len >= 0);
+		if (!len) {
+			conf_log_err(elm, "empty command group not allowed");
+			return  -ENODATA;
+		}
+
+		cnt += len;
+		*grouped = true;
+	}
+
+	return cnt;
+}
+
+static int
+conf_load_seq_setting(const config_setting_t * setting,
+                      struct conf_seq *        seq,
+                      bool                     grouping)
+{
+	assert(setting);
+	assert(seq);
+
+	int          nr;
+	bool         grouped;
+	int          c;
+	unsigned int cmd = 0;
+	int          err;
+
+	if (!config_setting_is_list(setting)) {
+		conf_log_err(setting, "list required");
+		return -EBADMSG;
+	}
+
+	nr = conf_count_seq_cmds(setting, grouping, &grouped);
+	if (nr < 0)
+		return nr;
+
+	if (conf_seq_setup(seq, (unsigned int)nr, grouped))
 		return -ENOMEM;
 
+	nr = config_setting_length(setting);
 	for (c = 0; c < nr; c++) {
-		const config_setting_t * cmd;
-		const struct strarr *    args;
+		const config_setting_t * elm;
+		unsigned int             first = cmd;
+		int                      len;
+		int                      m;
 
-		cmd = config_setting_get_elem(setting, c);
-		assert(cmd);
+		elm = config_setting_get_elem(setting, c);
+		assert(elm);
 
-		err = conf_load_strarr_setting(cmd,
-		                               &args,
-		                               conf_parse_cmd_arg,
-		                               true);
-		if (err) {
-			conf_log_err(setting,
-			             "command %d: parsing failed",
-			             c + 1);
-			goto release;
+		if (!config_setting_is_list(elm)) {
+			err = conf_load_seq_cmd(elm, seq, cmd++);
+			if (err)
+				goto release;
 		}
+		else {
+			len = config_setting_length(elm);
+			for (m = 0; m < len; m++) {
+				const config_setting_t * memb;
 
-		conf_seq_put_cmd(seq, c, args);
+				memb = config_setting_get_elem(elm, m);
+				assert(memb);
+
+				err = conf_load_seq_cmd(memb, seq, cmd++);
+				if (err)
+					goto release;
+			}
+		}
+
+		if (grouped) {
+			while (first < cmd)
+				seq->ends[first++] = cmd;
+		}
 	}
 
 	return 0;
@@ -566,6 +706,59 @@ conf_load_stdout(struct conf_svc *        conf,
 	return 0;
 }
 
+static int
+conf_load_capture(struct conf_svc *        conf,
+                  const config_setting_t * setting)
+{
+	const char * str;
+	ssize_t      len;
+
+	len = conf_parse_string_setting(setting, &str, sizeof("forward"));
+	if (len < 0)
+		return len;
+
+	if (!strcmp(str, "ring"))
+		conf->capture = CONF_RING_CAPTURE;
+	else if (!strcmp(str, "forward"))
+		conf->capture = CONF_FORWARD_CAPTURE;
+	else {
+		conf_log_err(setting, "'%s': invalid capture mode", str);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static const char * const conf_prio_names[] = {
+	[CONF_NORMAL_PRIO]   = "normal",
+	[CONF_CRITICAL_PRIO] = "critical",
+	[CONF_IDLE_PRIO]     = "idle"
+};
+
+static int
+conf_load_prio(struct conf_svc *        conf,
+               const config_setting_t * setting)
+{
+	const char * str;
+	ssize_t      len;
+	unsigned int p;
+
+	len = conf_parse_string_setting(setting, &str, sizeof("critical"));
+	if (len < 0)
+		return len;
+
+	for (p = 0; p < stroll_array_nr(conf_prio_names); p++) {
+		if (!strcmp(str, conf_prio_names[p])) {
+			conf->prio = p;
+			return 0;
+		}
+	}
+
+	conf_log_err(setting, "'%s': invalid priority class", str);
+
+	return -EINVAL;
+}
+
 /*
  * Check environment variable name validity:
  * - empty name rejected,
@@ -808,14 +1001,14 @@ static int
 conf_load_start(struct conf_svc *        conf,
                 const config_setting_t * setting)
 {
-	return conf_load_seq_setting(setting, &conf->start);
+	return conf_load_seq_setting(setting, &conf->start, true);
 }
 
 static int
 conf_load_stop(struct conf_svc *        conf,
                const config_setting_t * setting)
 {
-	return conf_load_seq_setting(setting, &conf->stop);
+	return conf_load_seq_setting(setting, &conf->stop, false);
 }
 
 static int
@@ -881,6 +1074,145 @@ conf_load_signal(struct conf_svc *        conf,
 	return 0;
 }
 
+static const char * const conf_kill_mode_names[] = {
+	[CONF_PROCESS_KILL] = "process",
+	[CONF_GROUP_KILL]   = "group",
+	[CONF_SESSION_KILL] = "session"
+};
+
+static int
+conf_load_kill_mode(struct conf_svc *        conf,
+                    const config_setting_t * setting)
+{
+	const char * str;
+	ssize_t      len;
+	unsigned int m;
+
+	len = conf_parse_string_setting(setting, &str, sizeof("session"));
+	if (len < 0)
+		return len;
+
+	for (m = 0; m < stroll_array_nr(conf_kill_mode_names); m++) {
+		if (!strcmp(str, conf_kill_mode_names[m])) {
+			conf->kill_mode = m;
+			return 0;
+		}
+	}
+
+	conf_log_err(setting, "'%s': invalid kill mode", str);
+
+	return -EINVAL;
+}
+
+/* ( [ SIGNAL, DELAY ], ... ) */
+static int
+conf_load_kill_steps(struct conf_svc *        conf,
+                     const config_setting_t * setting)
+{
+	int nr;
+	int s;
+	int err;
+
+	if (!config_setting_is_list(setting)) {
+		conf_log_err(setting, "list required");
+		return -EBADMSG;
+	}
+
+	nr = config_setting_length(setting);
+	if (!nr) {
+		conf_log_err(setting, "empty list not allowed");
+		return -ENODATA;
+	}
+	if ((unsigned int)nr > CONF_KILL_STEP_MAX) {
+		conf_log_err(setting,
+		             "more than %u steps not allowed",
+		             CONF_KILL_STEP_MAX);
+		return -E2BIG;
+	}
+
+	for (s = 0; s < nr; s++) {
+		const config_setting_t * step;
+		int                      delay;
+
+		step = config_setting_get_elem(setting, s);
+		assert(step);
+
+		if (!config_setting_is_array(step) ||
+		    (config_setting_length(step) != 2)) {
+			conf_log_err(step, "[ SIGNAL, DELAY ] array required");
+			return -EBADMSG;
+		}
+
+		err = conf_parse_signo_setting(config_setting_get_elem(step, 0),
+		                               &conf->kill_steps[s].signo);
+		if (err)
+			return err;
+
+		err = conf_parse_int_setting(config_setting_get_elem(step, 1),
+		                             &delay);
+		if (err)
+			return err;
+		if (delay <= 0) {
+			conf_log_err(step, "invalid delay %d", delay);
+			return -ERANGE;
+		}
+
+		conf->kill_steps[s].delay = (unsigned int)delay;
+	}
+
+	conf->kill_nr = (unsigned int)nr;
+
+	return 0;
+}
+
+static int
+conf_load_kill(struct conf_svc *        conf,
+               const config_setting_t * setting)
+{
+	assert(conf);
+	assert(setting);
+
+	int nr;
+	int k;
+	int err;
+
+	if (!config_setting_is_group(setting)) {
+		conf_log_err(setting, "dictionary required");
+		return -EBADMSG;
+	}
+
+	nr = config_setting_length(setting);
+	assert(nr >= 0);
+	if (!nr) {
+		conf_log_err(setting, "empty dictionary not allowed");
+		return -ENODATA;
+	}
+
+	for (k = 0; k < nr; k++) {
+		const config_setting_t * elm;
+		const char *             name;
+
+		elm = config_setting_get_elem(setting, k);
+		assert(elm);
+		name = config_setting_name(elm);
+		assert(name);
+
+		if (!strcmp(name, "mode"))
+			err = conf_load_kill_mode(conf, elm);
+		else if (!strcmp(name, "escalate"))
+			err = conf_load_kill_steps(conf, elm);
+		else {
+			conf_log_err(elm, "invalid kill setting");
+			err = -EINVAL;
+		}
+
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
 static int
 conf_load_daemon(struct conf_svc *        conf,
                  const config_setting_t * setting)
@@ -888,10 +1220,22 @@ conf_load_daemon(struct conf_svc *        conf,
 	assert(conf);
 	assert(setting);
 
-	return conf_load_strarr_setting(setting,
-	                                &conf->daemon,
-	                                conf_parse_cmd_arg,
-	                                true);
+	int err;
+
+	err = conf_load_strarr_setting(setting,
+	                               &conf->daemon,
+	                               conf_parse_cmd_arg,
+	                               true);
+	if (err)
+		return err;
+
+	if (builtin_is_cmd(strarr_get_members(conf->daemon))) {
+		/* A daemon is a process to supervise. */
+		conf_log_err(setting, "built-in not allowed");
+		return -EINVAL;
+	}
+
+	return 0;
 }
 
 typedef int (conf_load_setting_fn)(struct conf_svc *,
@@ -907,12 +1251,15 @@ static const struct conf_loader conf_loaders[] = {
 	{ .name = "description", .load = conf_load_desc },
 	{ .name = "stdin",       .load = conf_load_stdin },
 	{ .name = "stdout",      .load = conf_load_stdout },
+	{ .name = "capture",     .load = conf_load_capture },
+	{ .name = "priority",    .load = conf_load_prio },
 	{ .name = "environ",     .load = conf_load_env },
 	{ .name = "starton",     .load = conf_load_starton },
 	{ .name = "start",       .load = conf_load_start },
 	{ .name = "stopon",      .load = conf_load_stopon },
 	{ .name = "stop",        .load = conf_load_stop },
 	{ .name = "signal",      .load = conf_load_signal },
+	{ .name = "kill",        .load = conf_load_kill },
 	{ .name = "daemon",      .load = conf_load_daemon }
 };
 
@@ -1058,6 +1405,11 @@ conf_load_root(struct conf_svc * conf)
 		goto fini_conf;
 	}
 
+	if (conf->stdout && conf->capture) {
+		msg = "stdout and capture settings are mutually exclusive";
+		goto fini_conf;
+	}
+
 	if (conf->starton && conf_strarr_has_dups(conf->starton, conf->name)) {
 		msg = "duplicate starton service(s) found";
 		goto fini_conf;
@@ -1067,8 +1419,19 @@ conf_load_root(struct conf_svc * conf)
 		goto fini_conf;
 	}
 
+	if (conf->stop_sig && conf->kill_nr) {
+		msg = "stop signal and kill escalation are mutually exclusive";
+		goto fini_conf;
+	}
+
 	if (!conf->stop_sig)
 		conf->stop_sig = SIGTERM;
+	if (!conf->kill_nr) {
+		/* Stop signal then SIGKILL once default delay expired. */
+		conf->kill_steps[0].signo = conf->stop_sig;
+		conf->kill_steps[0].delay = CONF_KILL_DELAY;
+		conf->kill_nr = 1;
+	}
 	if (!conf->reload_sig)
 		conf->reload_sig = SIGTERM;
 
@@ -1077,7 +1440,7 @@ conf_load_root(struct conf_svc * conf)
 fini_conf:
 	conf_fini(conf);
 err:
-	tinit_err("'%s': %s.", config_setting_source_file(root), msg);
+	conf_err("'%s': %s.", config_setting_source_file(root), msg);
 
 	return ret;
 }
@@ -1109,18 +1472,18 @@ conf_load_file(struct conf_svc * conf, const char * path)
 		switch (config_error_type(&conf->lib)) {
 		case CONFIG_ERR_FILE_IO:
 			ret = -errno;
-			tinit_err("'%s': cannot load file: %s (%d).",
-			          config_error_file(&conf->lib),
-			          strerror(-ret),
-			          -ret);
+			conf_err("'%s': cannot load file: %s (%d).",
+			         config_error_file(&conf->lib),
+			         strerror(-ret),
+			         -ret);
 			goto destroy;
 
 		case CONFIG_ERR_PARSE:
 			ret = -EBADMSG;
-			tinit_err("'%s': line %d: parsing failed: %s.",
-			          config_error_file(&conf->lib),
-			          config_error_line(&conf->lib),
-			          config_error_text(&conf->lib));
+			conf_err("'%s': line %d: parsing failed: %s.",
+			         config_error_file(&conf->lib),
+			         config_error_line(&conf->lib),
+			         config_error_text(&conf->lib));
 			goto destroy;
 
 		default:
@@ -1145,6 +1508,21 @@ destroy:
 	return ret;
 }
 
+static void
+conf_print_kill_steps(const char * title, const struct conf_svc * conf)
+{
+	unsigned int s;
+
+	fprintf(stderr, "%-18s", title);
+	for (s = 0; s < conf->kill_nr; s++)
+		fprintf(stderr,
+		        " %s%d/%us",
+		        s ? "-> " : "",
+		        conf->kill_steps[s].signo,
+		        conf->kill_steps[s].delay);
+	fputc('\n', stderr);
+}
+
 void
 conf_print(const struct conf_svc * conf)
 {
@@ -1165,6 +1543,18 @@ conf_print(const struct conf_svc * conf)
 	if (conf->stdout)
 		fprintf(stderr, SVC_PRINT_FORMAT "\n", "STDOUT:", conf->stdout);
 
+	if (conf->capture)
+		fprintf(stderr,
+		        SVC_PRINT_FORMAT "\n",
+		        "Capture:",
+		        (conf->capture == CONF_RING_CAPTURE) ? "ring" :
+		                                               "forward");
+
+	fprintf(stderr,
+	        SVC_PRINT_FORMAT "\n",
+	        "Priority:",
+	        conf_prio_names[conf->prio]);
+
 	conf_print_strarr("Environment:", ", ", conf->env);
 
 	conf_print_strarr("Start on (ready):", ", ", conf_get_starton(conf));
@@ -1174,6 +1564,108 @@ conf_print(const struct conf_svc * conf)
 	conf_print_seq("Stop:", &conf->stop);
 
 	conf_print_strarr("Daemon:", " ", conf->daemon);
+
+	fprintf(stderr,
+	        SVC_PRINT_FORMAT "\n",
+	        "Kill mode:",
+	        conf_kill_mode_names[conf->kill_mode]);
+
+	conf_print_kill_steps("Kill escalation:", conf);
+}
+
+static bool
+conf_str_equal(const char * first, const char * second)
+{
+	if (first && second)
+		return !strcmp(first, second);
+
+	return first == second;
+}
+
+static bool
+conf_strarr_equal(const struct strarr * first, const struct strarr * second)
+{
+	unsigned int s;
+
+	if (!first || !second)
+		return first == second;
+
+	if (strarr_nr(first) != strarr_nr(second))
+		return false;
+
+	/* Also compare NULL end of element list markers if any. */
+	for (s = 0; s < strarr_nr(first); s++) {
+		if (!conf_str_equal(strarr_get(first, s),
+		                    strarr_get(second, s)))
+			return false;
+	}
+
+	return true;
+}
+
+static bool
+conf_kill_equal(const struct conf_svc * first, const struct conf_svc * second)
+{
+	unsigned int s;
+
+	if ((first->kill_mode != second->kill_mode) ||
+	    (first->kill_nr != second->kill_nr))
+		return false;
+
+	for (s = 0; s < first->kill_nr; s++) {
+		if ((first->kill_steps[s].signo !=
+		     second->kill_steps[s].signo) ||
+		    (first->kill_steps[s].delay !=
+		     second->kill_steps[s].delay))
+			return false;
+	}
+
+	return true;
+}
+
+static bool
+conf_seq_equal(const struct conf_seq * first, const struct conf_seq * second)
+{
+	unsigned int c;
+
+	if (conf_seq_nr(first) != conf_seq_nr(second))
+		return false;
+
+	for (c = 0; c < conf_seq_nr(first); c++) {
+		if (!conf_strarr_equal(conf_seq_get_cmd(first, c),
+		                       conf_seq_get_cmd(second, c)))
+			return false;
+
+		if (conf_seq_group_end(first, c) !=
+		    conf_seq_group_end(second, c))
+			return false;
+	}
+
+	return true;
+}
+
+bool
+conf_equal(const struct conf_svc * first, const struct conf_svc * second)
+{
+	assert(first);
+	assert(second);
+
+	return conf_str_equal(first->name, second->name) &&
+	       conf_str_equal(first->path, second->path) &&
+	       conf_str_equal(first->desc, second->desc) &&
+	       conf_str_equal(first->stdin, second->stdin) &&
+	       conf_str_equal(first->stdout, second->stdout) &&
+	       (first->capture == second->capture) &&
+	       (first->prio == second->prio) &&
+	       conf_strarr_equal(first->env, second->env) &&
+	       conf_seq_equal(&first->start, &second->start) &&
+	       conf_strarr_equal(first->daemon, second->daemon) &&
+	       conf_seq_equal(&first->stop, &second->stop) &&
+	       (first->stop_sig == second->stop_sig) &&
+	       (first->reload_sig == second->reload_sig) &&
+	       conf_kill_equal(first, second) &&
+	       conf_strarr_equal(first->starton, second->starton) &&
+	       conf_strarr_equal(first->stopon, second->stopon);
 }
 
 struct conf_svc *
@@ -1203,6 +1695,18 @@ free:
 	return NULL;
 }
 
+struct conf_svc *
+conf_probe_file(const char * path)
+{
+	struct conf_svc * conf;
+
+	conf_quiet = true;
+	conf = conf_create_from_file(path);
+	conf_quiet = false;
+
+	return conf;
+}
+
 void
 conf_destroy(struct conf_svc * conf)
 {
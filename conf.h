@@ -11,9 +11,17 @@
  * Command sequence handling.
  ******************************************************************************/
 
+/*
+ * struct conf_seq - Command sequence.
+ *
+ * Commands of a group run concurrently. When the sequence defines groups,
+ * @ends holds, for each command, the index of the first command following
+ * its group. Otherwise @ends is NULL and each command forms its own group.
+ */
 struct conf_seq {
 	unsigned int           nr;
 	const struct strarr ** cmds;
+	unsigned int *         ends;
 };
 
 static inline unsigned int
@@ -42,15 +50,77 @@ conf_seq_get_args(const struct conf_seq * seq, unsigned int cmd)
 	return strarr_get_members(conf_seq_get_cmd(seq, cmd));
 }
 
+static inline unsigned int
+conf_seq_group_end(const struct conf_seq * seq, unsigned int cmd)
+{
+	assert(seq);
+	assert(cmd < conf_seq_nr(seq));
+
+	return seq->ends ? seq->ends[cmd] : cmd + 1;
+}
+
+/*
+ * Service standard output / error capture modes:
+ * - CONF_NO_CAPTURE: output goes to stdout setting pathname, if any,
+ * - CONF_RING_CAPTURE: output is kept into an in-memory ring buffer,
+ * - CONF_FORWARD_CAPTURE: same as above and lines are forwarded to init logs.
+ */
+enum conf_capture {
+	CONF_NO_CAPTURE = 0,
+	CONF_RING_CAPTURE,
+	CONF_FORWARD_CAPTURE
+};
+
+/*
+ * Service priority classes:
+ * - CONF_NORMAL_PRIO: default class,
+ * - CONF_CRITICAL_PRIO: spawned before other classes and stopped last,
+ * - CONF_IDLE_PRIO: spawned once system is quiescent and stopped first.
+ */
+enum conf_prio {
+	CONF_NORMAL_PRIO = 0,
+	CONF_CRITICAL_PRIO,
+	CONF_IDLE_PRIO,
+	CONF_PRIO_NR
+};
+
+/*
+ * Service kill modes, i.e. processes signaled when stopping:
+ * - CONF_PROCESS_KILL: main process only,
+ * - CONF_GROUP_KILL: main process group,
+ * - CONF_SESSION_KILL: all processes of main process session.
+ */
+enum conf_kill_mode {
+	CONF_PROCESS_KILL = 0,
+	CONF_GROUP_KILL,
+	CONF_SESSION_KILL
+};
+
+/* Stop signal escalation step: send @signo then wait for @delay seconds. */
+struct conf_kill_step {
+	int          signo;
+	unsigned int delay;
+};
+
+#define CONF_KILL_STEP_MAX (4U)
+
+/* Default delay before killing a process that does not stop (seconds). */
+#define CONF_KILL_DELAY    (5U)
+
 struct conf_svc {
 	const char *          stdin;
 	const char *          stdout;
+	enum conf_capture     capture;
+	enum conf_prio        prio;
 	const struct strarr * env;
 	struct conf_seq       start;
 	const struct strarr * daemon;
 	struct conf_seq       stop;
 	int                   stop_sig;
 	int                   reload_sig;
+	enum conf_kill_mode   kill_mode;
+	unsigned int          kill_nr;
+	struct conf_kill_step kill_steps[CONF_KILL_STEP_MAX];
 	const char *          name;
 	const char *          path;
 	const char *          desc;
@@ -77,6 +147,22 @@ conf_get_path(const struct conf_svc * conf)
 	return conf->path;
 }
 
+static inline enum conf_capture
+conf_get_capture(const struct conf_svc * conf)
+{
+	assert(conf);
+
+	return conf->capture;
+}
+
+static inline enum conf_prio
+conf_get_prio(const struct conf_svc * conf)
+{
+	assert(conf);
+
+	return conf->prio;
+}
+
 static inline const struct strarr *
 conf_get_starton(const struct conf_svc * conf)
 {
@@ -117,6 +203,14 @@ conf_get_start_cmd(const struct conf_svc * conf, unsigned int index)
 	return conf_seq_get_args(&conf->start, index);
 }
 
+static inline unsigned int
+conf_get_start_group_end(const struct conf_svc * conf, unsigned int index)
+{
+	assert(conf);
+
+	return conf_seq_group_end(&conf->start, index);
+}
+
 static inline const char * const *
 conf_get_daemon(const struct conf_svc * conf)
 {
@@ -159,6 +253,32 @@ conf_get_stop_sig(const struct conf_svc * conf)
 	return conf->stop_sig;
 }
 
+static inline enum conf_kill_mode
+conf_get_kill_mode(const struct conf_svc * conf)
+{
+	assert(conf);
+
+	return conf->kill_mode;
+}
+
+static inline unsigned int
+conf_get_kill_nr(const struct conf_svc * conf)
+{
+	assert(conf);
+	assert(conf->kill_nr);
+	assert(conf->kill_nr <= CONF_KILL_STEP_MAX);
+
+	return conf->kill_nr;
+}
+
+static inline const struct conf_kill_step *
+conf_get_kill_step(const struct conf_svc * conf, unsigned int step)
+{
+	assert(step < conf_get_kill_nr(conf));
+
+	return &conf->kill_steps[step];
+}
+
 static inline int
 conf_get_reload_sig(const struct conf_svc * conf)
 {
@@ -167,8 +287,32 @@ conf_get_reload_sig(const struct conf_svc * conf)
 	return conf->reload_sig;
 }
 
+/*
+ * conf_equal() - Tell whether 2 service configurations are identical.
+ *
+ * @first:  first configuration to compare
+ * @second: second configuration to compare
+ *
+ * Return: true if all settings of @first and @second match, false otherwise.
+ */
+extern bool conf_equal(const struct conf_svc * first,
+                       const struct conf_svc * second);
+
 extern struct conf_svc * conf_create_from_file(const char * path);
 
+/*
+ * conf_probe_file() - Parse a service configuration file silently.
+ *
+ * @path: path to configuration file
+ *
+ * Same as conf_create_from_file() but parsing errors are not reported, leaving
+ * it up to caller to parse @path again to report them. Safe to call from a
+ * thread other than the main one.
+ *
+ * Return: configuration if successful, NULL otherwise with errno set.
+ */
+extern struct conf_svc * conf_probe_file(const char * path);
+
 extern void conf_destroy(struct conf_svc * conf);
 
 extern void conf_print(const struct conf_svc * conf);
@@ -6,7 +6,7 @@
 #define CONFIG_TINIT_ENVIRON_TERM    "linux"
 #define CONFIG_TINIT_ASSERT          1
 #define CONFIG_TINIT_DEBUG           1
-#define CONFIG_TINIT_MNTTAB_PATH     "/proc/mounts"
+#define CONFIG_TINIT_MNTINFO_PATH    "/proc/self/mountinfo"
 #define CONFIG_TINIT_FSTYPE_PATH     "/proc/filesystems"
 #define CONFIG_TINIT_GID             ((gid_t)0)
 
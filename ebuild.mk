@@ -5,16 +5,18 @@ common-cflags       := $(EXTRA_CFLAGS) -Wall -Wextra -Wformat=2 -D_GNU_SOURCE
 common-ldflags      := $(common-cflags) $(EXTRA_LDFLAGS)
 
 solibs              := libtinit.so
-libtinit.so-objs     = lib.o conf.o strarr.o common.o
+libtinit.so-objs     = lib.o conf.o strarr.o common.o builtin.o
 libtinit.so-cflags   = $(common-cflags) -DPIC -fpic
 libtinit.so-ldflags  = $(common-ldflags) -shared -fpic -Wl,-soname,libtinit.so
 libtinit.so-pkgconf  = libconfig libelog libutils libstroll
 
 bins                := init
 init-objs            = init.o mnt.o notif.o repo.o sigchan.o srv.o svc.o \
-                       sys.o target.o log.o
-init-cflags          = $(common-cflags)
-init-ldflags         = $(EXTRA_LDFLAGS) -ltinit
+                       sys.o target.o log.o fdstore.o watch.o \
+                       reexec.o capture.o evlog.o metrics.o match.o \
+                       preload.o
+init-cflags          = $(common-cflags) -pthread
+init-ldflags         = $(EXTRA_LDFLAGS) -ltinit -pthread
 init-pkgconf        := libelog libutils libstroll
 init-path            = $(SBINDIR)/init
 
@@ -25,6 +27,15 @@ svctl-ldflags        = $(common-ldflags) -ltinit
 svctl-path           = $(SBINDIR)/svctl
 svctl-pkgconf        = smartcols
 
+ifeq ($(CONFIG_TINIT_BENCH),y)
+# Control socket load generator: a benchmarking tool, kept out of SBINDIR.
+bins                  += tinit-loadgen
+tinit-loadgen-objs     = loadgen.o
+tinit-loadgen-cflags   = $(common-cflags)
+tinit-loadgen-ldflags  = $(common-ldflags) -ltinit
+tinit-loadgen-path     = $(LIBEXECDIR)/tinit/tinit-loadgen
+endif # ($(CONFIG_TINIT_BENCH),y)
+
 HEADERDIR           := $(CURDIR)/include
 headers              = tinit/tinit.h
 
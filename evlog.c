@@ -0,0 +1,53 @@
+#include "evlog.h"
+#include <time.h>
+#include <assert.h>
+
+/*
+ * Init is single threaded: the ring is a plain array indexed by a free running
+ * record counter.
+ */
+static struct {
+	unsigned long long cnt;
+	struct tinit_event evts[TINIT_EVLOG_NR];
+} tinit_evlog;
+
+void
+tinit_evlog_record(enum tinit_event_id id,
+                   uint32_t            svc_id,
+                   pid_t               pid,
+                   int                 status)
+{
+	assert(id < TINIT_EVENT_ID_NR);
+
+	struct tinit_event * evt;
+	struct timespec      now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	evt = &tinit_evlog.evts[tinit_evlog.cnt++ % TINIT_EVLOG_NR];
+	evt->tstamp = ((uint64_t)now.tv_sec * 1000000000ULL) +
+	              (uint64_t)now.tv_nsec;
+	evt->pid = (pid > 0) ? (uint32_t)pid : 0;
+	evt->status = status;
+	evt->svc_id = svc_id;
+	evt->id = (uint16_t)id;
+	evt->pad = 0;
+}
+
+unsigned int
+tinit_evlog_read(struct tinit_event * events, unsigned int nr)
+{
+	assert(events);
+
+	unsigned long long start;
+	unsigned int       e;
+
+	nr = (unsigned int)stroll_min((unsigned long long)nr, tinit_evlog.cnt);
+	nr = stroll_min(nr, TINIT_EVLOG_NR);
+
+	start = tinit_evlog.cnt - nr;
+	for (e = 0; e < nr; e++)
+		events[e] = tinit_evlog.evts[(start + e) % TINIT_EVLOG_NR];
+
+	return nr;
+}
@@ -0,0 +1,37 @@
+#ifndef _TINIT_EVLOG_H
+#define _TINIT_EVLOG_H
+
+#include "common.h"
+#include <tinit/tinit.h>
+
+/* Number of event records kept (power of 2). */
+#define TINIT_EVLOG_NR (256U)
+
+/*
+ * tinit_evlog_record() - Record an init event.
+ *
+ * @id:     event identifier
+ * @svc_id: identifier of service involved, see svc_get_id()
+ * @pid:    PID of process involved if any, 0 otherwise
+ * @status: event specific status
+ *
+ * Oldest records are overwritten once the event ring is full.
+ */
+extern void
+tinit_evlog_record(enum tinit_event_id id,
+                   uint32_t            svc_id,
+                   pid_t               pid,
+                   int                 status);
+
+/*
+ * tinit_evlog_read() - Copy most recent events.
+ *
+ * @events: where to copy events to, from the oldest to the most recent one
+ * @nr:     maximum number of events to copy
+ *
+ * Return: number of events copied.
+ */
+extern unsigned int
+tinit_evlog_read(struct tinit_event * events, unsigned int nr);
+
+#endif /* _TINIT_EVLOG_H */
@@ -0,0 +1,323 @@
+#include "fdstore.h"
+#include "proto.h"
+#include "repo.h"
+#include "svc.h"
+#include "conf.h"
+#include "log.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/*
+ * Enough room to receive a full set of TINIT_STORE_FD_MAX file descriptors and
+ * sender credentials.
+ */
+#define TINIT_FDSTORE_CTRL_SIZE \
+	(CMSG_SPACE(TINIT_STORE_FD_MAX * sizeof(int)) + \
+	 CMSG_SPACE(sizeof(struct ucred)))
+
+static struct tinit_fdstore *
+tinit_fdstore_from_worker(const struct upoll_worker * worker)
+{
+	return containerof(worker, struct tinit_fdstore, work);
+}
+
+static void
+tinit_fdstore_close_fds(const int * fds, unsigned int nr)
+{
+	unsigned int f;
+
+	for (f = 0; f < nr; f++)
+		close(fds[f]);
+}
+
+/*
+ * Find the service a process belongs to. Service processes are session leaders
+ * hence helpers forked by a service main process may be matched against its
+ * session or process group as well.
+ */
+static struct svc *
+tinit_fdstore_search_svc(pid_t pid)
+{
+	assert(pid > 0);
+
+	const struct tinit_repo * repo = tinit_repo_get();
+	struct svc *              svc;
+	pid_t                     id;
+
+	svc = tinit_repo_search_bypid(repo, pid);
+	if (svc)
+		return svc;
+
+	id = getsid(pid);
+	if ((id > 0) && (id != pid)) {
+		svc = tinit_repo_search_bypid(repo, id);
+		if (svc)
+			return svc;
+	}
+
+	id = getpgid(pid);
+	if ((id > 0) && (id != pid))
+		return tinit_repo_search_bypid(repo, id);
+
+	return NULL;
+}
+
+static void
+tinit_fdstore_process(const struct tinit_fdstore_msg * msg,
+                      const struct ucred *             creds,
+                      const int *                      fds,
+                      unsigned int                     nr)
+{
+	assert(msg);
+	assert(creds);
+	assert(!nr || fds);
+
+	struct svc * svc;
+	unsigned int cnt;
+
+	/*
+	 * Only accept file descriptors from processes of a running service.
+	 */
+	svc = tinit_fdstore_search_svc(creds->pid);
+	if (!svc) {
+		tinit_info("file store: PID %d: unknown service process.",
+		           creds->pid);
+		goto close;
+	}
+
+	switch (msg->op) {
+	case TINIT_FDSTORE_PUSH_OP:
+		if (!nr)
+			return;
+
+		cnt = svc_store_fds(svc, fds, nr);
+		if (cnt == nr)
+			return;
+
+		tinit_warn("%s: file store full: "
+		           "%u file descriptor(s) dropped.",
+		           conf_get_name(svc->conf),
+		           nr - cnt);
+
+		fds += cnt;
+		nr -= cnt;
+		break;
+
+	case TINIT_FDSTORE_FLUSH_OP:
+		svc_flush_fds(svc);
+		break;
+
+	default:
+		tinit_info("file store: unknown request.");
+	}
+
+close:
+	tinit_fdstore_close_fds(fds, nr);
+}
+
+/*
+ * Gather file descriptors carried by a SCM_RIGHTS control message. Peer may
+ * split its file descriptors across multiple control messages: the ones that
+ * do not fit into the TINIT_STORE_FD_MAX slots of @fds are closed.
+ */
+static void
+tinit_fdstore_collect_fds(const struct cmsghdr * cmsg,
+                          int *                  fds,
+                          unsigned int *         nr)
+{
+	assert(cmsg);
+	assert(cmsg->cmsg_len >= CMSG_LEN(0));
+	assert(fds);
+	assert(nr);
+	assert(*nr <= TINIT_STORE_FD_MAX);
+
+	const unsigned char * data = CMSG_DATA(cmsg);
+	unsigned int          cnt;
+	unsigned int          f;
+
+	cnt = (unsigned int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+	for (f = 0; f < cnt; f++) {
+		int fd;
+
+		memcpy(&fd, &data[f * sizeof(fd)], sizeof(fd));
+		if (*nr < TINIT_STORE_FD_MAX)
+			fds[(*nr)++] = fd;
+		else
+			close(fd);
+	}
+}
+
+static int
+tinit_fdstore_recv(const struct tinit_fdstore * store)
+{
+	assert(store);
+
+	struct tinit_fdstore_msg msg;
+	struct iovec             iov = {
+		.iov_base = &msg,
+		.iov_len  = sizeof(msg)
+	};
+	union {
+		char           buff[TINIT_FDSTORE_CTRL_SIZE];
+		struct cmsghdr align;
+	}                        ctrl;
+	struct msghdr            hdr = {
+		.msg_iov        = &iov,
+		.msg_iovlen     = 1,
+		.msg_control    = ctrl.buff,
+		.msg_controllen = sizeof(ctrl.buff)
+	};
+	ssize_t                  ret;
+	struct cmsghdr *         cmsg;
+	const struct ucred *     creds = NULL;
+	int                      fds[TINIT_STORE_FD_MAX];
+	unsigned int             nr = 0;
+
+	ret = recvmsg(store->fd, &hdr, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+	if (ret < 0) {
+		assert(errno != EBADF);
+		assert(errno != EFAULT);
+		assert(errno != EINVAL);
+		assert(errno != ENOTSOCK);
+
+		return -errno;
+	}
+
+	for (cmsg = CMSG_FIRSTHDR(&hdr);
+	     cmsg;
+	     cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET)
+			continue;
+
+		switch (cmsg->cmsg_type) {
+		case SCM_CREDENTIALS:
+			creds = (const struct ucred *)CMSG_DATA(cmsg);
+			break;
+
+		case SCM_RIGHTS:
+			tinit_fdstore_collect_fds(cmsg, fds, &nr);
+			break;
+		}
+	}
+
+	if ((size_t)ret != sizeof(msg) ||
+	    !creds ||
+	    (hdr.msg_flags & (MSG_TRUNC | MSG_CTRUNC))) {
+		tinit_info("file store: invalid request.");
+		tinit_fdstore_close_fds(fds, nr);
+
+		return 0;
+	}
+
+	tinit_fdstore_process(&msg, creds, fds, nr);
+
+	return 0;
+}
+
+static int
+tinit_fdstore_dispatch(struct upoll_worker * worker,
+                       uint32_t              state __unused,
+                       const struct upoll *  poller __unused)
+{
+	assert(worker);
+	assert(state & EPOLLIN);
+	assert(!(state & EPOLLOUT));
+	assert(!(state & EPOLLRDHUP));
+	assert(!(state & EPOLLPRI));
+	assert(poller);
+
+	const struct tinit_fdstore * store = tinit_fdstore_from_worker(worker);
+	int                          ret;
+
+	do {
+		ret = tinit_fdstore_recv(store);
+	} while (!ret);
+
+	return ((ret == -EAGAIN) || (ret == -EINTR)) ? 0 : ret;
+}
+
+int
+tinit_fdstore_open(struct tinit_fdstore * store,
+                   const char *           path,
+                   const struct upoll *   poller)
+{
+	assert(store);
+	assert(path);
+	assert(poller);
+
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	size_t             len;
+	int                fd;
+	const int          on = 1;
+	mode_t             msk;
+	int                err;
+
+	len = strnlen(path, sizeof(addr.sun_path));
+	if (len >= sizeof(addr.sun_path))
+		return -ENAMETOOLONG;
+	memcpy(addr.sun_path, path, len + 1);
+
+	fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (fd < 0) {
+		err = -errno;
+		goto err;
+	}
+
+	if (setsockopt(fd, SOL_SOCKET, SO_PASSCRED, &on, sizeof(on))) {
+		err = -errno;
+		goto close;
+	}
+
+	unlink(path);
+
+	/* Any service may push file descriptors, whatever its credentials. */
+	msk = umask(~(S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP |
+	              S_IROTH | S_IWOTH));
+	err = bind(fd, (const struct sockaddr *)&addr, sizeof(addr));
+	umask(msk);
+	if (err) {
+		err = -errno;
+		goto close;
+	}
+
+	store->work.dispatch = tinit_fdstore_dispatch;
+	err = upoll_register(poller, fd, EPOLLIN, &store->work);
+	if (err)
+		goto unlink;
+
+	store->fd = fd;
+
+	tinit_debug("file store: opened.");
+
+	return 0;
+
+unlink:
+	unlink(path);
+close:
+	close(fd);
+err:
+	tinit_err("file store: cannot open socket: '%s': %s (%d).",
+	          path,
+	          strerror(-err),
+	          -err);
+
+	return err;
+}
+
+void
+tinit_fdstore_close(const struct tinit_fdstore * store,
+                    const struct upoll *         poller)
+{
+	assert(store);
+	assert(store->fd >= 0);
+	assert(poller);
+
+	upoll_unregister(poller, store->fd);
+	close(store->fd);
+}
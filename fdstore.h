@@ -0,0 +1,29 @@
+#ifndef _TINIT_FDSTORE_H
+#define _TINIT_FDSTORE_H
+
+#include "common.h"
+#include <utils/poll.h>
+
+/*
+ * struct tinit_fdstore - File descriptor store server.
+ *
+ * Services may hand file descriptors over to init thanks to SCM_RIGHTS
+ * ancillary messages sent to TINIT_FDSTORE_PATH. Stored descriptors are given
+ * back to the next spawned process of the sending service so that listening
+ * sockets and the like survive service restarts.
+ */
+struct tinit_fdstore {
+	struct upoll_worker work;
+	int                 fd;
+};
+
+extern int
+tinit_fdstore_open(struct tinit_fdstore * store,
+                   const char *           path,
+                   const struct upoll *   poller);
+
+extern void
+tinit_fdstore_close(const struct tinit_fdstore * store,
+                    const struct upoll *         poller);
+
+#endif /* _TINIT_FDSTORE_H */
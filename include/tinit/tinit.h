@@ -3,9 +3,12 @@
 
 #include <tinit/config.h>
 #include <utils/unsk.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 struct conf_svc;
 struct tinit_status_reply;
+struct tinit_sock;
 struct elog;
 
 enum tinit_svc_state {
@@ -19,14 +22,43 @@ struct tinit_status_data {
 	uint32_t pid;
 	uint8_t  adm_state;
 	uint8_t  run_state;
+	uint16_t pad;
+	uint32_t svc_id;
 	char     conf_path[0];
 };
 
+/*
+ * struct tinit_status_ext - Extended service status record header.
+ *
+ * @since:    CLOCK_MONOTONIC time of last state change in nanoseconds
+ * @restarts: number of times service process was respawned
+ * @name_len: length of service name
+ * @desc_len: length of service description, 0 when not requested
+ *
+ * Precedes each status record of extended status replies, see
+ * tinit_load_xstatus(). Service name and description follow the record
+ * configuration file name, all NUL terminated.
+ */
+struct tinit_status_ext {
+	uint64_t since;
+	uint32_t restarts;
+	uint8_t  name_len;
+	uint8_t  desc_len;
+	uint16_t pad;
+};
+
 struct tinit_status_iter {
 	const struct tinit_status_reply * msg;
 	const char *                      end;
+	const struct tinit_status_ext *   ext;
 	struct tinit_status_data *        status;
 	size_t                            len;
+	struct tinit_sock *               sock;
+	const char *                      pattern;
+	size_t                            plen;
+	uint16_t                          type;
+	uint16_t                          flags;
+	uint16_t                          next;
 };
 
 #if !defined(CONFIG_TINIT_ASSERT)
@@ -49,6 +81,43 @@ tinit_get_status_run_state(const struct tinit_status_iter * iter)
 	return iter->status->run_state;
 }
 
+static inline unsigned int
+tinit_get_status_id(const struct tinit_status_iter * iter)
+{
+	return iter->status->svc_id;
+}
+
+static inline unsigned int
+tinit_get_status_restarts(const struct tinit_status_iter * iter)
+{
+	return iter->ext ? iter->ext->restarts : 0;
+}
+
+static inline uint64_t
+tinit_get_status_since(const struct tinit_status_iter * iter)
+{
+	return iter->ext ? iter->ext->since : 0;
+}
+
+static inline const char *
+tinit_get_status_name(const struct tinit_status_iter * iter)
+{
+	if (!iter->ext)
+		return NULL;
+
+	return &iter->status->conf_path[iter->len + 1];
+}
+
+static inline const char *
+tinit_get_status_desc(const struct tinit_status_iter * iter)
+{
+	if (!iter->ext || !iter->ext->desc_len)
+		return NULL;
+
+	return &iter->status->conf_path[iter->len + 1 +
+	                                iter->ext->name_len + 1];
+}
+
 #else /* !defined(CONFIG_TINIT_ASSERT) */
 
 extern pid_t
@@ -60,14 +129,54 @@ tinit_get_status_adm_state(const struct tinit_status_iter * iter);
 extern enum tinit_svc_state
 tinit_get_status_run_state(const struct tinit_status_iter * iter);
 
+extern unsigned int
+tinit_get_status_id(const struct tinit_status_iter * iter);
+
+extern unsigned int
+tinit_get_status_restarts(const struct tinit_status_iter * iter);
+
+extern uint64_t
+tinit_get_status_since(const struct tinit_status_iter * iter);
+
+extern const char *
+tinit_get_status_name(const struct tinit_status_iter * iter);
+
+extern const char *
+tinit_get_status_desc(const struct tinit_status_iter * iter);
+
 #endif /* defined(CONFIG_TINIT_ASSERT) */
 
 extern struct conf_svc *
 tinit_get_status_conf(const struct tinit_status_iter * iter);
 
+/*
+ * tinit_step_status() - Move status iterator to next record.
+ *
+ * @iter: status iterator
+ *
+ * Replies are split into pages when records do not fit into a single message.
+ * Iterators initialized by tinit_load_status() and tinit_load_xstatus()
+ * transparently fetch the next page once current one is exhausted, invalidating
+ * strings of previous records. Iterators handed to asynchronous completion
+ * callbacks stop at page end: see tinit_get_status_next().
+ *
+ * Return: 0 if successful, -ENOENT when no more records are available, another
+ *         negative errno-like value otherwise.
+ */
 extern int
 tinit_step_status(struct tinit_status_iter * iter);
 
+/*
+ * Return start of the status reply page following the one @iter walks, 0 when
+ * this is the last one. Meant to be given to tinit_async_load_status() or
+ * tinit_async_load_xstatus() to request remaining records.
+ */
+static inline unsigned int
+tinit_get_status_next(const struct tinit_status_iter * iter)
+{
+	return iter->next;
+}
+
 struct tinit_sock {
 	struct unsk_clnt unsk;
 	uint16_t         seqno;
@@ -86,6 +195,31 @@ tinit_load_status(struct tinit_sock *        sock,
                   size_t                     len,
                   struct tinit_status_iter * iter);
 
+/*
+ * tinit_load_xstatus() - Fetch extended status of services.
+ *
+ * @sock:    socket connected to init
+ * @pattern: service name pattern
+ * @len:     length of @pattern
+ * @desc:    request service descriptions
+ * @iter:    status iterator to initialize
+ *
+ * Same as tinit_load_status() except that status records also carry service
+ * name, restart count and last state change time, so that
+ * tinit_get_status_name() may be used instead of parsing configuration files
+ * with tinit_get_status_conf(). Descriptions are carried only when @desc is
+ * set since they inflate replies, see tinit_get_status_desc().
+ * @pattern must remain valid till iteration completes.
+ *
+ * Return: 0 if successful, a negative errno-like value otherwise.
+ */
+extern int
+tinit_load_xstatus(struct tinit_sock *        sock,
+                   const char *               pattern,
+                   size_t                     len,
+                   bool                       desc,
+                   struct tinit_status_iter * iter);
+
 extern int
 tinit_start_svc(struct tinit_sock * sock,
                 const char *        name,
@@ -111,12 +245,327 @@ tinit_switch_target(struct tinit_sock * sock,
                     const char *        name,
                     size_t                       len);
 
+/*
+ * tinit_wait_svc() - Wait for a service to reach a given state.
+ *
+ * @sock:  socket connected to init
+ * @name:  name of service
+ * @len:   length of @name
+ * @state: state to wait for
+ * @tmout: maximum time to wait for in milliseconds
+ *
+ * Request is parked by init which replies once service has switched to @state
+ * or @tmout has elapsed, so that no status polling is required.
+ *
+ * Return: 0 if service is in @state, -ETIME when @tmout has elapsed, -EBUSY
+ *         when init has too many wait requests pending, a negative errno-like
+ *         value otherwise.
+ */
+extern int
+tinit_wait_svc(struct tinit_sock *  sock,
+               const char *         name,
+               size_t               len,
+               enum tinit_svc_state state,
+               unsigned int         tmout);
+
+/*
+ * tinit_reload_repo() - Request init to reload service configuration files.
+ *
+ * @sock: socket connected to init
+ *
+ * Services which configuration has changed are restarted, removed ones are
+ * stopped and new ones are registered.
+ *
+ * Return: 0 if successful, a negative errno-like value otherwise.
+ */
+extern int
+tinit_reload_repo(struct tinit_sock * sock);
+
+/*
+ * tinit_load_logs() - Fetch most recent output captured from a service.
+ *
+ * @sock: socket connected to init
+ * @name: name of service
+ * @len:  length of @name
+ * @data: where to store the address of captured output
+ *
+ * Output is stored into @sock reply buffer and remains valid till next request.
+ *
+ * Return: number of bytes found at @data if successful, -ENODATA when output of
+ *         service is not captured, a negative errno-like value otherwise.
+ */
+extern ssize_t
+tinit_load_logs(struct tinit_sock * sock,
+                const char *        name,
+                size_t              len,
+                const char **       data);
+
+/*
+ * Init events recorded into a binary ring so that service state changes are
+ * traced at the cost of a few stores.
+ */
+enum tinit_event_id {
+	TINIT_START_EVENT,   /* service starting */
+	TINIT_READY_EVENT,   /* service ready */
+	TINIT_STOP_EVENT,    /* service stopping */
+	TINIT_DOWN_EVENT,    /* service stopped */
+	TINIT_SPAWN_EVENT,   /* service process spawned */
+	TINIT_EXIT_EVENT,    /* service process exited, see below */
+	TINIT_SIGNAL_EVENT,  /* signal sent to service process */
+	TINIT_EVENT_ID_NR
+};
+
+/*
+ * struct tinit_event - Init event record.
+ *
+ * @tstamp: CLOCK_MONOTONIC time of event in nanoseconds
+ * @pid:    PID of process involved if any, 0 otherwise
+ * @status: event specific status, i.e. exit code or negated signal number for
+ *          TINIT_EXIT_EVENT, signal number for TINIT_SIGNAL_EVENT, 0 otherwise
+ * @svc_id: identifier of service involved, see tinit_get_status_id()
+ * @id:     event identifier, see enum tinit_event_id
+ */
+struct tinit_event {
+	uint64_t tstamp;
+	uint32_t pid;
+	int32_t  status;
+	uint32_t svc_id;
+	uint16_t id;
+	uint16_t pad;
+};
+
+/*
+ * tinit_load_events() - Fetch most recent init events.
+ *
+ * @sock:   socket connected to init
+ * @events: where to store the address of the first event record
+ *
+ * Events are sorted from the oldest to the most recent one and stored into
+ * @sock reply buffer which remains valid till next request.
+ *
+ * Return: number of events found at @events if successful, a negative
+ *         errno-like value otherwise.
+ */
+extern int
+tinit_load_events(struct tinit_sock *         sock,
+                  const struct tinit_event ** events);
+
 extern int
 tinit_open_sock(struct tinit_sock * sock, uint16_t seqno);
 
 extern void
 tinit_close_sock(struct tinit_sock * sock);
 
+/*
+ * Asynchronous control requests.
+ *
+ * Requests are sent without blocking and completed from within
+ * tinit_async_process() which callers should run each time the socket returned
+ * by tinit_async_get_fd() becomes readable. Multiple requests may be in flight
+ * at once: replies are matched against pending requests by sequence number.
+ * Requests not replied within TINIT_ASYNC_TMOUT milliseconds (on top of
+ * the wait timeout for tinit_async_wait_svc() requests) are completed with
+ * -ETIMEDOUT. Callers should bound their polling delay using
+ * tinit_async_get_tmout() and run tinit_async_expire() once it has elapsed.
+ */
+#define TINIT_ASYNC_TMOUT (5000U)
+
+struct tinit_async_sock;
+struct tinit_async_req;
+
+/*
+ * tinit_async_fn - Asynchronous request completion callback.
+ *
+ * @req:  the request completed
+ * @ret:  0 if successful, a negative errno-like value otherwise
+ * @iter: status iterator for successful status requests, NULL otherwise
+ *
+ * @iter points to the socket reply buffer and remains valid till callback
+ * returns only. @req is no longer used by the library once callback is called
+ * and may be released or submitted again from within it.
+ * Socket may be closed from within callback, see tinit_close_async_sock().
+ */
+typedef void (tinit_async_fn)(struct tinit_async_req *   req,
+                              int                        ret,
+                              struct tinit_status_iter * iter);
+
+/*
+ * struct tinit_async_req - Asynchronous request.
+ *
+ * Allocated by callers, typically embedded into their own request context,
+ * fields are private to the library.
+ */
+struct tinit_async_req {
+	struct tinit_async_req * next;
+	uint64_t                 expire;
+	uint16_t                 seqno;
+	uint16_t                 type;
+	tinit_async_fn *         complete;
+};
+
+extern int
+tinit_async_get_fd(const struct tinit_async_sock * sock);
+
+/* Return number of requests waiting for a reply. */
+extern unsigned int
+tinit_async_count_pending(const struct tinit_async_sock * sock);
+
+/*
+ * All request submission functions below return 0 if successful, -EAGAIN when
+ * socket send buffer is full (wait for it to become writable and retry), or
+ * another negative errno-like value otherwise. @req must remain valid till
+ * @complete is called.
+ */
+/*
+ * @start: reply page to fetch, 0 or tinit_get_status_next() of previous one.
+ * Requests for a page which services are all gone complete with -ENOENT.
+ */
+extern int
+tinit_async_load_status(struct tinit_async_sock * sock,
+                        const char *              pattern,
+                        size_t                    len,
+                        unsigned int              start,
+                        struct tinit_async_req *  req,
+                        tinit_async_fn *          complete);
+
+extern int
+tinit_async_load_xstatus(struct tinit_async_sock * sock,
+                         const char *              pattern,
+                         size_t                    len,
+                         unsigned int              start,
+                         bool                      desc,
+                         struct tinit_async_req *  req,
+                         tinit_async_fn *          complete);
+
+extern int
+tinit_async_start_svc(struct tinit_async_sock * sock,
+                      const char *              name,
+                      size_t                    len,
+                      struct tinit_async_req *  req,
+                      tinit_async_fn *          complete);
+
+extern int
+tinit_async_stop_svc(struct tinit_async_sock * sock,
+                     const char *              name,
+                     size_t                    len,
+                     struct tinit_async_req *  req,
+                     tinit_async_fn *          complete);
+
+extern int
+tinit_async_restart_svc(struct tinit_async_sock * sock,
+                        const char *              name,
+                        size_t                    len,
+                        struct tinit_async_req *  req,
+                        tinit_async_fn *          complete);
+
+extern int
+tinit_async_reload_svc(struct tinit_async_sock * sock,
+                       const char *              name,
+                       size_t                    len,
+                       struct tinit_async_req *  req,
+                       tinit_async_fn *          complete);
+
+extern int
+tinit_async_switch_target(struct tinit_async_sock * sock,
+                          const char *              name,
+                          size_t                    len,
+                          struct tinit_async_req *  req,
+                          tinit_async_fn *          complete);
+
+extern int
+tinit_async_wait_svc(struct tinit_async_sock * sock,
+                     const char *              name,
+                     size_t                    len,
+                     enum tinit_svc_state      state,
+                     unsigned int              tmout,
+                     struct tinit_async_req *  req,
+                     tinit_async_fn *          complete);
+
+extern int
+tinit_async_reload_repo(struct tinit_async_sock * sock,
+                        struct tinit_async_req *  req,
+                        tinit_async_fn *          complete);
+
+/*
+ * tinit_async_process() - Complete requests which reply has been received.
+ *
+ * @sock: socket connected to init
+ *
+ * Receive all pending replies without blocking and run completion callback of
+ * matching requests. Replies matching no pending request are discarded.
+ *
+ * Return: 0 if successful, a negative errno-like value otherwise.
+ */
+extern int
+tinit_async_process(struct tinit_async_sock * sock);
+
+/*
+ * tinit_async_get_tmout() - Return delay till the next pending request
+ *                           expires.
+ *
+ * @sock: socket connected to init
+ *
+ * Return: delay in milliseconds, -1 when no request is pending.
+ */
+extern int
+tinit_async_get_tmout(const struct tinit_async_sock * sock);
+
+/*
+ * tinit_async_expire() - Complete expired requests.
+ *
+ * @sock: socket connected to init
+ *
+ * Run completion callback of pending requests which deadline has elapsed with
+ * -ETIMEDOUT.
+ */
+extern void
+tinit_async_expire(struct tinit_async_sock * sock);
+
+/*
+ * tinit_open_async_sock() - Open asynchronous socket connected to init.
+ *
+ * @seqno: initial request sequence number
+ *
+ * Return: socket if successful, NULL otherwise with errno set.
+ */
+extern struct tinit_async_sock *
+tinit_open_async_sock(uint16_t seqno);
+
+/*
+ * tinit_close_async_sock() - Close and release asynchronous socket.
+ *
+ * @sock: socket connected to init
+ *
+ * Requests still pending are completed with -ECANCELED.
+ * When called from within a completion callback, releasing @sock is deferred
+ * till tinit_async_process() / tinit_async_expire() return.
+ */
+extern void
+tinit_close_async_sock(struct tinit_async_sock * sock);
+
+/*
+ * Maximum number of file descriptors a service may hand over to init for
+ * safekeeping across restarts.
+ */
+#define TINIT_STORE_FD_MAX   (16U)
+
+/*
+ * File descriptors stored by a service are given back to the next spawned
+ * service process starting at TINIT_STORE_FD_START ; their number is exported
+ * through the TINIT_STORE_FD_ENV environment variable.
+ */
+#define TINIT_STORE_FD_START (3)
+#define TINIT_STORE_FD_ENV   "TINIT_FDS"
+
+extern int
+tinit_store_fds(const int * fds, unsigned int nr);
+
+extern int
+tinit_flush_fds(void);
+
+extern int
+tinit_get_stored_fds(void);
+
 extern struct elog * tinit_logger;
 
 static inline void
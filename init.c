@@ -1,9 +1,15 @@
 #include "repo.h"
 #include "target.h"
+#include "watch.h"
 #include "log.h"
 #include "mnt.h"
 #include "sigchan.h"
 #include "srv.h"
+#include "fdstore.h"
+#include "reexec.h"
+#include "capture.h"
+#include "metrics.h"
+#include "preload.h"
 #include "proto.h"
 #include <stroll/cdefs.h>
 #include <utils/path.h>
@@ -36,6 +42,51 @@ tinit_parse_target_arg(char * arg, size_t len)
 	tinit_boot_target = arg;
 }
 
+/* Maximum number of seconds granted to services to stop at shutdown time. */
+static unsigned int tinit_shutdown_budget = CONFIG_TINIT_SHUTDOWN_BUDGET;
+
+static void
+tinit_parse_shutdown_arg(char * arg, size_t len)
+{
+	assert(arg);
+	assert(len);
+	assert((size_t)ustr_parse(arg, TINIT_ARG_MAX) == len);
+
+	char *        end;
+	unsigned long secs;
+
+	errno = 0;
+	secs = strtoul(arg, &end, 10);
+	if (errno || (end == arg) || *end || (secs > UINT_MAX / 1000)) {
+		tinit_warn("invalid shutdown argument.");
+		return;
+	}
+
+	tinit_shutdown_budget = (unsigned int)secs;
+}
+
+/* Memory file descriptor holding state saved by a previous init instance. */
+static int tinit_reexec_fd = -1;
+
+static void
+tinit_parse_reexec_arg(char * arg, size_t len)
+{
+	assert(arg);
+	assert(len);
+	assert((size_t)ustr_parse(arg, TINIT_ARG_MAX) == len);
+
+	char * end;
+	long   fd;
+
+	fd = strtol(arg, &end, 10);
+	if (*end || (fd <= STDERR_FILENO) || (fd > INT_MAX)) {
+		tinit_warn("invalid re-execution argument.");
+		return;
+	}
+
+	tinit_reexec_fd = (int)fd;
+}
+
 typedef void (tinit_cmdln_parser_fn)(char * arg, size_t len);
 
 struct tinit_cmdln_parser {
@@ -54,7 +105,9 @@ struct tinit_cmdln_parser {
 static const struct tinit_cmdln_parser tinit_cmdln_parsers[] = {
 	TINIT_INIT_CMD_PARSER("stdlog", tinit_parse_stdlog_arg),
 	TINIT_INIT_CMD_PARSER("mqlog",  tinit_parse_mqlog_arg),
-	TINIT_INIT_CMD_PARSER("target", tinit_parse_target_arg)
+	TINIT_INIT_CMD_PARSER("target", tinit_parse_target_arg),
+	TINIT_INIT_CMD_PARSER("shutdown", tinit_parse_shutdown_arg),
+	TINIT_INIT_CMD_PARSER(TINIT_REEXEC_KWORD, tinit_parse_reexec_arg)
 };
 
 static void
@@ -264,14 +317,18 @@ tinit_poll(struct upoll * poller)
 }
 
 static int
-tinit_loop(void)
+tinit_loop(int argc, char * const argv[])
 {
 	struct upoll         poll;
 	struct tinit_sigchan sigs;
 	struct tinit_srv     srv;
+	struct tinit_fdstore store;
+	bool                 stored;
+	struct tinit_metrics metrics;
+	bool                 measured;
 	int                  ret;
 
-	ret = upoll_open(&poll, 2);
+	ret = upoll_open(&poll, 4);
 	if (ret) {
 		tinit_err("poller: cannot initialize: %s (%d).",
 		          strerror(-ret),
@@ -279,20 +336,64 @@ tinit_loop(void)
 		return ret;
 	}
 
-	ret = tinit_sigchan_open(&sigs);
-	if (ret)
-		goto close_poll;
+	capture_setup(&poll);
+	tinit_watch_logs(&poll);
 
-	ret = tinit_target_start(CONFIG_TINIT_SYSCONFDIR,
-	                         tinit_boot_target,
-	                         &sigs,
-	                         &poll);
-	if (ret)
-		goto close_sigs;
+	if (tinit_reexec_fd < 0) {
+		ret = tinit_sigchan_open(&sigs);
+		if (ret)
+			goto close_poll;
 
-	tinit_srv_open(&srv, TINIT_SOCK_PATH, &poll);
+		ret = tinit_target_start(CONFIG_TINIT_SYSCONFDIR,
+		                         tinit_boot_target,
+		                         &sigs,
+		                         &poll);
+		if (ret)
+			goto close_sigs;
+	}
+	else {
+		/* Services are already running: adopt them. */
+		ret = tinit_reexec_restore(tinit_reexec_fd, &sigs, &poll);
+		if (ret == -EPROTONOSUPPORT) {
+			/* Saved state is unusable: boot target from scratch. */
+			ret = tinit_target_start(CONFIG_TINIT_SYSCONFDIR,
+			                         tinit_boot_target,
+			                         &sigs,
+			                         &poll);
+			if (ret)
+				goto close_sigs;
+		}
+		else if (ret)
+			goto close_poll;
+	}
 
-	tinit_poll(&poll);
+	while (true) {
+		tinit_srv_open(&srv, TINIT_SOCK_PATH, &poll);
+		stored = !tinit_fdstore_open(&store, TINIT_FDSTORE_PATH, &poll);
+		measured = !tinit_metrics_open(&metrics,
+		                               TINIT_METRICS_PATH,
+		                               &poll);
+		tinit_watch_open(&poll);
+
+		tinit_poll(&poll);
+
+		tinit_watch_close(&poll);
+		if (measured)
+			tinit_metrics_close(&metrics, &poll);
+		if (stored)
+			tinit_fdstore_close(&store, &poll);
+		tinit_srv_close(&srv, &poll);
+
+		if (tinit_sigchan_get_signo(&sigs) != SIGHUP)
+			break;
+
+		/*
+		 * Returns upon failure only: keep running with current
+		 * instance.
+		 */
+		tinit_notice("re-execution requested.");
+		tinit_reexec(&sigs, &poll, argc, argv);
+	}
 
 	switch (tinit_sigchan_get_signo(&sigs)) {
 	case SIGTERM:
@@ -315,9 +416,7 @@ tinit_loop(void)
 		assert(0);
 	}
 
-	tinit_srv_close(&srv, &poll);
-
-	tinit_target_stop(&sigs);
+	tinit_target_stop(&sigs, tinit_shutdown_budget);
 
 	tinit_poll(&poll);
 
@@ -326,6 +425,8 @@ tinit_loop(void)
 close_sigs:
 	tinit_sigchan_close(&sigs);
 close_poll:
+	tinit_unwatch_logs(&poll);
+	capture_setup(NULL);
 	upoll_close(&poll);
 
 	return ret;
@@ -380,6 +481,78 @@ static inline void tinit_show_pids(void) { }
 
 #endif /* defined(CONFIG_TINIT_DEBUG) */
 
+#if defined(CONFIG_TINIT_BENCH)
+
+#include <sys/prctl.h>
+
+static inline bool
+tinit_is_bench(void)
+{
+	return true;
+}
+
+static int
+tinit_setup_bench(void)
+{
+	if (getpid() == 1)
+		/* PID 1 of a PID namespace. */
+		return 0;
+
+	/* Adopt orphaned service processes. */
+	if (prctl(PR_SET_CHILD_SUBREAPER, 1, 0, 0, 0)) {
+		int err = errno;
+
+		fprintf(stderr,
+		        "%s: cannot become child subreaper: %s (%d), "
+		        "exiting.\n",
+		        program_invocation_short_name,
+		        strerror(err),
+		        err);
+		return -err;
+	}
+
+	return 0;
+}
+
+static void __noreturn
+tinit_exit_bench(void)
+{
+	tinit_notice("exiting benchmark mode...");
+	tinit_postfini_logs();
+	fflush(NULL);
+
+	exit(EXIT_SUCCESS);
+}
+
+#else  /* !defined(CONFIG_TINIT_BENCH) */
+
+static inline bool
+tinit_is_bench(void)
+{
+	return false;
+}
+
+static inline int
+tinit_setup_bench(void)
+{
+	if (getpid() == 1)
+		return 0;
+
+	fprintf(stderr,
+	        "%s: must be run as PID 1, exiting.\n",
+	        program_invocation_short_name);
+
+	return -EPERM;
+}
+
+static inline void __noreturn
+tinit_exit_bench(void)
+{
+	unreachable();
+}
+
+#endif /* defined(CONFIG_TINIT_BENCH) */
+
 static void
 tinit_killall(void)
 {
@@ -403,13 +576,19 @@ tinit_shutdown(int howto)
 	pid_t        pid;
 
 	fflush(NULL);
-	sync();
+
+	if (tinit_is_bench()) {
+		/* Do not kill processes nor unmount filesystems of host. */
+		tinit_prefini_logs();
+		tinit_exit_bench();
+	}
 
 	/* Kill all remaining processes (except pid 1). */
 	tinit_killall();
 
 	tinit_prefini_logs();
 
+	/* Filesystems are synced one by one at unmounting time. */
 	mnt_umount_all(MNT_FORCE);
 
 	switch (howto) {
@@ -459,12 +638,9 @@ main(int argc, char * const argv[])
 	int                 ret;
 	struct tinit_repo * repo;
 
-	if (getpid() != 1) {
-		fprintf(stderr,
-		        "%s: must be run as PID 1, exiting.\n",
-		        program_invocation_short_name);
+	/* Reports errors on its own since loggers are not setup yet. */
+	if (tinit_setup_bench())
 		return EXIT_FAILURE;
-	}
 
 	umask(0077);
 
@@ -479,23 +655,47 @@ main(int argc, char * const argv[])
 
 	init_signals();
 
-	ret = mnt_mount_all();
-	if (ret) {
-		msg = "cannot setup initial filesystems";
-		goto err;
+	/*
+	 * At boot time, parse boot target services configuration while
+	 * filesystems are being mounted. Signals are blocked at this point so
+	 * that the loader thread inherits a fully blocked signal mask.
+	 */
+	if (tinit_reexec_fd < 0)
+		tinit_preload_start(CONFIG_TINIT_SYSCONFDIR, tinit_boot_target);
+
+	/*
+	 * Filesystems are already mounted when re-executed or expected to be
+	 * setup by host when benchmarking.
+	 */
+	if ((tinit_reexec_fd < 0) && !tinit_is_bench()) {
+		ret = mnt_mount_all();
+		if (ret) {
+			msg = "cannot setup initial filesystems";
+			goto err;
+		}
 	}
 
 	/*
 	 * MUST be done after pseudo filesystems are mounted since fslog
 	 * redirects into a file that should be stored under one of them.
 	 * See CONFIG_TINIT_FSLOG_PATH definition.
+	 * Join configuration loader thread first so that errors it recorded
+	 * are reported before switching loggers.
 	 */
+	tinit_preload_wait();
 	tinit_postinit_logs();
 
-	ret = init_stdios();
-	if (ret) {
-		msg = "cannot setup initial standard I/Os";
-		goto err;
+	/*
+	 * Standard I/Os are inherited when re-executed. Moreover, closing file
+	 * descriptors would drop saved state and descriptors stored on behalf
+	 * of services.
+	 */
+	if ((tinit_reexec_fd < 0) && !tinit_is_bench()) {
+		ret = init_stdios();
+		if (ret) {
+			msg = "cannot setup initial standard I/Os";
+			goto err;
+		}
 	}
 
 	ret = init_environ();
@@ -506,13 +706,20 @@ main(int argc, char * const argv[])
 
 	repo = tinit_repo_get();
 
-	ret = tinit_repo_load(repo);
-	if (ret) {
-		msg = "cannot load services";
-		goto clear;
+	/*
+	 * At boot time, only services reachable from boot target are loaded,
+	 * on demand. See tinit_target_start(). When re-executed, services to
+	 * adopt may be any of them.
+	 */
+	if (tinit_reexec_fd >= 0) {
+		ret = tinit_repo_load(repo);
+		if (ret) {
+			msg = "cannot load services";
+			goto clear;
+		}
 	}
 
-	ret = tinit_loop();
+	ret = tinit_loop(argc, argv);
 	if (ret < 0) {
 		msg = "cannot run services loop";
 		goto clear;
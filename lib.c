@@ -3,11 +3,16 @@
 #include "proto.h"
 #include <utils/path.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <string.h>
 #include <ctype.h>
 #include <fnmatch.h>
 #include <errno.h>
+#include <limits.h>
+#include <time.h>
 #include <assert.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 ssize_t
 tinit_parse_svc_name(const char * name)
@@ -109,6 +114,53 @@ tinit_get_status_run_state(const struct tinit_status_iter * iter)
 	return iter->status->run_state;
 }
 
+unsigned int
+tinit_get_status_id(const struct tinit_status_iter * iter)
+{
+	TINIT_ASSERT_STATUS_ITER(iter);
+
+	return iter->status->svc_id;
+}
+
+unsigned int
+tinit_get_status_restarts(const struct tinit_status_iter * iter)
+{
+	TINIT_ASSERT_STATUS_ITER(iter);
+
+	return iter->ext ? iter->ext->restarts : 0;
+}
+
+uint64_t
+tinit_get_status_since(const struct tinit_status_iter * iter)
+{
+	TINIT_ASSERT_STATUS_ITER(iter);
+
+	return iter->ext ? iter->ext->since : 0;
+}
+
+const char *
+tinit_get_status_name(const struct tinit_status_iter * iter)
+{
+	TINIT_ASSERT_STATUS_ITER(iter);
+
+	if (!iter->ext)
+		return NULL;
+
+	return &iter->status->conf_path[iter->len + 1];
+}
+
+const char *
+tinit_get_status_desc(const struct tinit_status_iter * iter)
+{
+	TINIT_ASSERT_STATUS_ITER(iter);
+
+	if (!iter->ext || !iter->ext->desc_len)
+		return NULL;
+
+	return &iter->status->conf_path[iter->len + 1 +
+	                                iter->ext->name_len + 1];
+}
+
 #else  /* !defined(CONFIG_TINIT_ASSERT) */
 
 #define TINIT_ASSERT_STATUS_ITER(_iter)
@@ -142,6 +194,19 @@ tinit_get_status_conf(const struct tinit_status_iter * iter)
 	return conf;
 }
 
+/*
+ * Check that an optional string carried by a status record fits into reply and
+ * is properly NUL terminated.
+ */
+static bool
+tinit_check_status_str(const char * str, size_t len, const char * end)
+{
+	if ((size_t)(end - str) <= len)
+		return false;
+
+	return strnlen(str, len + 1) == len;
+}
+
 static ssize_t
 tinit_parse_status_data(struct tinit_status_data * status, const char * end)
 {
@@ -192,24 +257,49 @@ tinit_parse_status_data(struct tinit_status_data * status, const char * end)
 	return -ENOENT;
 }
 
-int
-tinit_step_status(struct tinit_status_iter * iter)
+/*
+ * Parse status record located at @rec, prefixed by an extended header for
+ * extended replies.
+ */
+static int
+tinit_parse_status_record(struct tinit_status_iter * iter, char * rec)
 {
-	const struct tinit_status_data * curr = iter->status;
-	struct tinit_status_data *       nxt;
-	ssize_t                          len;
+	assert(iter);
+	assert(iter->end);
+	assert(rec);
+
+	const struct tinit_status_ext * ext = NULL;
+	struct tinit_status_data *      status;
+	ssize_t                         len;
 
-	nxt = (struct tinit_status_data *)
-	      ((char *)curr +
-	       stroll_round_upper(sizeof(*curr) + iter->len + 1,
-	                          sizeof(*curr)));
+	if (rec >= iter->end)
+		return -ENOENT;
+
+	if (iter->type == TINIT_XSTATUS_MSG_TYPE) {
+		ext = (const struct tinit_status_ext *)rec;
+		rec += sizeof(*ext);
+	}
 
-	len = tinit_parse_status_data(nxt, iter->end);
+	status = (struct tinit_status_data *)rec;
+	len = tinit_parse_status_data(status, iter->end);
 	if (len < 0)
-		return (int)len;
+		return -EPROTO;
+
+	if (ext) {
+		const char * str = &status->conf_path[len + 1];
+
+		if (!ext->name_len ||
+		    !tinit_check_status_str(str, ext->name_len, iter->end))
+			return -EPROTO;
 
+		str += ext->name_len + 1;
+		if (!tinit_check_status_str(str, ext->desc_len, iter->end))
+			return -EPROTO;
+	}
+
+	iter->ext = ext;
+	iter->status = status;
 	iter->len = len;
-	iter->status = nxt;
 
 	return 0;
 }
@@ -239,21 +329,100 @@ tinit_build_request(char                  buff[TINIT_REQUEST_SIZE_MAX],
 	return sizeof(*msg) + len + 1;
 }
 
+/* Build a request carrying no pattern. */
+static size_t
+tinit_build_plain_request(char                buff[TINIT_REQUEST_SIZE_MAX],
+                          uint16_t            seqno,
+                          enum tinit_msg_type type)
+{
+	assert(buff);
+	assert(type >= 0);
+	assert(type < TINIT_MSG_TYPE_NR);
+
+	struct tinit_request_msg * msg = (struct tinit_request_msg *)buff;
+
+	msg->seq = seqno;
+	msg->type = type;
+
+	return sizeof(*msg);
+}
+
+static size_t
+tinit_build_status_request(char                buff[TINIT_REQUEST_SIZE_MAX],
+                           uint16_t            seqno,
+                           enum tinit_msg_type type,
+                           unsigned int        flags,
+                           unsigned int        start,
+                           const char *        pattern,
+                           size_t              len)
+{
+	assert(buff);
+	assert((type == TINIT_STATUS_MSG_TYPE) ||
+	       (type == TINIT_XSTATUS_MSG_TYPE));
+	assert(!(flags & ~TINIT_STATUS_DESC_FLAG));
+	assert(start <= UINT16_MAX);
+	assert(pattern);
+	assert(*pattern);
+	assert(len < TINIT_SVC_PATTERN_MAX);
+	assert(pattern[len] == '\0');
+
+	struct tinit_status_msg * msg = (struct tinit_status_msg *)buff;
+
+	msg->seq = seqno;
+	msg->type = type;
+	msg->start = (uint16_t)start;
+	msg->flags = (uint16_t)flags;
+	memcpy(msg->pattern, pattern, len);
+	msg->pattern[len] = '\0';
+
+	return sizeof(*msg) + len + 1;
+}
+
+static size_t
+tinit_build_wait_request(char                 buff[TINIT_REQUEST_SIZE_MAX],
+                         uint16_t             seqno,
+                         const char *         name,
+                         size_t               len,
+                         enum tinit_svc_state state,
+                         unsigned int         tmout)
+{
+	assert(buff);
+	assert(name);
+	assert(*name);
+	assert(len < TINIT_SVC_PATTERN_MAX);
+	assert(name[len] == '\0');
+	assert(state <= TINIT_SVC_STOPPING_STAT);
+
+	struct tinit_wait_msg * msg = (struct tinit_wait_msg *)buff;
+
+	msg->seq = seqno;
+	msg->type = TINIT_WAIT_MSG_TYPE;
+	msg->state = (uint16_t)state;
+	msg->pad = 0;
+	msg->tmout = tmout;
+	memcpy(msg->name, name, len);
+	msg->name[len] = '\0';
+
+	return sizeof(*msg) + len + 1;
+}
+
 static int
 tinit_parse_status_reply(struct tinit_status_iter * iter,
                          const char *               buff,
-                         size_t                              size,
-                         uint16_t                            seqno)
+                         size_t                     size,
+                         uint16_t                   seqno,
+                         enum tinit_msg_type        type)
 {
 	assert(buff);
+	assert((type == TINIT_STATUS_MSG_TYPE) ||
+	       (type == TINIT_XSTATUS_MSG_TYPE));
 
 	struct tinit_status_reply * msg = (struct tinit_status_reply *)buff;
-	const char *                end;
-	ssize_t                     len;
+	int                         ret;
 
 	if ((size < sizeof(msg->head)) ||
 	    (msg->head.seq != seqno) ||
-	    (msg->head.type != TINIT_STATUS_MSG_TYPE))
+	    (msg->head.type != type))
 		return -EPROTO;
 
 	if (msg->head.ret)
@@ -262,23 +431,33 @@ tinit_parse_status_reply(struct tinit_status_iter * iter,
 	if (size < sizeof(*msg))
 	    return -EPROTO;
 
-	end = ((char *)msg) + size;
-	len = tinit_parse_status_data(&msg->statuses[0], end);
-	if (len < 0)
-		return -EPROTO;
-
 	iter->msg = msg;
-	iter->end = end;
-	iter->status = &msg->statuses[0];
-	iter->len = len;
-
-	return 0;
+	iter->end = ((char *)msg) + size;
+	iter->sock = NULL;
+	iter->type = type;
+	iter->next = msg->next;
+
+	ret = tinit_parse_status_record(
+		iter,
+		(char *)msg + stroll_round_upper(sizeof(*msg),
+		                                 TINIT_STATUS_ALIGN));
+	if (ret == -ENOENT)
+		/*
+		 * Empty page: services matched by previous pages are gone.
+		 * Only valid as the last page.
+		 */
+		return !msg->next ? -ENOENT : -EPROTO;
+
+	return !ret ? 0 : -EPROTO;
 }
 
-int
-tinit_load_status(struct tinit_sock *        sock,
+static int
+tinit_chat_status(struct tinit_sock *        sock,
+                  enum tinit_msg_type        type,
+                  unsigned int               flags,
+                  unsigned int               start,
                   const char *               pattern,
-                  size_t                              len,
+                  size_t                     len,
                   struct tinit_status_iter * iter)
 {
 	assert(sock);
@@ -292,11 +471,13 @@ tinit_load_status(struct tinit_sock *        sock,
 
 	ret = unsk_dgram_clnt_send(&sock->unsk,
 	                           req,
-	                           tinit_build_request(req,
-	                                               seqno,
-	                                               TINIT_STATUS_MSG_TYPE,
-	                                               pattern,
-	                                               len),
+	                           tinit_build_status_request(req,
+	                                                      seqno,
+	                                                      type,
+	                                                      flags,
+	                                                      start,
+	                                                      pattern,
+	                                                      len),
 	                           0);
 	if (ret)
 		return ret;
@@ -310,7 +491,78 @@ tinit_load_status(struct tinit_sock *        sock,
 	if (ret < 0)
 		return ret;
 
-	return tinit_parse_status_reply(iter, sock->reply, ret, seqno);
+	ret = tinit_parse_status_reply(iter, sock->reply, ret, seqno, type);
+	if (ret)
+		return ret;
+
+	/* Allow tinit_step_status() to fetch next pages. */
+	iter->sock = sock;
+	iter->pattern = pattern;
+	iter->plen = len;
+	iter->flags = (uint16_t)flags;
+
+	return 0;
+}
+
+int
+tinit_load_status(struct tinit_sock *        sock,
+                  const char *               pattern,
+                  size_t                     len,
+                  struct tinit_status_iter * iter)
+{
+	return tinit_chat_status(sock,
+	                         TINIT_STATUS_MSG_TYPE,
+	                         0,
+	                         0,
+	                         pattern,
+	                         len,
+	                         iter);
+}
+
+int
+tinit_load_xstatus(struct tinit_sock *        sock,
+                   const char *               pattern,
+                   size_t                     len,
+                   bool                       desc,
+                   struct tinit_status_iter * iter)
+{
+	return tinit_chat_status(sock,
+	                         TINIT_XSTATUS_MSG_TYPE,
+	                         desc ? TINIT_STATUS_DESC_FLAG : 0,
+	                         0,
+	                         pattern,
+	                         len,
+	                         iter);
+}
+
+int
+tinit_step_status(struct tinit_status_iter * iter)
+{
+	TINIT_ASSERT_STATUS_ITER(iter);
+
+	char * rec = iter->ext ? (char *)iter->ext : (char *)iter->status;
+	size_t sz = sizeof(*iter->status) + iter->len + 1;
+	int    ret;
+
+	if (iter->ext)
+		sz += sizeof(*iter->ext) +
+		      iter->ext->name_len + 1 +
+		      iter->ext->desc_len + 1;
+
+	ret = tinit_parse_status_record(
+		iter,
+		rec + stroll_round_upper(sz, TINIT_STATUS_ALIGN));
+	if ((ret != -ENOENT) || !iter->next || !iter->sock)
+		return ret;
+
+	/* Current page exhausted: fetch the next one. */
+	return tinit_chat_status(iter->sock,
+	                         iter->type,
+	                         iter->flags,
+	                         iter->next,
+	                         iter->pattern,
+	                         iter->plen,
+	                         iter);
 }
 
 static int
@@ -334,27 +586,19 @@ tinit_parse_named_reply(const char * buff,
 }
 
 static int
-tinit_named_chat(struct tinit_sock * sock,
-                 enum tinit_msg_type          type,
-                 const char *        name,
-                 size_t                       len)
+tinit_chat_request(struct tinit_sock * sock,
+                   enum tinit_msg_type type,
+                   const char *        req,
+                   size_t              size)
 {
 	assert(sock);
-	assert(name);
-	assert(tinit_parse_svc_name(name) == (ssize_t)len);
+	assert(req);
+	assert(size);
 
-	char     req[TINIT_REQUEST_SIZE_MAX];
 	uint16_t seqno = sock->seqno;
 	ssize_t  ret;
 
-	ret = unsk_dgram_clnt_send(&sock->unsk,
-	                           req,
-	                           tinit_build_request(req,
-	                                               seqno,
-	                                               type,
-	                                               name,
-	                                               len),
-	                           0);
+	ret = unsk_dgram_clnt_send(&sock->unsk, req, size, 0);
 	if (ret)
 		return ret;
 
@@ -370,6 +614,40 @@ tinit_named_chat(struct tinit_sock * sock,
 	return tinit_parse_named_reply(sock->reply, ret, seqno, type);
 }
 
+static int
+tinit_chat(struct tinit_sock * sock,
+           enum tinit_msg_type type,
+           const char *        name,
+           size_t              len)
+{
+	assert(sock);
+	assert(name);
+
+	char req[TINIT_REQUEST_SIZE_MAX];
+
+	return tinit_chat_request(sock,
+	                          type,
+	                          req,
+	                          tinit_build_request(req,
+	                                              sock->seqno,
+	                                              type,
+	                                              name,
+	                                              len));
+}
+
+static int
+tinit_named_chat(struct tinit_sock * sock,
+                 enum tinit_msg_type          type,
+                 const char *        name,
+                 size_t                       len)
+{
+	assert(sock);
+	assert(name);
+	assert(tinit_parse_svc_name(name) == (ssize_t)len);
+
+	return tinit_chat(sock, type, name, len);
+}
+
 int
 tinit_start_svc(struct tinit_sock * sock,
                 const char *        name,
@@ -411,42 +689,903 @@ tinit_switch_target(struct tinit_sock * sock,
 }
 
 int
-tinit_open_sock(struct tinit_sock * sock, uint16_t seqno)
+tinit_wait_svc(struct tinit_sock *  sock,
+               const char *         name,
+               size_t               len,
+               enum tinit_svc_state state,
+               unsigned int         tmout)
 {
 	assert(sock);
+	assert(name);
+	assert(tinit_parse_svc_name(name) == (ssize_t)len);
 
-	int err;
+	char     req[TINIT_REQUEST_SIZE_MAX];
+	uint16_t seqno = sock->seqno;
+	ssize_t  ret;
 
-	sock->reply = malloc(TINIT_MSG_SIZE_MAX);
-	if (!sock->reply)
-		return -errno;
+	ret = unsk_dgram_clnt_send(&sock->unsk,
+	                           req,
+	                           tinit_build_wait_request(req,
+	                                                    seqno,
+	                                                    name,
+	                                                    len,
+	                                                    state,
+	                                                    tmout),
+	                           0);
+	if (ret)
+		return ret;
 
-	err = unsk_dgram_clnt_open(&sock->unsk, SOCK_CLOEXEC);
-	if (err)
-		goto free;
+	sock->seqno++;
 
-	err = unsk_dgram_clnt_connect(&sock->unsk, TINIT_SOCK_PATH);
-	if (err)
-		goto close;
+	ret = unsk_dgram_clnt_recv(&sock->unsk,
+	                           sock->reply,
+	                           TINIT_MSG_SIZE_MAX,
+	                           0);
+	if (ret < 0)
+		return ret;
 
-	sock->seqno = seqno;
+	return tinit_parse_named_reply(sock->reply,
+	                               ret,
+	                               seqno,
+	                               TINIT_WAIT_MSG_TYPE);
+}
 
-	return 0;
+int
+tinit_reload_repo(struct tinit_sock * sock)
+{
+	assert(sock);
 
-close:
-	unsk_clnt_close(&sock->unsk);
-free:
-	free(sock->reply);
+	char req[TINIT_REQUEST_SIZE_MAX];
 
-	return err;
+	return tinit_chat_request(sock,
+	                          TINIT_RELOAD_REPO_MSG_TYPE,
+	                          req,
+	                          tinit_build_plain_request(
+	                                  req,
+	                                  sock->seqno,
+	                                  TINIT_RELOAD_REPO_MSG_TYPE));
 }
 
-void
-tinit_close_sock(struct tinit_sock * sock)
+ssize_t
+tinit_load_logs(struct tinit_sock * sock,
+                const char *        name,
+                size_t              len,
+                const char **       data)
 {
 	assert(sock);
-	assert(sock->reply);
+	assert(name);
+	assert(tinit_parse_svc_name(name) == (ssize_t)len);
+	assert(data);
 
-	unsk_clnt_close(&sock->unsk);
-	free(sock->reply);
+	char                            req[TINIT_REQUEST_SIZE_MAX];
+	uint16_t                        seqno = sock->seqno;
+	const struct tinit_logs_reply * msg;
+	ssize_t                         ret;
+
+	ret = unsk_dgram_clnt_send(&sock->unsk,
+	                           req,
+	                           tinit_build_request(req,
+	                                               seqno,
+	                                               TINIT_LOGS_MSG_TYPE,
+	                                               name,
+	                                               len),
+	                           0);
+	if (ret)
+		return ret;
+
+	sock->seqno++;
+
+	ret = unsk_dgram_clnt_recv(&sock->unsk,
+	                           sock->reply,
+	                           TINIT_MSG_SIZE_MAX,
+	                           0);
+	if (ret < 0)
+		return ret;
+
+	msg = (const struct tinit_logs_reply *)sock->reply;
+	if (((size_t)ret < sizeof(msg->head)) ||
+	    (msg->head.seq != seqno) ||
+	    (msg->head.type != TINIT_LOGS_MSG_TYPE))
+		return -EPROTO;
+
+	if (msg->head.ret)
+		return -((int)msg->head.ret);
+
+	if ((size_t)ret < sizeof(*msg))
+		return -EPROTO;
+
+	*data = msg->data;
+
+	return ret - (ssize_t)sizeof(*msg);
+}
+
+int
+tinit_load_events(struct tinit_sock *         sock,
+                  const struct tinit_event ** events)
+{
+	assert(sock);
+	assert(events);
+
+	char                              req[TINIT_REQUEST_SIZE_MAX];
+	uint16_t                          seqno = sock->seqno;
+	const struct tinit_events_reply * msg;
+	ssize_t                           ret;
+	size_t                            sz;
+
+	/* Requests must carry a non empty pattern: give a dummy one. */
+	ret = unsk_dgram_clnt_send(&sock->unsk,
+	                           req,
+	                           tinit_build_request(req,
+	                                               seqno,
+	                                               TINIT_EVENTS_MSG_TYPE,
+	                                               "*",
+	                                               1),
+	                           0);
+	if (ret)
+		return ret;
+
+	sock->seqno++;
+
+	ret = unsk_dgram_clnt_recv(&sock->unsk,
+	                           sock->reply,
+	                           TINIT_MSG_SIZE_MAX,
+	                           0);
+	if (ret < 0)
+		return ret;
+
+	msg = (const struct tinit_events_reply *)sock->reply;
+	if (((size_t)ret < sizeof(msg->head)) ||
+	    (msg->head.seq != seqno) ||
+	    (msg->head.type != TINIT_EVENTS_MSG_TYPE))
+		return -EPROTO;
+
+	if (msg->head.ret)
+		return -((int)msg->head.ret);
+
+	if ((size_t)ret < sizeof(*msg))
+		return -EPROTO;
+
+	sz = (size_t)ret - sizeof(*msg);
+	if (sz % sizeof(msg->events[0]))
+		return -EPROTO;
+
+	*events = msg->events;
+
+	return (int)(sz / sizeof(msg->events[0]));
+}
+
+int
+tinit_open_sock(struct tinit_sock * sock, uint16_t seqno)
+{
+	assert(sock);
+
+	int err;
+
+	sock->reply = malloc(TINIT_MSG_SIZE_MAX);
+	if (!sock->reply)
+		return -errno;
+
+	err = unsk_dgram_clnt_open(&sock->unsk, SOCK_CLOEXEC);
+	if (err)
+		goto free;
+
+	err = unsk_dgram_clnt_connect(&sock->unsk, TINIT_SOCK_PATH);
+	if (err)
+		goto close;
+
+	sock->seqno = seqno;
+
+	return 0;
+
+close:
+	unsk_clnt_close(&sock->unsk);
+free:
+	free(sock->reply);
+
+	return err;
+}
+
+void
+tinit_close_sock(struct tinit_sock * sock)
+{
+	assert(sock);
+	assert(sock->reply);
+
+	unsk_clnt_close(&sock->unsk);
+	free(sock->reply);
+}
+
+struct tinit_async_sock {
+	struct unsk_clnt          unsk;
+	uint16_t                  seqno;
+	unsigned int              nr;
+	/* Pending requests, in order of submission. */
+	struct tinit_async_req *  head;
+	struct tinit_async_req ** tail;
+	char *                    reply;
+	bool                      busy;
+	bool                      closed;
+};
+
+int
+tinit_async_get_fd(const struct tinit_async_sock * sock)
+{
+	assert(sock);
+
+	return sock->unsk.fd;
+}
+
+unsigned int
+tinit_async_count_pending(const struct tinit_async_sock * sock)
+{
+	assert(sock);
+
+	return sock->nr;
+}
+
+static void
+tinit_async_enqueue(struct tinit_async_sock * sock,
+                    struct tinit_async_req *  req)
+{
+	assert(sock);
+	assert(req);
+
+	req->next = NULL;
+	*sock->tail = req;
+	sock->tail = &req->next;
+	sock->nr++;
+}
+
+/* Remove request which link from previous request / list head is @link. */
+static void
+tinit_async_dequeue(struct tinit_async_sock *  sock,
+                    struct tinit_async_req **  link)
+{
+	assert(sock);
+	assert(sock->nr);
+	assert(link);
+	assert(*link);
+
+	struct tinit_async_req * req = *link;
+
+	*link = req->next;
+	if (sock->tail == &req->next)
+		sock->tail = link;
+	sock->nr--;
+}
+
+static uint64_t
+tinit_async_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return ((uint64_t)now.tv_sec * 1000ULL) +
+	       ((uint64_t)now.tv_nsec / 1000000ULL);
+}
+
+static int
+tinit_async_send(struct tinit_async_sock * sock,
+                 const char *              msg,
+                 size_t                    size,
+                 enum tinit_msg_type       type,
+                 unsigned int              tmout,
+                 struct tinit_async_req *  req,
+                 tinit_async_fn *          complete)
+{
+	assert(sock);
+	assert(sock->reply);
+	assert(msg);
+	assert(size);
+	assert(req);
+	assert(complete);
+
+	ssize_t ret;
+
+	ret = unsk_dgram_clnt_send(&sock->unsk, msg, size, MSG_DONTWAIT);
+	if (ret)
+		return ret;
+
+	req->expire = tinit_async_now() + TINIT_ASYNC_TMOUT + tmout;
+	req->seqno = sock->seqno++;
+	req->type = type;
+	req->complete = complete;
+	tinit_async_enqueue(sock, req);
+
+	return 0;
+}
+
+static int
+tinit_async_submit(struct tinit_async_sock * sock,
+                   enum tinit_msg_type       type,
+                   const char *              name,
+                   size_t                    len,
+                   struct tinit_async_req *  req,
+                   tinit_async_fn *          complete)
+{
+	assert(sock);
+
+	char msg[TINIT_REQUEST_SIZE_MAX];
+
+	return tinit_async_send(sock,
+	                        msg,
+	                        tinit_build_request(msg,
+	                                            sock->seqno,
+	                                            type,
+	                                            name,
+	                                            len),
+	                        type,
+	                        0,
+	                        req,
+	                        complete);
+}
+
+static int
+tinit_async_submit_named(struct tinit_async_sock * sock,
+                         enum tinit_msg_type       type,
+                         const char *              name,
+                         size_t                    len,
+                         struct tinit_async_req *  req,
+                         tinit_async_fn *          complete)
+{
+	assert(name);
+	assert(tinit_parse_svc_name(name) == (ssize_t)len);
+
+	return tinit_async_submit(sock, type, name, len, req, complete);
+}
+
+static int
+tinit_async_submit_status(struct tinit_async_sock * sock,
+                          enum tinit_msg_type       type,
+                          unsigned int              flags,
+                          const char *              pattern,
+                          size_t                    len,
+                          unsigned int              start,
+                          struct tinit_async_req *  req,
+                          tinit_async_fn *          complete)
+{
+	assert(sock);
+	assert(pattern);
+	assert(tinit_parse_svc_pattern(pattern) == (ssize_t)len);
+
+	char msg[TINIT_REQUEST_SIZE_MAX];
+
+	if (start > UINT16_MAX)
+		return -EINVAL;
+
+	return tinit_async_send(sock,
+	                        msg,
+	                        tinit_build_status_request(msg,
+	                                                   sock->seqno,
+	                                                   type,
+	                                                   flags,
+	                                                   start,
+	                                                   pattern,
+	                                                   len),
+	                        type,
+	                        0,
+	                        req,
+	                        complete);
+}
+
+int
+tinit_async_load_status(struct tinit_async_sock * sock,
+                        const char *              pattern,
+                        size_t                    len,
+                        unsigned int              start,
+                        struct tinit_async_req *  req,
+                        tinit_async_fn *          complete)
+{
+	return tinit_async_submit_status(sock,
+	                                 TINIT_STATUS_MSG_TYPE,
+	                                 0,
+	                                 pattern,
+	                                 len,
+	                                 start,
+	                                 req,
+	                                 complete);
+}
+
+int
+tinit_async_load_xstatus(struct tinit_async_sock * sock,
+                         const char *              pattern,
+                         size_t                    len,
+                         unsigned int              start,
+                         bool                      desc,
+                         struct tinit_async_req *  req,
+                         tinit_async_fn *          complete)
+{
+	return tinit_async_submit_status(sock,
+	                                 TINIT_XSTATUS_MSG_TYPE,
+	                                 desc ? TINIT_STATUS_DESC_FLAG : 0,
+	                                 pattern,
+	                                 len,
+	                                 start,
+	                                 req,
+	                                 complete);
+}
+
+int
+tinit_async_start_svc(struct tinit_async_sock * sock,
+                      const char *              name,
+                      size_t                    len,
+                      struct tinit_async_req *  req,
+                      tinit_async_fn *          complete)
+{
+	return tinit_async_submit_named(sock,
+	                                TINIT_START_MSG_TYPE,
+	                                name,
+	                                len,
+	                                req,
+	                                complete);
+}
+
+int
+tinit_async_stop_svc(struct tinit_async_sock * sock,
+                     const char *              name,
+                     size_t                    len,
+                     struct tinit_async_req *  req,
+                     tinit_async_fn *          complete)
+{
+	return tinit_async_submit_named(sock,
+	                                TINIT_STOP_MSG_TYPE,
+	                                name,
+	                                len,
+	                                req,
+	                                complete);
+}
+
+int
+tinit_async_restart_svc(struct tinit_async_sock * sock,
+                        const char *              name,
+                        size_t                    len,
+                        struct tinit_async_req *  req,
+                        tinit_async_fn *          complete)
+{
+	return tinit_async_submit_named(sock,
+	                                TINIT_RESTART_MSG_TYPE,
+	                                name,
+	                                len,
+	                                req,
+	                                complete);
+}
+
+int
+tinit_async_reload_svc(struct tinit_async_sock * sock,
+                       const char *              name,
+                       size_t                    len,
+                       struct tinit_async_req *  req,
+                       tinit_async_fn *          complete)
+{
+	return tinit_async_submit_named(sock,
+	                                TINIT_RELOAD_MSG_TYPE,
+	                                name,
+	                                len,
+	                                req,
+	                                complete);
+}
+
+int
+tinit_async_switch_target(struct tinit_async_sock * sock,
+                          const char *              name,
+                          size_t                    len,
+                          struct tinit_async_req *  req,
+                          tinit_async_fn *          complete)
+{
+	return tinit_async_submit_named(sock,
+	                                TINIT_SWITCH_MSG_TYPE,
+	                                name,
+	                                len,
+	                                req,
+	                                complete);
+}
+
+int
+tinit_async_wait_svc(struct tinit_async_sock * sock,
+                     const char *              name,
+                     size_t                    len,
+                     enum tinit_svc_state      state,
+                     unsigned int              tmout,
+                     struct tinit_async_req *  req,
+                     tinit_async_fn *          complete)
+{
+	assert(sock);
+	assert(name);
+	assert(tinit_parse_svc_name(name) == (ssize_t)len);
+
+	char msg[TINIT_REQUEST_SIZE_MAX];
+
+	return tinit_async_send(sock,
+	                        msg,
+	                        tinit_build_wait_request(msg,
+	                                                 sock->seqno,
+	                                                 name,
+	                                                 len,
+	                                                 state,
+	                                                 tmout),
+	                        TINIT_WAIT_MSG_TYPE,
+	                        tmout,
+	                        req,
+	                        complete);
+}
+
+int
+tinit_async_reload_repo(struct tinit_async_sock * sock,
+                        struct tinit_async_req *  req,
+                        tinit_async_fn *          complete)
+{
+	assert(sock);
+
+	char msg[TINIT_REQUEST_SIZE_MAX];
+
+	return tinit_async_send(sock,
+	                        msg,
+	                        tinit_build_plain_request(
+	                                msg,
+	                                sock->seqno,
+	                                TINIT_RELOAD_REPO_MSG_TYPE),
+	                        TINIT_RELOAD_REPO_MSG_TYPE,
+	                        0,
+	                        req,
+	                        complete);
+}
+
+/*
+ * Replies are sent back in order of reception: the matching request is most
+ * likely the oldest pending one.
+ *
+ * Return: link to matching request from previous one, NULL if not found.
+ */
+static struct tinit_async_req **
+tinit_async_find_req(struct tinit_async_sock * sock, uint16_t seqno)
+{
+	assert(sock);
+
+	struct tinit_async_req ** link;
+
+	for (link = &sock->head; *link; link = &(*link)->next) {
+		if ((*link)->seqno == seqno)
+			return link;
+	}
+
+	return NULL;
+}
+
+static void
+tinit_async_complete(struct tinit_async_sock * sock,
+                     struct tinit_async_req ** link,
+                     size_t                    size)
+{
+	assert(sock);
+	assert(link);
+
+	struct tinit_async_req * req = *link;
+
+	tinit_async_dequeue(sock, link);
+
+	if ((req->type == TINIT_STATUS_MSG_TYPE) ||
+	    (req->type == TINIT_XSTATUS_MSG_TYPE)) {
+		struct tinit_status_iter iter;
+		int                      ret;
+
+		ret = tinit_parse_status_reply(&iter,
+		                               sock->reply,
+		                               size,
+		                               req->seqno,
+		                               req->type);
+		req->complete(req, ret, !ret ? &iter : NULL);
+	}
+	else
+		req->complete(req,
+		              tinit_parse_named_reply(sock->reply,
+		                                      size,
+		                                      req->seqno,
+		                                      req->type),
+		              NULL);
+}
+
+static void
+tinit_async_free(struct tinit_async_sock * sock)
+{
+	assert(sock);
+
+	free(sock->reply);
+	free(sock);
+}
+
+/* Release socket once closed from within a callback. */
+static bool
+tinit_async_is_closed(struct tinit_async_sock * sock)
+{
+	assert(sock);
+
+	if (!sock->closed)
+		return false;
+
+	tinit_async_free(sock);
+
+	return true;
+}
+
+int
+tinit_async_get_tmout(const struct tinit_async_sock * sock)
+{
+	assert(sock);
+
+	const struct tinit_async_req * req;
+	uint64_t                       expire = UINT64_MAX;
+	uint64_t                       now;
+
+	if (!sock->nr)
+		return -1;
+
+	for (req = sock->head; req; req = req->next)
+		if (req->expire < expire)
+			expire = req->expire;
+
+	now = tinit_async_now();
+	if (expire <= now)
+		return 0;
+
+	return (int)stroll_min(expire - now, (uint64_t)INT_MAX);
+}
+
+/* Return: true when socket was closed, hence released, from a callback. */
+static bool
+tinit_async_expire_reqs(struct tinit_async_sock * sock)
+{
+	assert(sock);
+	assert(sock->reply);
+	assert(!sock->busy);
+
+	uint64_t now = tinit_async_now();
+
+	sock->busy = true;
+
+	while (sock->nr) {
+		struct tinit_async_req ** link;
+		struct tinit_async_req *  req;
+
+		for (link = &sock->head; *link; link = &(*link)->next) {
+			if ((*link)->expire <= now)
+				break;
+		}
+
+		req = *link;
+		if (!req)
+			break;
+
+		tinit_async_dequeue(sock, link);
+
+		req->complete(req, -ETIMEDOUT, NULL);
+		if (tinit_async_is_closed(sock))
+			return true;
+	}
+
+	sock->busy = false;
+
+	return false;
+}
+
+void
+tinit_async_expire(struct tinit_async_sock * sock)
+{
+	tinit_async_expire_reqs(sock);
+}
+
+int
+tinit_async_process(struct tinit_async_sock * sock)
+{
+	assert(sock);
+	assert(sock->reply);
+	assert(!sock->busy);
+
+	int ret;
+
+	sock->busy = true;
+
+	while (true) {
+		const struct tinit_reply_head * head;
+		struct tinit_async_req **       link;
+		ssize_t                         sz;
+
+		sz = unsk_dgram_clnt_recv(&sock->unsk,
+		                          sock->reply,
+		                          TINIT_MSG_SIZE_MAX,
+		                          MSG_DONTWAIT);
+		if (sz < 0) {
+			if (sz == -EINTR)
+				continue;
+
+			ret = (sz == -EAGAIN) ? 0 : (int)sz;
+			break;
+		}
+
+		if ((size_t)sz < sizeof(*head))
+			continue;
+
+		head = (const struct tinit_reply_head *)sock->reply;
+		link = tinit_async_find_req(sock, head->seq);
+		if (!link)
+			continue;
+
+		tinit_async_complete(sock, link, (size_t)sz);
+		if (tinit_async_is_closed(sock))
+			/* Closed from within completion callback. */
+			return 0;
+	}
+
+	sock->busy = false;
+
+	/* Replies may have been received too late for some requests. */
+	if (tinit_async_expire_reqs(sock))
+		return 0;
+
+	return ret;
+}
+
+struct tinit_async_sock *
+tinit_open_async_sock(uint16_t seqno)
+{
+	struct tinit_async_sock * sock;
+	int                       err;
+
+	sock = malloc(sizeof(*sock));
+	if (!sock)
+		return NULL;
+
+	sock->reply = malloc(TINIT_MSG_SIZE_MAX);
+	if (!sock->reply) {
+		err = -errno;
+		goto free;
+	}
+
+	err = unsk_dgram_clnt_open(&sock->unsk, SOCK_CLOEXEC | SOCK_NONBLOCK);
+	if (err)
+		goto free;
+
+	err = unsk_dgram_clnt_connect(&sock->unsk, TINIT_SOCK_PATH);
+	if (err)
+		goto close;
+
+	sock->seqno = seqno;
+	sock->nr = 0;
+	sock->head = NULL;
+	sock->tail = &sock->head;
+	sock->busy = false;
+	sock->closed = false;
+
+	return sock;
+
+close:
+	unsk_clnt_close(&sock->unsk);
+free:
+	tinit_async_free(sock);
+
+	errno = -err;
+
+	return NULL;
+}
+
+void
+tinit_close_async_sock(struct tinit_async_sock * sock)
+{
+	assert(sock);
+	assert(sock->reply);
+
+	assert(!sock->closed);
+
+	unsk_clnt_close(&sock->unsk);
+	sock->closed = true;
+
+	while (sock->head) {
+		struct tinit_async_req * req = sock->head;
+
+		tinit_async_dequeue(sock, &sock->head);
+
+		req->complete(req, -ECANCELED, NULL);
+	}
+
+	if (!sock->busy)
+		/*
+		 * Otherwise, called from within a completion callback: socket
+		 * is released once back into tinit_async_process() /
+		 * tinit_async_expire().
+		 */
+		tinit_async_free(sock);
+}
+
+static int
+tinit_send_fdstore_msg(enum tinit_fdstore_op op,
+                       const int *           fds,
+                       unsigned int          nr)
+{
+	assert(op < TINIT_FDSTORE_OP_NR);
+	assert(!nr || fds);
+	assert(nr <= TINIT_STORE_FD_MAX);
+
+	struct tinit_fdstore_msg  msg = { .op = (uint16_t)op };
+	struct sockaddr_un        addr = { .sun_family = AF_UNIX };
+	struct iovec              iov = {
+		.iov_base = &msg,
+		.iov_len  = sizeof(msg)
+	};
+	union {
+		char           buff[CMSG_SPACE(TINIT_STORE_FD_MAX *
+		                               sizeof(int))];
+		struct cmsghdr align;
+	}                         ctrl;
+	struct msghdr             hdr = {
+		.msg_name    = &addr,
+		.msg_namelen = sizeof(addr),
+		.msg_iov     = &iov,
+		.msg_iovlen  = 1
+	};
+	int                       sk;
+	int                       ret;
+
+	assert(sizeof(addr.sun_path) >= sizeof(TINIT_FDSTORE_PATH));
+	memcpy(addr.sun_path, TINIT_FDSTORE_PATH, sizeof(TINIT_FDSTORE_PATH));
+
+	if (nr) {
+		struct cmsghdr * cmsg;
+
+		hdr.msg_control = ctrl.buff;
+		hdr.msg_controllen = CMSG_SPACE(nr * sizeof(int));
+
+		cmsg = CMSG_FIRSTHDR(&hdr);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(nr * sizeof(int));
+		memcpy(CMSG_DATA(cmsg), fds, nr * sizeof(int));
+	}
+
+	sk = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (sk < 0)
+		return -errno;
+
+	if (sendmsg(sk, &hdr, MSG_NOSIGNAL) < 0)
+		ret = -errno;
+	else
+		ret = 0;
+
+	close(sk);
+
+	return ret;
+}
+
+int
+tinit_store_fds(const int * fds, unsigned int nr)
+{
+	assert(fds);
+
+	if (!nr || (nr > TINIT_STORE_FD_MAX))
+		return -EINVAL;
+
+	return tinit_send_fdstore_msg(TINIT_FDSTORE_PUSH_OP, fds, nr);
+}
+
+int
+tinit_flush_fds(void)
+{
+	return tinit_send_fdstore_msg(TINIT_FDSTORE_FLUSH_OP, NULL, 0);
+}
+
+int
+tinit_get_stored_fds(void)
+{
+	const char *  str;
+	char *        end;
+	unsigned long nr;
+
+	str = getenv(TINIT_STORE_FD_ENV);
+	if (!str || !*str)
+		return 0;
+
+	nr = strtoul(str, &end, 10);
+	if (*end || (nr > TINIT_STORE_FD_MAX))
+		return -EBADMSG;
+
+	return (int)nr;
 }
@@ -0,0 +1,427 @@
+/* Use GNU version of basename() */
+#ifndef _GNU_SOURCE
+#error Requires _GNU_SOURCE to be defined !
+#endif /* _GNU_SOURCE */
+
+#include <tinit/tinit.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <errno.h>
+#include <assert.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define err(_fmt, ...) \
+	fprintf(stderr, "%s: " _fmt ".\n", argv0, ## __VA_ARGS__)
+
+#define LOADGEN_CLIENTS_DFLT  (16U)
+#define LOADGEN_REQUESTS_DFLT (1000U)
+#define LOADGEN_CLIENTS_MAX   (1024U)
+#define LOADGEN_REQUESTS_MAX  (1000000U)
+
+enum loadgen_op {
+	STATUS_LOADGEN_OP,
+	START_LOADGEN_OP,
+	STOP_LOADGEN_OP,
+	RELOAD_LOADGEN_OP,
+	LOADGEN_OP_NR
+};
+
+static const char * const loadgen_op_names[] = {
+	[STATUS_LOADGEN_OP] = "status",
+	[START_LOADGEN_OP]  = "start",
+	[STOP_LOADGEN_OP]   = "stop",
+	[RELOAD_LOADGEN_OP] = "reload"
+};
+
+/*
+ * Per request sample shared between client processes and the parent one.
+ * Client processes only ever write to their own slice of the sample array.
+ */
+struct loadgen_sample {
+	uint64_t lat;
+	int32_t  ret;
+};
+
+static const char *    argv0;
+static const char *    loadgen_svc;
+static size_t          loadgen_svc_len;
+static enum loadgen_op loadgen_ops[LOADGEN_OP_NR];
+static unsigned int    loadgen_ops_nr;
+
+static uint64_t
+loadgen_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return ((uint64_t)now.tv_sec * 1000000000ULL) + (uint64_t)now.tv_nsec;
+}
+
+static int
+loadgen_request(struct tinit_sock * sock, enum loadgen_op op)
+{
+	assert(sock);
+
+	switch (op) {
+	case STATUS_LOADGEN_OP:
+		{
+			struct tinit_status_iter iter;
+
+			return tinit_load_status(sock,
+			                         loadgen_svc,
+			                         loadgen_svc_len,
+			                         &iter);
+		}
+
+	case START_LOADGEN_OP:
+		return tinit_start_svc(sock, loadgen_svc, loadgen_svc_len);
+
+	case STOP_LOADGEN_OP:
+		return tinit_stop_svc(sock, loadgen_svc, loadgen_svc_len);
+
+	case RELOAD_LOADGEN_OP:
+		return tinit_reload_svc(sock, loadgen_svc, loadgen_svc_len);
+
+	default:
+		assert(0);
+	}
+
+	unreachable();
+}
+
+/*
+ * Client process main loop: issue requests back-to-back, cycling over the
+ * requested operations, and record each request round-trip latency.
+ */
+static int
+loadgen_run_clnt(unsigned int            id,
+                 struct loadgen_sample * samples,
+                 unsigned int            nr)
+{
+	assert(samples);
+	assert(nr);
+
+	struct tinit_sock sock;
+	unsigned int      r;
+	int               err;
+
+	/*
+	 * Spread clients initial sequence numbers evenly over the whole
+	 * sequence number space.
+	 */
+	err = tinit_open_sock(&sock,
+	                      (uint16_t)(((unsigned long)id *
+	                                  (UINT16_MAX + 1UL)) /
+	                                 LOADGEN_CLIENTS_MAX));
+	if (err) {
+		err("client %u: cannot connect: %s (%d)",
+		    id,
+		    strerror(-err),
+		    -err);
+		return EXIT_FAILURE;
+	}
+
+	for (r = 0; r < nr; r++) {
+		enum loadgen_op op = loadgen_ops[(id + r) % loadgen_ops_nr];
+		uint64_t        start;
+
+		start = loadgen_now();
+		samples[r].ret = loadgen_request(&sock, op);
+		samples[r].lat = loadgen_now() - start;
+	}
+
+	tinit_close_sock(&sock);
+
+	return EXIT_SUCCESS;
+}
+
+static int
+loadgen_cmp_lat(const void * first, const void * second)
+{
+	uint64_t fst = *(const uint64_t *)first;
+	uint64_t snd = *(const uint64_t *)second;
+
+	return (fst > snd) - (fst < snd);
+}
+
+/* Nearest-rank percentile of sorted latencies. */
+static uint64_t
+loadgen_percentile(const uint64_t * lats, unsigned int nr, unsigned int pct)
+{
+	assert(lats);
+	assert(nr);
+	assert(pct <= 100);
+
+	unsigned int rank = (unsigned int)(((uint64_t)pct * nr + 99) / 100);
+
+	return lats[rank ? rank - 1 : 0];
+}
+
+static int
+loadgen_parse_ops(char * arg)
+{
+	assert(arg);
+
+	char * name;
+
+	loadgen_ops_nr = 0;
+	while ((name = strsep(&arg, ","))) {
+		unsigned int o;
+
+		for (o = 0; o < LOADGEN_OP_NR; o++)
+			if (!strcmp(name, loadgen_op_names[o]))
+				break;
+
+		if ((o == LOADGEN_OP_NR) || (loadgen_ops_nr == LOADGEN_OP_NR)) {
+			err("'%s': invalid operation", name);
+			return -EINVAL;
+		}
+
+		loadgen_ops[loadgen_ops_nr++] = o;
+	}
+
+	return 0;
+}
+
+static int
+loadgen_parse_uint(const char *   arg,
+                   const char *   what,
+                   unsigned int   min,
+                   unsigned int   max,
+                   unsigned int * value)
+{
+	assert(arg);
+	assert(what);
+	assert(value);
+
+	char *        end;
+	unsigned long val;
+
+	errno = 0;
+	val = strtoul(arg, &end, 0);
+	if (errno || (end == arg) || *end || (val < min) || (val > max)) {
+		err("'%s': invalid %s", arg, what);
+		return -EINVAL;
+	}
+
+	*value = (unsigned int)val;
+
+	return 0;
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+	        "Usage: %1$s [OPTIONS] SERVICE\n"
+	        "Generate control request load onto init.\n"
+	        "\n"
+	        "With OPTIONS:\n"
+	        "    -c CLIENTS  number of concurrent clients (default: %2$u)\n"
+	        "    -n REQS     requests per client (default: %3$u)\n"
+	        "    -o OPS      comma separated operations to cycle over\n"
+	        "                among status, start, stop and reload\n"
+	        "                (default: status)\n"
+	        "    -p USEC     fail when 99th percentile latency exceeds\n"
+	        "                USEC microseconds\n"
+	        "    -t RATE     fail when throughput is below RATE\n"
+	        "                requests per second\n",
+	        argv0,
+	        LOADGEN_CLIENTS_DFLT,
+	        LOADGEN_REQUESTS_DFLT);
+}
+
+int
+main(int argc, char * const argv[])
+{
+	unsigned int            clnts = LOADGEN_CLIENTS_DFLT;
+	unsigned int            reqs = LOADGEN_REQUESTS_DFLT;
+	unsigned int            max_p99 = 0;
+	unsigned int            min_rate = 0;
+	struct loadgen_sample * samples;
+	uint64_t *              lats;
+	unsigned int            nr;
+	unsigned int            c;
+	unsigned int            s;
+	unsigned int            fails = 0;
+	uint64_t                start;
+	uint64_t                elapsed;
+	unsigned int            rate;
+	uint64_t                p99;
+	int                     opt;
+	int                     ret = EXIT_FAILURE;
+
+	argv0 = basename(argv[0]);
+
+	loadgen_ops[0] = STATUS_LOADGEN_OP;
+	loadgen_ops_nr = 1;
+
+	while ((opt = getopt(argc, argv, "c:n:o:p:t:h")) != -1) {
+		switch (opt) {
+		case 'c':
+			if (loadgen_parse_uint(optarg,
+			                       "number of clients",
+			                       1,
+			                       LOADGEN_CLIENTS_MAX,
+			                       &clnts))
+				return EXIT_FAILURE;
+			break;
+
+		case 'n':
+			if (loadgen_parse_uint(optarg,
+			                       "number of requests",
+			                       1,
+			                       LOADGEN_REQUESTS_MAX,
+			                       &reqs))
+				return EXIT_FAILURE;
+			break;
+
+		case 'o':
+			if (loadgen_parse_ops(optarg))
+				return EXIT_FAILURE;
+			break;
+
+		case 'p':
+			if (loadgen_parse_uint(optarg,
+			                       "latency",
+			                       1,
+			                       UINT_MAX,
+			                       &max_p99))
+				return EXIT_FAILURE;
+			break;
+
+		case 't':
+			if (loadgen_parse_uint(optarg,
+			                       "throughput",
+			                       1,
+			                       UINT_MAX,
+			                       &min_rate))
+				return EXIT_FAILURE;
+			break;
+
+		case 'h':
+			usage();
+			return EXIT_SUCCESS;
+
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if ((argc - optind) != 1) {
+		err("missing arguments");
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	loadgen_svc = argv[optind];
+	if (tinit_parse_svc_pattern(loadgen_svc) <= 0) {
+		err("'%s': invalid service name", loadgen_svc);
+		return EXIT_FAILURE;
+	}
+	loadgen_svc_len = strlen(loadgen_svc);
+
+	nr = clnts * reqs;
+	samples = mmap(NULL,
+	               sizeof(*samples) * nr,
+	               PROT_READ | PROT_WRITE,
+	               MAP_SHARED | MAP_ANONYMOUS,
+	               -1,
+	               0);
+	if (samples == MAP_FAILED) {
+		err("cannot allocate samples: %s (%d)", strerror(errno), errno);
+		return EXIT_FAILURE;
+	}
+
+	/*
+	 * Run each client into its own process so that requests are really
+	 * issued concurrently: libtinit requests are synchronous.
+	 */
+	start = loadgen_now();
+	for (c = 0; c < clnts; c++) {
+		pid_t pid;
+
+		pid = fork();
+		if (pid < 0) {
+			err("cannot spawn client: %s (%d)",
+			    strerror(errno),
+			    errno);
+			break;
+		}
+		else if (!pid)
+			_exit(loadgen_run_clnt(c, &samples[c * reqs], reqs));
+	}
+
+	while (true) {
+		int stat;
+
+		if (wait(&stat) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		if (!WIFEXITED(stat) || WEXITSTATUS(stat))
+			fails++;
+	}
+	elapsed = loadgen_now() - start;
+
+	if (fails || (c != clnts)) {
+		err("%u client(s) failed", fails + (clnts - c));
+		goto unmap;
+	}
+
+	/* Latencies are sorted in place: reuse the sample array storage. */
+	lats = (uint64_t *)samples;
+	for (s = 0, fails = 0; s < nr; s++) {
+		if (samples[s].ret)
+			fails++;
+		lats[s] = samples[s].lat;
+	}
+	qsort(lats, nr, sizeof(*lats), loadgen_cmp_lat);
+
+	rate = (unsigned int)(((uint64_t)nr * 1000000000ULL) / (elapsed + 1));
+	p99 = loadgen_percentile(lats, nr, 99);
+
+	printf("clients:    %u\n"
+	       "requests:   %u (%u failed)\n"
+	       "elapsed:    %.3f ms\n"
+	       "throughput: %u req/s\n"
+	       "latency:    min %.1f us, p50 %.1f us, p99 %.1f us, "
+	       "max %.1f us\n",
+	       clnts,
+	       nr,
+	       fails,
+	       (double)elapsed / 1e6,
+	       rate,
+	       (double)lats[0] / 1e3,
+	       (double)loadgen_percentile(lats, nr, 50) / 1e3,
+	       (double)p99 / 1e3,
+	       (double)lats[nr - 1] / 1e3);
+
+	ret = EXIT_SUCCESS;
+
+	if (max_p99 && (p99 > ((uint64_t)max_p99 * 1000ULL))) {
+		err("99th percentile latency above %u us", max_p99);
+		ret = EXIT_FAILURE;
+	}
+
+	if (min_rate && (rate < min_rate)) {
+		err("throughput below %u req/s", min_rate);
+		ret = EXIT_FAILURE;
+	}
+
+unmap:
+	munmap(samples, sizeof(*samples) * nr);
+
+	return ret;
+}
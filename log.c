@@ -1,6 +1,8 @@
 #include "log.h"
 #include <utils/pwd.h>
+#include <stdio.h>
 #include <fcntl.h>
+#include <mqueue.h>
 #include <assert.h>
 
 #define CONFIG_TINIT_STDLOG_FORMAT   (ELOG_SEVERITY_FMT)
@@ -12,6 +14,7 @@
 #define CONFIG_TINIT_MQLOG_MODE      (S_IWUSR | S_IRGRP)
 #define CONFIG_TINIT_MQLOG_DEPTH     (64U)
 #define CONFIG_TINIT_MQLOG_GROUP     "elogd"
+#define CONFIG_TINIT_MQLOG_STAGE_NR  (128U)
 
 static struct elog_multi tinit_toplog;
 static struct elog_stdio tinit_stdlog;
@@ -95,8 +98,222 @@ fini:
 	elog_fini_parse(&parse);
 }
 
+/******************************************************************************
+ * Message queue logger staging area.
+ *
+ * Logger message queue is opened in non-blocking mode and may happen to be
+ * full during boot storms, in which case the message queue logger would
+ * silently drop messages.
+ * Messages are first formatted into a staging ring, then forwarded to the
+ * message queue logger as long as the message queue has room left. Remaining
+ * messages are flushed once the message queue becomes writable again.
+ * Messages that do not fit into the staging ring are accounted for and
+ * reported once the message queue has drained.
+ * Room left into the message queue is only probed once the previously probed
+ * room has been used up. Messages are forwarded as is, i.e. formatted once,
+ * as long as nothing is staged.
+ ******************************************************************************/
+
+struct tinit_mqlog_rec {
+	enum elog_severity severity;
+	char               msg[ELOG_LINE_MAX];
+};
+
+struct tinit_mqlog_stage {
+	struct elog            super;
+	struct upoll_worker    work;
+	const struct upoll *   poller;
+	mqd_t                  mqd;
+	long                   room;
+	bool                   watch;
+	unsigned int           head;
+	unsigned int           cnt;
+	unsigned long          drops;
+	struct tinit_mqlog_rec recs[CONFIG_TINIT_MQLOG_STAGE_NR];
+};
+
+static struct tinit_mqlog_stage tinit_mqstage;
+
+static bool
+tinit_mqstage_has_room(struct tinit_mqlog_stage * stage)
+{
+	assert(stage);
+
+	if (stage->room <= 0) {
+		struct mq_attr attr;
+
+		if (mq_getattr(stage->mqd, &attr))
+			return false;
+
+		stage->room = attr.mq_maxmsg - attr.mq_curmsgs;
+	}
+
+	return stage->room > 0;
+}
+
+/* Wait for message queue to drain only while messages are left behind. */
+static void
+tinit_mqstage_watch(struct tinit_mqlog_stage * stage, bool watch)
+{
+	assert(stage);
+
+	if (!stage->poller || (watch == stage->watch))
+		return;
+
+	if (watch)
+		upoll_enable_watch(&stage->work, EPOLLOUT);
+	else
+		upoll_disable_watch(&stage->work, EPOLLOUT);
+
+	upoll_apply(stage->poller, stage->mqd, &stage->work);
+	stage->watch = watch;
+}
+
+static void
+tinit_mqstage_flush(struct tinit_mqlog_stage * stage)
+{
+	assert(stage);
+	assert(tinit_mqlog);
+
+	while (stage->cnt && tinit_mqstage_has_room(stage)) {
+		const struct tinit_mqlog_rec * rec = &stage->recs[stage->head];
+
+		elog_log(tinit_mqlog, rec->severity, "%s", rec->msg);
+
+		stage->head = (stage->head + 1) % CONFIG_TINIT_MQLOG_STAGE_NR;
+		stage->cnt--;
+		stage->room--;
+	}
+
+	if (!stage->cnt && stage->drops && tinit_mqstage_has_room(stage)) {
+		elog_log(tinit_mqlog,
+		         ELOG_WARNING_SEVERITY,
+		         "%lu log message(s) dropped.",
+		         stage->drops);
+		stage->drops = 0;
+		stage->room--;
+	}
+
+	tinit_mqstage_watch(stage, stage->cnt || stage->drops);
+}
+
+static void
+tinit_mqstage_vlog(struct elog * __restrict   logger,
+                   enum elog_severity         severity,
+                   const char * __restrict    format,
+                   va_list                    args)
+{
+	struct tinit_mqlog_stage * stage = (struct tinit_mqlog_stage *)logger;
+	struct tinit_mqlog_rec *   rec;
+
+	if (severity > tinit_mqlog_conf.super.severity)
+		return;
+
+	if (!stage->cnt && !stage->drops && tinit_mqstage_has_room(stage)) {
+		/* Nothing left behind: forward straight away. */
+		elog_vlog(tinit_mqlog, severity, format, args);
+		stage->room--;
+		return;
+	}
+
+	if (stage->cnt == CONFIG_TINIT_MQLOG_STAGE_NR) {
+		stage->drops++;
+		return;
+	}
+
+	rec = &stage->recs[(stage->head + stage->cnt) %
+	                   CONFIG_TINIT_MQLOG_STAGE_NR];
+	rec->severity = severity;
+	vsnprintf(rec->msg, sizeof(rec->msg), format, args);
+	stage->cnt++;
+
+	if (stage->poller)
+		/* Forwarded once message queue has drained. */
+		tinit_mqstage_watch(stage, true);
+	else
+		/* No poller yet: forward as much as possible now. */
+		tinit_mqstage_flush(stage);
+}
+
+static void
+tinit_mqstage_fini(struct elog * __restrict logger __unused)
+{
+}
+
+static int
+tinit_mqstage_dispatch(struct upoll_worker * worker,
+                       uint32_t              state __unused,
+                       const struct upoll *  poller __unused)
+{
+	assert(worker);
+	assert(state & EPOLLOUT);
+	assert(poller);
+
+	struct tinit_mqlog_stage * stage = containerof(worker,
+	                                               struct tinit_mqlog_stage,
+	                                               work);
+
+	/* Message queue has drained: probe room left again. */
+	stage->room = 0;
+	tinit_mqstage_flush(stage);
+
+	return 0;
+}
+
+static void
+tinit_mqstage_init(struct tinit_mqlog_stage * stage, mqd_t mqd)
+{
+	stage->super.vlog = tinit_mqstage_vlog;
+	stage->super.fini = tinit_mqstage_fini;
+	stage->work.dispatch = tinit_mqstage_dispatch;
+	stage->poller = NULL;
+	stage->mqd = mqd;
+	stage->room = 0;
+	stage->watch = false;
+	stage->head = 0;
+	stage->cnt = 0;
+	stage->drops = 0;
+}
+
+void
+tinit_watch_logs(const struct upoll * poller)
+{
+	assert(poller);
+
+	int err;
+
+	if (!tinit_mqlog)
+		return;
+
+	err = upoll_register(poller, tinit_mqstage.mqd, 0, &tinit_mqstage.work);
+	if (err) {
+		tinit_warn("cannot watch logger message queue: %s (%d).",
+		           strerror(-err),
+		           -err);
+		return;
+	}
+
+	tinit_mqstage.poller = poller;
+	tinit_mqstage.watch = false;
+
+	/* Flush messages staged before the poller was available. */
+	tinit_mqstage_flush(&tinit_mqstage);
+}
+
+void
+tinit_unwatch_logs(const struct upoll * poller)
+{
+	assert(poller);
+
+	if (!tinit_mqstage.poller)
+		return;
+
+	upoll_unregister(poller, tinit_mqstage.mqd);
+	tinit_mqstage.poller = NULL;
+}
+
 static struct elog *
-tinit_create_mqueue(const struct elog_mqueue_conf * conf)
+tinit_create_mqueue(const struct elog_mqueue_conf * conf, mqd_t * mqdes)
 {
 	assert(conf);
 	assert(umq_validate_name(conf->name) > 0);
@@ -162,6 +379,8 @@ tinit_create_mqueue(const struct elog_mqueue_conf * conf)
 		goto close;
 	}
 
+	*mqdes = mqd;
+
 	return log;
 
 close:
@@ -177,7 +396,8 @@ tinit_postinit_logs(void)
 {
 	assert(tinit_logger);
 
-	int err;
+	int   err;
+	mqd_t mqd;
 
 	err = elog_register_multi_sublog(&tinit_toplog,
 	                                 (struct elog *)&tinit_stdlog);
@@ -188,15 +408,19 @@ tinit_postinit_logs(void)
 		return;
 	}
 
-	tinit_mqlog = tinit_create_mqueue(&tinit_mqlog_conf);
+	tinit_mqlog = tinit_create_mqueue(&tinit_mqlog_conf, &mqd);
 	if (tinit_mqlog) {
-		err = elog_register_multi_sublog(&tinit_toplog, tinit_mqlog);
+		tinit_mqstage_init(&tinit_mqstage, mqd);
+
+		err = elog_register_multi_sublog(&tinit_toplog,
+		                                 &tinit_mqstage.super);
 		if (err) {
 			tinit_warn("cannot register message queue logger: "
 			           "%s (%d).",
 			           strerror(-err),
 			           -err);
 			elog_destroy(tinit_mqlog);
+			tinit_mqlog = NULL;
 			return;
 		}
 
@@ -215,8 +439,68 @@ tinit_prefini_logs(void)
 
 	tinit_logger = (struct elog *)&tinit_stdlog;
 
-	if (tinit_mqlog)
+	if (tinit_mqlog) {
+		/* Last chance to forward staged messages. */
+		tinit_mqstage.poller = NULL;
+		tinit_mqstage.room = 0;
+		tinit_mqstage_flush(&tinit_mqstage);
+		if (tinit_mqstage.cnt || tinit_mqstage.drops)
+			tinit_warn("%lu log message(s) dropped.",
+			           tinit_mqstage.cnt + tinit_mqstage.drops);
+
 		elog_destroy(tinit_mqlog);
+	}
+}
+
+/* Whether message queue logger was torn down by tinit_reexec_logs(). */
+static bool tinit_mqlog_reexec;
+
+void
+tinit_reexec_logs(void)
+{
+	tinit_prefini_logs();
+
+	/*
+	 * Re-executed init creates logger message queue exclusively: remove it
+	 * first.
+	 */
+	if (tinit_mqlog) {
+		mq_unlink(tinit_mqlog_conf.name);
+		tinit_mqlog = NULL;
+		tinit_mqlog_reexec = true;
+	}
+}
+
+void
+tinit_resume_logs(const struct upoll * poller)
+{
+	assert(poller);
+	assert(tinit_logger == (struct elog *)&tinit_stdlog);
+	assert(!tinit_mqlog);
+
+	mqd_t mqd;
+
+	if (!tinit_mqlog_reexec)
+		return;
+
+	tinit_mqlog_reexec = false;
+
+	/*
+	 * Staging area is still registered as a sub-logger of the top-level
+	 * one: give it a new message queue.
+	 */
+	tinit_mqlog = tinit_create_mqueue(&tinit_mqlog_conf, &mqd);
+	if (!tinit_mqlog) {
+		tinit_warn("cannot restore message queue logger: %s (%d).",
+		           strerror(errno),
+		           errno);
+		return;
+	}
+
+	tinit_mqstage_init(&tinit_mqstage, mqd);
+	tinit_logger = (struct elog *)&tinit_toplog;
+
+	tinit_watch_logs(poller);
 }
 
 void
@@ -2,6 +2,7 @@
 #define _TINIT_LOG_H
 
 #include "common.h"
+#include <utils/poll.h>
 
 extern void
 tinit_parse_stdlog_arg(char * __restrict arg, size_t len);
@@ -15,10 +16,37 @@ tinit_preinit_logs(void);
 extern void
 tinit_postinit_logs(void);
 
+/*
+ * tinit_watch_logs() - Start flushing staged logger messages from poller.
+ *
+ * @poller: poller to register logger message queue to
+ *
+ * Messages which could not be forwarded to the logger message queue since it
+ * was full are flushed as soon as the message queue becomes writable again.
+ */
+extern void
+tinit_watch_logs(const struct upoll * poller);
+
+extern void
+tinit_unwatch_logs(const struct upoll * poller);
+
 extern void
 tinit_prefini_logs(void);
 
 extern void
 tinit_postfini_logs(void);
 
+extern void
+tinit_reexec_logs(void);
+
+/*
+ * tinit_resume_logs() - Restore loggers torn down by tinit_reexec_logs().
+ *
+ * @poller: poller to register logger message queue to
+ *
+ * Meant to be called when re-execution failed.
+ */
+extern void
+tinit_resume_logs(const struct upoll * poller);
+
 #endif /* _TINIT_LOG_H */
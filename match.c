@@ -0,0 +1,113 @@
+#include "match.h"
+#include <string.h>
+#include <fnmatch.h>
+#include <errno.h>
+
+#define TINIT_MATCH_FLAGS (FNM_NOESCAPE | FNM_PERIOD | FNM_EXTMATCH)
+
+/*
+ * Return length of the literal part leading pattern, i.e. up to the first
+ * wildcard or extended pattern opening. Backslashes are not special since
+ * FNM_NOESCAPE is given.
+ */
+static size_t
+tinit_match_scan_fixed(const char * pattern, size_t len)
+{
+	size_t c;
+
+	for (c = 0; c < len; c++) {
+		switch (pattern[c]) {
+		case '*':
+		case '?':
+		case '[':
+			return c;
+
+		case '+':
+		case '@':
+		case '!':
+			if (pattern[c + 1] == '(')
+				return c;
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	return len;
+}
+
+int
+tinit_match_name(const struct tinit_match * match, const char * name)
+{
+	assert(match);
+	assert(match->pattern);
+	assert(name);
+
+	size_t sz;
+	int    ret;
+
+	switch (match->kind) {
+	case TINIT_LITERAL_MATCH:
+		return !strcmp(name, match->pattern);
+
+	case TINIT_PREFIX_MATCH:
+		/* FNM_PERIOD: a leading '.' must be matched explicitly. */
+		if (!match->fixed && (*name == '.'))
+			return 0;
+		return !strncmp(name, match->pattern, match->fixed);
+
+	case TINIT_SUFFIX_MATCH:
+		if (*name == '.')
+			return 0;
+		sz = strlen(name);
+		if (sz < (match->len - 1))
+			return 0;
+		return !memcmp(&name[sz - (match->len - 1)],
+		               &match->pattern[1],
+		               match->len - 1);
+
+	case TINIT_GLOB_MATCH:
+		ret = fnmatch(match->pattern, name, TINIT_MATCH_FLAGS);
+		if (!ret)
+			return 1;
+		else if (ret == FNM_NOMATCH)
+			return 0;
+
+		return -EINVAL;
+
+	default:
+		assert(0);
+	}
+
+	unreachable();
+}
+
+void
+tinit_match_compile(struct tinit_match * match,
+                    const char *         pattern,
+                    size_t               len)
+{
+	assert(match);
+	assert(pattern);
+	assert(len);
+	assert(pattern[len] == '\0');
+
+	size_t fixed = tinit_match_scan_fixed(pattern, len);
+
+	if (fixed == len)
+		match->kind = TINIT_LITERAL_MATCH;
+	else if ((fixed == (len - 1)) && (pattern[fixed] == '*'))
+		match->kind = TINIT_PREFIX_MATCH;
+	else if (!fixed &&
+	         (pattern[0] == '*') &&
+	         (pattern[1] != '(') &&
+	         (tinit_match_scan_fixed(&pattern[1], len - 1) == (len - 1)))
+		match->kind = TINIT_SUFFIX_MATCH;
+	else
+		match->kind = TINIT_GLOB_MATCH;
+
+	match->pattern = pattern;
+	match->len = len;
+	match->fixed = fixed;
+}
@@ -0,0 +1,72 @@
+#ifndef _TINIT_MATCH_H
+#define _TINIT_MATCH_H
+
+#include "common.h"
+#include <assert.h>
+
+enum tinit_match_kind {
+	TINIT_LITERAL_MATCH, /* plain service name */
+	TINIT_PREFIX_MATCH,  /* literal prefix followed by a single '*' */
+	TINIT_SUFFIX_MATCH,  /* single '*' followed by a literal suffix */
+	TINIT_GLOB_MATCH     /* anything else, handed to fnmatch(3) */
+};
+
+/*
+ * struct tinit_match - Compiled service name pattern.
+ *
+ * @kind:    kind of matching required by pattern
+ * @pattern: the original pattern
+ * @len:     length of @pattern
+ * @fixed:   length of literal part leading @pattern
+ */
+struct tinit_match {
+	enum tinit_match_kind kind;
+	const char *          pattern;
+	size_t                len;
+	size_t                fixed;
+};
+
+/*
+ * tinit_match_fixed_len() - Length of literal prefix all matching names start
+ *                           with.
+ *
+ * Allows callers to restrict the set of names to match against to those
+ * sharing this prefix.
+ */
+static inline size_t
+tinit_match_fixed_len(const struct tinit_match * match)
+{
+	assert(match);
+	assert(match->pattern);
+
+	return match->fixed;
+}
+
+/*
+ * tinit_match_name() - Match a service name against a compiled pattern.
+ *
+ * @match: compiled pattern
+ * @name:  service name
+ *
+ * Return: 1 if @name matches, 0 if not, -EINVAL when pattern is invalid.
+ */
+extern int
+tinit_match_name(const struct tinit_match * match, const char * name);
+
+/*
+ * tinit_match_compile() - Compile a service name pattern.
+ *
+ * @match:   where to store compiled pattern
+ * @pattern: fnmatch(3) extended pattern
+ * @len:     length of @pattern
+ *
+ * Patterns made of a literal, a literal prefix or a literal suffix are matched
+ * without going through fnmatch(3). @pattern must remain valid as long as
+ * @match is used.
+ */
+extern void
+tinit_match_compile(struct tinit_match * match,
+                    const char *         pattern,
+                    size_t               len);
+
+#endif /* _TINIT_MATCH_H */
@@ -0,0 +1,693 @@
+#include "metrics.h"
+#include "proto.h"
+#include "repo.h"
+#include "svc.h"
+#include "conf.h"
+#include "log.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static const unsigned int
+tinit_metrics_bounds[TINIT_METRICS_LATENCY_NR - 1] =
+	TINIT_METRICS_LATENCY_BOUNDS;
+
+static unsigned long tinit_metrics_requests[TINIT_MSG_TYPE_NR];
+static unsigned long tinit_metrics_nospc;
+static double        tinit_metrics_clk_tck;
+
+/******************************************************************************
+ * Counters handling.
+ ******************************************************************************/
+
+void
+tinit_metrics_init_svc(struct tinit_svc_metrics * metrics)
+{
+	assert(metrics);
+
+	memset(metrics, 0, sizeof(*metrics));
+	metrics->since = tinit_metrics_now();
+}
+
+void
+tinit_metrics_change_svc(struct tinit_svc_metrics * metrics,
+                         enum tinit_svc_state       state)
+{
+	assert(metrics);
+
+	unsigned long long now = tinit_metrics_now();
+
+	switch (state) {
+	case TINIT_SVC_STARTING_STAT:
+		metrics->start = now;
+		break;
+
+	case TINIT_SVC_READY_STAT:
+		if (metrics->start) {
+			/* Latency in milliseconds. */
+			unsigned long long lat = (now - metrics->start) /
+			                         1000000ULL;
+			unsigned int       b;
+
+			for (b = 0;
+			     b < stroll_array_nr(tinit_metrics_bounds);
+			     b++) {
+				if (lat <= tinit_metrics_bounds[b])
+					break;
+			}
+
+			metrics->latency[b]++;
+			metrics->latency_sum += now - metrics->start;
+			metrics->start = 0;
+		}
+		break;
+
+	default:
+		metrics->start = 0;
+	}
+
+	metrics->since = now;
+}
+
+void
+tinit_metrics_reap_svc(struct tinit_svc_metrics * metrics,
+                       const siginfo_t *          info)
+{
+	assert(metrics);
+	assert(info);
+
+	if (info->si_code == CLD_EXITED) {
+		metrics->exit_status = info->si_status;
+		metrics->exit_signal = 0;
+	}
+	else {
+		metrics->exit_status = 0;
+		metrics->exit_signal = info->si_status;
+	}
+
+	metrics->utime += (unsigned long long)info->si_utime;
+	metrics->stime += (unsigned long long)info->si_stime;
+}
+
+void
+tinit_metrics_count_request(unsigned int type)
+{
+	assert(type < TINIT_MSG_TYPE_NR);
+
+	tinit_metrics_requests[type]++;
+}
+
+void
+tinit_metrics_count_nospc(void)
+{
+	tinit_metrics_nospc++;
+}
+
+/******************************************************************************
+ * Text exposition rendering.
+ ******************************************************************************/
+
+static void
+tinit_metrics_render_head(FILE *       stream,
+                          const char * name,
+                          const char * type,
+                          const char * help)
+{
+	fprintf(stream,
+	        "# HELP tinit_%s %s\n"
+	        "# TYPE tinit_%s %s\n",
+	        name,
+	        help,
+	        name,
+	        type);
+}
+
+/*
+ * Per-service metric families made of a single sample per service.
+ */
+typedef double (tinit_metrics_value_fn)(const struct svc * svc,
+                                        unsigned long long now);
+
+struct tinit_metrics_family {
+	const char *             name;
+	const char *             type;
+	const char *             help;
+	tinit_metrics_value_fn * value;
+};
+
+static double
+tinit_metrics_restarts(const struct svc * svc, unsigned long long now __unused)
+{
+	return (double)svc->metrics.restarts;
+}
+
+static double
+tinit_metrics_exit_status(const struct svc * svc,
+                          unsigned long long now __unused)
+{
+	return (double)svc->metrics.exit_status;
+}
+
+static double
+tinit_metrics_exit_signal(const struct svc * svc,
+                          unsigned long long now __unused)
+{
+	return (double)svc->metrics.exit_signal;
+}
+
+static double
+tinit_metrics_state(const struct svc * svc, unsigned long long now __unused)
+{
+	return (double)svc->state;
+}
+
+static double
+tinit_metrics_since(const struct svc * svc, unsigned long long now)
+{
+	return (double)(now - svc->metrics.since) / 1e9;
+}
+
+static double
+tinit_metrics_utime(const struct svc * svc, unsigned long long now __unused)
+{
+	return (double)svc->metrics.utime / tinit_metrics_clk_tck;
+}
+
+static double
+tinit_metrics_stime(const struct svc * svc, unsigned long long now __unused)
+{
+	return (double)svc->metrics.stime / tinit_metrics_clk_tck;
+}
+
+static const struct tinit_metrics_family tinit_metrics_families[] = {
+	{
+		.name  = "service_restarts_total",
+		.type  = "counter",
+		.help  = "Number of service process restarts.",
+		.value = tinit_metrics_restarts
+	},
+	{
+		.name  = "service_last_exit_status",
+		.type  = "gauge",
+		.help  = "Exit status of last service process.",
+		.value = tinit_metrics_exit_status
+	},
+	{
+		.name  = "service_last_exit_signal",
+		.type  = "gauge",
+		.help  = "Signal that killed last service process.",
+		.value = tinit_metrics_exit_signal
+	},
+	{
+		.name  = "service_state",
+		.type  = "gauge",
+		.help  = "Service state (0: stopped, 1: starting, 2: ready, "
+		         "3: stopping).",
+		.value = tinit_metrics_state
+	},
+	{
+		.name  = "service_state_seconds",
+		.type  = "gauge",
+		.help  = "Time spent in current state.",
+		.value = tinit_metrics_since
+	},
+	{
+		.name  = "service_user_cpu_seconds_total",
+		.type  = "counter",
+		.help  = "User CPU time of terminated service processes.",
+		.value = tinit_metrics_utime
+	},
+	{
+		.name  = "service_system_cpu_seconds_total",
+		.type  = "counter",
+		.help  = "System CPU time of terminated service processes.",
+		.value = tinit_metrics_stime
+	}
+};
+
+static void
+tinit_metrics_render_latency(FILE *             stream,
+                             const struct svc * svc,
+                             const char *       name)
+{
+	const struct tinit_svc_metrics * metrics = &svc->metrics;
+	unsigned long                    cnt = 0;
+	unsigned int                     b;
+
+	for (b = 0; b < stroll_array_nr(tinit_metrics_bounds); b++) {
+		cnt += metrics->latency[b];
+		fprintf(stream,
+		        "tinit_service_start_latency_seconds_bucket"
+		        "{service=\"%s\",le=\"%g\"} %lu\n",
+		        name,
+		        (double)tinit_metrics_bounds[b] / 1e3,
+		        cnt);
+	}
+	cnt += metrics->latency[b];
+
+	fprintf(stream,
+	        "tinit_service_start_latency_seconds_bucket"
+	        "{service=\"%s\",le=\"+Inf\"} %lu\n"
+	        "tinit_service_start_latency_seconds_sum"
+	        "{service=\"%s\"} %g\n"
+	        "tinit_service_start_latency_seconds_count"
+	        "{service=\"%s\"} %lu\n",
+	        name,
+	        cnt,
+	        name,
+	        (double)metrics->latency_sum / 1e9,
+	        name,
+	        cnt);
+}
+
+/*
+ * Samples of a family must be grouped together: render each per-service
+ * family into its own stream, the latency histogram being the last one, so
+ * that services are walked once only.
+ */
+#define TINIT_METRICS_PART_NR (stroll_array_nr(tinit_metrics_families) + 1)
+
+struct tinit_metrics_part {
+	FILE * stream;
+	char * text;
+	size_t size;
+};
+
+static int
+tinit_metrics_open_parts(struct tinit_metrics_part * parts)
+{
+	unsigned int p;
+
+	for (p = 0; p < TINIT_METRICS_PART_NR; p++) {
+		parts[p].text = NULL;
+		parts[p].stream = open_memstream(&parts[p].text,
+		                                 &parts[p].size);
+		if (!parts[p].stream)
+			goto close;
+	}
+
+	for (p = 0; p < stroll_array_nr(tinit_metrics_families); p++)
+		tinit_metrics_render_head(parts[p].stream,
+		                          tinit_metrics_families[p].name,
+		                          tinit_metrics_families[p].type,
+		                          tinit_metrics_families[p].help);
+
+	tinit_metrics_render_head(parts[p].stream,
+	                          "service_start_latency_seconds",
+	                          "histogram",
+	                          "Delay from service start to ready state.");
+
+	return 0;
+
+close:
+	while (p--) {
+		fclose(parts[p].stream);
+		free(parts[p].text);
+	}
+
+	return -ENOMEM;
+}
+
+static void
+tinit_metrics_render_svcs(struct tinit_metrics_part * parts,
+                          unsigned long long          now)
+{
+	const struct svc * svc;
+
+	tinit_repo_foreach(tinit_repo_get(), svc) {
+		const char * name = conf_get_name(svc->conf);
+		unsigned int f;
+
+		for (f = 0; f < stroll_array_nr(tinit_metrics_families); f++) {
+			const struct tinit_metrics_family * family =
+				&tinit_metrics_families[f];
+
+			fprintf(parts[f].stream,
+			        "tinit_%s{service=\"%s\"} %.15g\n",
+			        family->name,
+			        name,
+			        family->value(svc, now));
+		}
+
+		tinit_metrics_render_latency(parts[f].stream, svc, name);
+	}
+}
+
+/* Append parts to @stream then release them. */
+static int
+tinit_metrics_merge_parts(FILE * stream, struct tinit_metrics_part * parts)
+{
+	unsigned int p;
+	int          ret = 0;
+
+	for (p = 0; p < TINIT_METRICS_PART_NR; p++) {
+		if (fclose(parts[p].stream))
+			ret = -errno;
+		else if (!ret)
+			fwrite(parts[p].text, 1, parts[p].size, stream);
+
+		free(parts[p].text);
+	}
+
+	return ret;
+}
+
+static void
+tinit_metrics_render_requests(FILE * stream)
+{
+	static const char * const types[] = {
+		[TINIT_STATUS_MSG_TYPE]      = "status",
+		[TINIT_START_MSG_TYPE]       = "start",
+		[TINIT_STOP_MSG_TYPE]        = "stop",
+		[TINIT_RESTART_MSG_TYPE]     = "restart",
+		[TINIT_RELOAD_MSG_TYPE]      = "reload",
+		[TINIT_SWITCH_MSG_TYPE]      = "switch",
+		[TINIT_RELOAD_REPO_MSG_TYPE] = "reload_repo",
+		[TINIT_LOGS_MSG_TYPE]        = "logs",
+		[TINIT_EVENTS_MSG_TYPE]      = "events",
+		[TINIT_WAIT_MSG_TYPE]        = "wait",
+		[TINIT_XSTATUS_MSG_TYPE]     = "xstatus"
+	};
+	unsigned int t;
+
+	tinit_metrics_render_head(stream,
+	                          "control_requests_total",
+	                          "counter",
+	                          "Number of control requests by type.");
+	for (t = 0; t < stroll_array_nr(tinit_metrics_requests); t++)
+		fprintf(stream,
+		        "tinit_control_requests_total{type=\"%s\"} %lu\n",
+		        ((t < stroll_array_nr(types)) && types[t]) ? types[t] :
+		                                                     "unknown",
+		        tinit_metrics_requests[t]);
+
+	tinit_metrics_render_head(stream,
+	                          "control_replies_nospc_total",
+	                          "counter",
+	                          "Number of replies failed for lack of "
+	                          "space.");
+	fprintf(stream,
+	        "tinit_control_replies_nospc_total %lu\n",
+	        tinit_metrics_nospc);
+}
+
+static int
+tinit_metrics_render(char ** text, size_t * size)
+{
+	struct tinit_metrics_part parts[TINIT_METRICS_PART_NR];
+	FILE *                    stream;
+	int                       ret;
+
+	stream = open_memstream(text, size);
+	if (!stream)
+		return -errno;
+
+	ret = tinit_metrics_open_parts(parts);
+	if (!ret) {
+		tinit_metrics_render_svcs(parts, tinit_metrics_now());
+		ret = tinit_metrics_merge_parts(stream, parts);
+	}
+
+	tinit_metrics_render_requests(stream);
+
+	if (fclose(stream) && !ret)
+		ret = -errno;
+
+	return ret;
+}
+
+/******************************************************************************
+ * Exposition server.
+ ******************************************************************************/
+
+static void
+tinit_metrics_release_conn(struct tinit_metrics_conn * conn, bool watched)
+{
+	assert(conn);
+	assert(conn->fd >= 0);
+
+	if (watched)
+		upoll_unregister(conn->metrics->poller, conn->fd);
+	if (utimer_is_armed(&conn->timer))
+		utimer_cancel(&conn->timer);
+
+	close(conn->fd);
+	conn->fd = -1;
+
+	free(conn->text);
+	conn->text = NULL;
+}
+
+/*
+ * Send as much of the exposition as the client socket accepts without
+ * blocking.
+ *
+ * Return: 0 once fully sent, -EAGAIN when the socket is full, another negative
+ *         errno-like value otherwise.
+ */
+static int
+tinit_metrics_send(struct tinit_metrics_conn * conn)
+{
+	assert(conn);
+	assert(conn->fd >= 0);
+	assert(conn->text);
+
+	while (conn->off < conn->size) {
+		ssize_t ret;
+
+		ret = send(conn->fd,
+		           &conn->text[conn->off],
+		           conn->size - conn->off,
+		           MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+
+		conn->off += (size_t)ret;
+	}
+
+	return 0;
+}
+
+static int
+tinit_metrics_dispatch_conn(struct upoll_worker * worker,
+                            uint32_t              state,
+                            const struct upoll *  poller __unused)
+{
+	assert(worker);
+	assert(poller);
+
+	struct tinit_metrics_conn * conn;
+
+	conn = containerof(worker, struct tinit_metrics_conn, work);
+
+	if (!(state & (EPOLLERR | EPOLLHUP)) &&
+	    (tinit_metrics_send(conn) == -EAGAIN))
+		return 0;
+
+	tinit_metrics_release_conn(conn, true);
+
+	return 0;
+}
+
+static void
+tinit_metrics_expire_conn(struct utimer * timer)
+{
+	assert(timer);
+
+	struct tinit_metrics_conn * conn;
+
+	conn = containerof(timer, struct tinit_metrics_conn, timer);
+
+	tinit_info("metrics: client too slow: exposition truncated.");
+	tinit_metrics_release_conn(conn, true);
+}
+
+static void
+tinit_metrics_serve(struct tinit_metrics * metrics, int fd)
+{
+	assert(metrics);
+	assert(fd >= 0);
+
+	struct tinit_metrics_conn * conn = NULL;
+	unsigned int                c;
+	int                         err;
+
+	for (c = 0; c < stroll_array_nr(metrics->conns); c++) {
+		if (metrics->conns[c].fd < 0) {
+			conn = &metrics->conns[c];
+			break;
+		}
+	}
+
+	if (!conn) {
+		tinit_info("metrics: too many clients.");
+		close(fd);
+		return;
+	}
+
+	err = tinit_metrics_render(&conn->text, &conn->size);
+	if (err) {
+		tinit_warn("metrics: cannot render: %s (%d).",
+		           strerror(-err),
+		           -err);
+		free(conn->text);
+		conn->text = NULL;
+		close(fd);
+		return;
+	}
+
+	conn->fd = fd;
+	conn->off = 0;
+
+	/* Most of the time, exposition fits into the socket send buffer. */
+	err = tinit_metrics_send(conn);
+	if (err != -EAGAIN) {
+		tinit_metrics_release_conn(conn, false);
+		return;
+	}
+
+	/* Go on sending once the client has made room. */
+	err = upoll_register(metrics->poller, fd, EPOLLOUT, &conn->work);
+	if (err) {
+		tinit_info("metrics: exposition truncated.");
+		tinit_metrics_release_conn(conn, false);
+		return;
+	}
+
+	utimer_arm_sec(&conn->timer, TINIT_METRICS_CONN_TMOUT);
+}
+
+static int
+tinit_metrics_dispatch(struct upoll_worker * worker,
+                       uint32_t              state __unused,
+                       const struct upoll *  poller __unused)
+{
+	assert(worker);
+	assert(state & EPOLLIN);
+	assert(poller);
+
+	struct tinit_metrics * metrics;
+
+	metrics = containerof(worker, struct tinit_metrics, work);
+
+	while (true) {
+		int fd;
+
+		fd = accept4(metrics->fd,
+		             NULL,
+		             NULL,
+		             SOCK_CLOEXEC | SOCK_NONBLOCK);
+		if (fd < 0)
+			break;
+
+		tinit_metrics_serve(metrics, fd);
+	}
+
+	return 0;
+}
+
+int
+tinit_metrics_open(struct tinit_metrics * metrics,
+                   const char *           path,
+                   const struct upoll *   poller)
+{
+	assert(metrics);
+	assert(path);
+	assert(poller);
+
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	size_t             len;
+	int                fd;
+	mode_t             msk;
+	unsigned int       c;
+	int                err;
+
+	len = strnlen(path, sizeof(addr.sun_path));
+	if (len >= sizeof(addr.sun_path))
+		return -ENAMETOOLONG;
+	memcpy(addr.sun_path, path, len + 1);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (fd < 0) {
+		err = -errno;
+		goto err;
+	}
+
+	unlink(path);
+
+	msk = umask(~(S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP));
+	err = bind(fd, (const struct sockaddr *)&addr, sizeof(addr));
+	umask(msk);
+	if (err) {
+		err = -errno;
+		goto close;
+	}
+
+	if (listen(fd, 8)) {
+		err = -errno;
+		goto unlink;
+	}
+
+	metrics->work.dispatch = tinit_metrics_dispatch;
+	err = upoll_register(poller, fd, EPOLLIN, &metrics->work);
+	if (err)
+		goto unlink;
+
+	metrics->fd = fd;
+	metrics->poller = poller;
+	for (c = 0; c < stroll_array_nr(metrics->conns); c++) {
+		struct tinit_metrics_conn * conn = &metrics->conns[c];
+
+		conn->work.dispatch = tinit_metrics_dispatch_conn;
+		utimer_init(&conn->timer);
+		utimer_setup(&conn->timer, tinit_metrics_expire_conn);
+		conn->metrics = metrics;
+		conn->fd = -1;
+		conn->text = NULL;
+	}
+
+	/* Clock ticks rate does not change at runtime. */
+	tinit_metrics_clk_tck = (double)sysconf(_SC_CLK_TCK);
+
+	tinit_debug("metrics: opened.");
+
+	return 0;
+
+unlink:
+	unlink(path);
+close:
+	close(fd);
+err:
+	tinit_err("metrics: cannot open socket: '%s': %s (%d).",
+	          path,
+	          strerror(-err),
+	          -err);
+
+	return err;
+}
+
+void
+tinit_metrics_close(struct tinit_metrics * metrics,
+                    const struct upoll *   poller)
+{
+	assert(metrics);
+	assert(metrics->fd >= 0);
+	assert(poller);
+
+	unsigned int c;
+
+	for (c = 0; c < stroll_array_nr(metrics->conns); c++)
+		if (metrics->conns[c].fd >= 0)
+			tinit_metrics_release_conn(&metrics->conns[c], true);
+
+	upoll_unregister(poller, metrics->fd);
+	close(metrics->fd);
+}
@@ -0,0 +1,133 @@
+#ifndef _TINIT_METRICS_H
+#define _TINIT_METRICS_H
+
+#include "common.h"
+#include <tinit/tinit.h>
+#include <utils/poll.h>
+#include <utils/timer.h>
+#include <signal.h>
+#include <time.h>
+#include <assert.h>
+
+/*
+ * Start latency histogram bucket upper bounds (milliseconds), the last bucket
+ * being the implicit +Inf one.
+ */
+#define TINIT_METRICS_LATENCY_BOUNDS { 10U, 100U, 1000U, 10000U, 60000U }
+#define TINIT_METRICS_LATENCY_NR     (6U)
+
+/*
+ * struct tinit_svc_metrics - Per-service supervision counters.
+ *
+ * Updated upon service state changes so that scraping only consists in
+ * formatting counters.
+ */
+struct tinit_svc_metrics {
+	unsigned long      restarts;
+	int                exit_status;
+	int                exit_signal;
+	unsigned long long since;
+	unsigned long long start;
+	unsigned long long utime;
+	unsigned long long stime;
+	unsigned long long latency_sum;
+	unsigned long      latency[TINIT_METRICS_LATENCY_NR];
+};
+
+static inline unsigned long long
+tinit_metrics_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return ((unsigned long long)now.tv_sec * 1000000000ULL) +
+	       (unsigned long long)now.tv_nsec;
+}
+
+extern void
+tinit_metrics_init_svc(struct tinit_svc_metrics * metrics);
+
+/*
+ * tinit_metrics_change_svc() - Account for a service state change.
+ *
+ * @metrics: service metrics
+ * @state:   state service has just switched to
+ */
+extern void
+tinit_metrics_change_svc(struct tinit_svc_metrics * metrics,
+                         enum tinit_svc_state       state);
+
+/*
+ * tinit_metrics_reap_svc() - Account for a service process termination.
+ *
+ * @metrics: service metrics
+ * @info:    SIGCHLD information returned by waitid(2)
+ */
+extern void
+tinit_metrics_reap_svc(struct tinit_svc_metrics * metrics,
+                       const siginfo_t *          info);
+
+static inline void
+tinit_metrics_restart_svc(struct tinit_svc_metrics * metrics)
+{
+	assert(metrics);
+
+	metrics->restarts++;
+}
+
+extern void
+tinit_metrics_count_request(unsigned int type);
+
+extern void
+tinit_metrics_count_nospc(void);
+
+/* Maximum number of clients served concurrently. */
+#define TINIT_METRICS_CONN_NR    (4U)
+
+/* Delay granted to a client to fetch the whole exposition (seconds). */
+#define TINIT_METRICS_CONN_TMOUT (5U)
+
+struct tinit_metrics;
+
+/*
+ * struct tinit_metrics_conn - Metrics exposition client connection.
+ *
+ * Exposition is rendered once upon connection then sent as the client socket
+ * becomes writable.
+ */
+struct tinit_metrics_conn {
+	struct upoll_worker    work;
+	struct utimer          timer;
+	struct tinit_metrics * metrics;
+	int                    fd;
+	char *                 text;
+	size_t                 size;
+	size_t                 off;
+};
+
+/*
+ * struct tinit_metrics - Metrics exposition server.
+ *
+ * Serves a text exposition of supervision metrics, Prometheus style, to any
+ * client connecting to TINIT_METRICS_PATH unix stream socket. Requests are
+ * not read: metrics are written upon connection then the connection is
+ * closed.
+ */
+struct tinit_metrics {
+	struct upoll_worker       work;
+	int                       fd;
+	const struct upoll *      poller;
+	struct tinit_metrics_conn conns[TINIT_METRICS_CONN_NR];
+};
+
+extern int
+tinit_metrics_open(struct tinit_metrics * metrics,
+                   const char *           path,
+                   const struct upoll *   poller);
+
+extern void
+tinit_metrics_close(struct tinit_metrics * metrics,
+                    const struct upoll *   poller);
+
+#endif /* _TINIT_METRICS_H */
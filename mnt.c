@@ -6,10 +6,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
-#include <mntent.h>
+#include <unistd.h>
+#include <fcntl.h>
 #include <assert.h>
 #include <errno.h>
 #include <sys/mount.h>
+#include <sys/wait.h>
 
 struct mnt_table {
 	struct stroll_slist points;
@@ -247,9 +249,13 @@ static const struct mnt_fstype *
 mnt_find_fstype(struct mnt_table * table, const char * fstype)
 {
 	struct mnt_fstype * type;
+	size_t              len;
+
+	/* Ignore subtype if any, i.e. "fuse.sshfs" is a "fuse" filesystem. */
+	len = strcspn(fstype, ".");
 
 	stroll_slist_foreach_entry(&table->types, type, node)
-		if (!strncmp(type->name, fstype, sizeof(type->name)))
+		if (!strncmp(type->name, fstype, len) && !type->name[len])
 			return type;
 
 	return NULL;
@@ -288,11 +294,8 @@ mount_pseudo(const char *  dir,
 #define TINIT_MQUEUE_MODE  STROLL_CONCAT(0, CONFIG_TINIT_MQUEUE_MODE)
 
 static int
-mount_mqueue(void)
+mkdir_mqueue(void)
 {
-	int   err;
-	gid_t gid = 0;
-
 	if (upath_mkdir(TINIT_MQUEUE_MNTPT, S_IRWXU)) {
 		assert(errno != EFAULT);
 		assert(errno != ENAMETOOLONG);
@@ -306,12 +309,14 @@ mount_mqueue(void)
 		return -errno;
 	}
 
-	err = mount_pseudo(TINIT_MQUEUE_MNTPT,
-	                   "mqueue",
-	                   TINIT_PSEUDO_MNT_BASE_FLAGS | MS_NOATIME | MS_NODEV,
-	                   NULL);
-	if (err)
-		return err;
+	return 0;
+}
+
+static void
+setup_mqueue(void)
+{
+	int   err;
+	gid_t gid = 0;
 
 	err = upath_chmod(TINIT_MQUEUE_MNTPT, TINIT_MQUEUE_MODE);
 	if (err) {
@@ -319,7 +324,7 @@ mount_mqueue(void)
 		           "%s (%d)",
 		           strerror(-err),
 		           -err);
-		return 0;
+		return;
 	}
 
 	err = upwd_get_gid_byname(CONFIG_TINIT_MQUEUE_GROUP, &gid);
@@ -328,7 +333,7 @@ mount_mqueue(void)
 		           "message queue group: %s (%d).",
 		           strerror(-err),
 		           -err);
-		return 0;
+		return;
 	}
 
 	err = upath_chown(TINIT_MQUEUE_MNTPT, 0, gid);
@@ -337,24 +342,36 @@ mount_mqueue(void)
 		           "%s (%d)",
 		           strerror(-err),
 		           -err);
-
-	return 0;
 }
 
-#define TINIT_DEV_MNTPT "/dev"
-
 static int
-mount_devfs(void)
+mount_mqueue(void)
 {
 	int err;
 
-	err = mount_pseudo(TINIT_DEV_MNTPT,
-	                   "devtmpfs",
-	                   TINIT_PSEUDO_MNT_BASE_FLAGS | MS_NOATIME,
+	err = mkdir_mqueue();
+	if (err)
+		return err;
+
+	err = mount_pseudo(TINIT_MQUEUE_MNTPT,
+	                   "mqueue",
+	                   TINIT_PSEUDO_MNT_BASE_FLAGS | MS_NOATIME | MS_NODEV,
 	                   NULL);
 	if (err)
 		return err;
 
+	setup_mqueue();
+
+	return 0;
+}
+
+#define TINIT_DEV_MNTPT "/dev"
+
+static void
+setup_devfs(void)
+{
+	int err;
+
 	/*
 	 * For some reason, additional mount options are only applied at
 	 * remounting time...
@@ -377,6 +394,21 @@ mount_devfs(void)
 	err = upath_chmod(TINIT_DEV_MNTPT "/urandom", S_IRUSR | S_IWUSR |
 	                                              S_IRGRP |
 	                                              S_IROTH);
+}
+
+static int
+mount_devfs(void)
+{
+	int err;
+
+	err = mount_pseudo(TINIT_DEV_MNTPT,
+	                   "devtmpfs",
+	                   TINIT_PSEUDO_MNT_BASE_FLAGS | MS_NOATIME,
+	                   NULL);
+	if (err)
+		return err;
+
+	setup_devfs();
 
 	return 0;
 }
@@ -400,8 +432,8 @@ remount_root(void)
 	return 0;
 }
 
-int
-mnt_mount_all(void)
+static int
+mnt_mount_all_legacy(void)
 {
 	int err;
 
@@ -427,10 +459,234 @@ mnt_mount_all(void)
 	if (err)
 		return err;
 
-	err = mount_pseudo("/run",
-	                   "tmpfs",
-	                   TINIT_PSEUDO_MNT_BASE_FLAGS | MS_RELATIME,
-	                   CONFIG_TINIT_RUN_MNT_OPTS);
+	return mount_pseudo("/run",
+	                    "tmpfs",
+	                    TINIT_PSEUDO_MNT_BASE_FLAGS | MS_RELATIME,
+	                    CONFIG_TINIT_RUN_MNT_OPTS);
+}
+
+#if defined(FSOPEN_CLOEXEC)
+
+/*
+ * Pseudo filesystems mounted using the new mount API, in attaching order.
+ * See fsopen(2), fsconfig(2), fsmount(2) and move_mount(2).
+ */
+
+#define TINIT_PSEUDO_MNT_BASE_ATTRS \
+	(MOUNT_ATTR_NODIRATIME | MOUNT_ATTR_NOEXEC | MOUNT_ATTR_NOSUID)
+
+struct mnt_pseudo {
+	const char * dir;
+	const char * type;
+	unsigned int attrs;
+	const char * opts;
+};
+
+static const struct mnt_pseudo mnt_pseudos[] = {
+	{
+		.dir   = "/proc",
+		.type  = "proc",
+		.attrs = TINIT_PSEUDO_MNT_BASE_ATTRS |
+		         MOUNT_ATTR_NOATIME |
+		         MOUNT_ATTR_NODEV,
+		.opts  = CONFIG_TINIT_PROC_MNT_OPTS
+	},
+	{
+		.dir   = "/sys",
+		.type  = "sysfs",
+		.attrs = TINIT_PSEUDO_MNT_BASE_ATTRS |
+		         MOUNT_ATTR_NOATIME |
+		         MOUNT_ATTR_NODEV,
+		.opts  = NULL
+	},
+	{
+		.dir   = TINIT_DEV_MNTPT,
+		.type  = "devtmpfs",
+		.attrs = TINIT_PSEUDO_MNT_BASE_ATTRS | MOUNT_ATTR_NOATIME,
+		.opts  = NULL
+	},
+	{
+		.dir   = TINIT_MQUEUE_MNTPT,
+		.type  = "mqueue",
+		.attrs = TINIT_PSEUDO_MNT_BASE_ATTRS |
+		         MOUNT_ATTR_NOATIME |
+		         MOUNT_ATTR_NODEV,
+		.opts  = NULL
+	},
+	{
+		.dir   = "/run",
+		.type  = "tmpfs",
+		.attrs = TINIT_PSEUDO_MNT_BASE_ATTRS | MOUNT_ATTR_RELATIME,
+		.opts  = CONFIG_TINIT_RUN_MNT_OPTS
+	}
+};
+
+/* Feed a comma separated list of mount options to a filesystem context. */
+static int
+mnt_fsapi_config(int fsfd, const char * opts)
+{
+	assert(fsfd >= 0);
+
+	char * str;
+	char * left;
+	char * opt;
+	int    err = 0;
+
+	if (!opts || !opts[0])
+		return 0;
+
+	str = strdup(opts);
+	if (!str)
+		return -errno;
+
+	left = str;
+	while ((opt = strsep(&left, ","))) {
+		char * val;
+		int    ret;
+
+		if (!opt[0])
+			continue;
+
+		val = strchr(opt, '=');
+		if (val) {
+			*val++ = '\0';
+			ret = fsconfig(fsfd, FSCONFIG_SET_STRING, opt, val, 0);
+		}
+		else
+			ret = fsconfig(fsfd, FSCONFIG_SET_FLAG, opt, NULL, 0);
+
+		if (ret) {
+			err = -errno;
+			break;
+		}
+	}
+
+	free(str);
+
+	return err;
+}
+
+/* Create a detached mount for the given pseudo filesystem. */
+static int
+mnt_fsapi_prepare(const struct mnt_pseudo * pseudo)
+{
+	assert(pseudo);
+
+	int fsfd;
+	int mntfd;
+	int err;
+
+	fsfd = fsopen(pseudo->type, FSOPEN_CLOEXEC);
+	if (fsfd < 0)
+		return -errno;
+
+	err = mnt_fsapi_config(fsfd, pseudo->opts);
+	if (err)
+		goto close;
+
+	if (fsconfig(fsfd, FSCONFIG_CMD_CREATE, NULL, NULL, 0)) {
+		err = -errno;
+		goto close;
+	}
+
+	mntfd = fsmount(fsfd, FSMOUNT_CLOEXEC, pseudo->attrs);
+	if (mntfd < 0) {
+		err = -errno;
+		goto close;
+	}
+
+	close(fsfd);
+
+	return mntfd;
+
+close:
+	close(fsfd);
+
+	return err;
+}
+
+/*
+ * Prepare all pseudo filesystems first, then attach them.
+ *
+ * Return: -ENOSYS when the new mount API is not supported and nothing has been
+ *         mounted.
+ */
+static int
+mnt_mount_all_fsapi(void)
+{
+	int          fds[stroll_array_nr(mnt_pseudos)];
+	unsigned int nr;
+	unsigned int p;
+	int          err;
+
+	for (nr = 0; nr < stroll_array_nr(mnt_pseudos); nr++) {
+		fds[nr] = mnt_fsapi_prepare(&mnt_pseudos[nr]);
+		if (fds[nr] < 0) {
+			err = fds[nr];
+			if (!nr && (err == -ENOSYS))
+				return -ENOSYS;
+
+			tinit_err("'%s': cannot prepare filesystem: %s (%d).",
+			          mnt_pseudos[nr].dir,
+			          strerror(-err),
+			          -err);
+			goto close;
+		}
+	}
+
+	for (p = 0; p < nr; p++) {
+		const struct mnt_pseudo * pseudo = &mnt_pseudos[p];
+
+		/* Message queue mount point lives into devtmpfs. */
+		if (!strcmp(pseudo->dir, TINIT_MQUEUE_MNTPT)) {
+			err = mkdir_mqueue();
+			if (err)
+				goto close;
+		}
+
+		if (move_mount(fds[p],
+		               "",
+		               AT_FDCWD,
+		               pseudo->dir,
+		               MOVE_MOUNT_F_EMPTY_PATH)) {
+			err = -errno;
+			tinit_err("'%s': cannot mount filesystem: %s (%d).",
+			          pseudo->dir,
+			          strerror(-err),
+			          -err);
+			goto close;
+		}
+	}
+
+	setup_devfs();
+	setup_mqueue();
+
+	err = 0;
+
+close:
+	for (p = 0; p < nr; p++)
+		close(fds[p]);
+
+	return err;
+}
+
+#else  /* !defined(FSOPEN_CLOEXEC) */
+
+static inline int mnt_mount_all_fsapi(void) { return -ENOSYS; }
+
+#endif /* defined(FSOPEN_CLOEXEC) */
+
+int
+mnt_mount_all(void)
+{
+	int err;
+
+	err = mnt_mount_all_fsapi();
+	if (err == -ENOSYS) {
+		tinit_debug("new mount API not supported: "
+		            "falling back to legacy one.");
+		err = mnt_mount_all_legacy();
+	}
 	if (err)
 		return err;
 
@@ -459,9 +715,19 @@ mnt_mount_all(void)
  * Unmount handling.
  ******************************************************************************/
 
+/*
+ * Maximum number of mount point subtrees unmounted concurrently, i.e. maximum
+ * number of unmount worker processes.
+ */
+#define MNT_WORKER_MAX (16U)
+
 struct mnt_point {
 	struct stroll_slist_node node;
-	char                     fsname[PATH_MAX];
+	struct stroll_slist_node sibling;
+	struct stroll_slist      children;
+	const struct mnt_point * parent;
+	unsigned int             id;
+	unsigned int             parent_id;
 	char                     dir[PATH_MAX];
 	char                     type[FSTYPE_MAX];
 };
@@ -470,11 +736,13 @@ static int
 mnt_strcpy(char * dest, const char * src, size_t size)
 {
 	assert(dest);
-	assert(src);
 	assert(size);
 
 	size_t len;
 
+	if (!src || !src[0])
+		return -EBADMSG;
+
 	len = strnlen(src, size);
 	if (len >= size)
 		return -ENAMETOOLONG;
@@ -485,41 +753,128 @@ mnt_strcpy(char * dest, const char * src, size_t size)
 	return 0;
 }
 
+/*
+ * Decode mountinfo escaped characters, i.e. space, tab, newline and backslash
+ * encoded as octal sequences (\040, \011, \012, \134).
+ */
+static int
+mnt_unescape(char * dest, const char * src, size_t size)
+{
+	assert(dest);
+	assert(src);
+	assert(size);
+
+	size_t len = 0;
+
+	while (*src) {
+		if (len >= (size - 1))
+			return -ENAMETOOLONG;
+
+		if ((src[0] == '\\') &&
+		    (src[1] >= '0') && (src[1] <= '3') &&
+		    (src[2] >= '0') && (src[2] <= '7') &&
+		    (src[3] >= '0') && (src[3] <= '7')) {
+			dest[len++] = (char)(((src[1] - '0') << 6) |
+			                     ((src[2] - '0') << 3) |
+			                     (src[3] - '0'));
+			src += 4;
+		}
+		else
+			dest[len++] = *src++;
+	}
+
+	dest[len] = '\0';
+
+	return 0;
+}
+
+/*
+ * Parse a /proc/self/mountinfo line, i.e.:
+ *     36 35 98:0 /mnt1 /mnt/parent rw,noatime master:1 - ext3 /dev/root rw
+ * where fields are: mount ID, parent mount ID, major:minor, root, mount point,
+ * mount options, optional fields terminated by a single hyphen, filesystem
+ * type, source and super block options.
+ * See proc(5).
+ */
+static int
+mnt_parse_id(const char * field, unsigned int * id)
+{
+	char *        end;
+	unsigned long val;
+
+	if (!field || !field[0])
+		return -EBADMSG;
+
+	errno = 0;
+	val = strtoul(field, &end, 10);
+	if (*end || errno || (val > UINT_MAX))
+		return -EBADMSG;
+
+	*id = (unsigned int)val;
+
+	return 0;
+}
+
 static struct mnt_point *
-mnt_create_point(const struct mntent * entry)
+mnt_create_point(char * line)
 {
-	assert(entry);
+	assert(line);
 
 	struct mnt_point * pt;
+	char *             sep;
+	char *             left = line;
+	const char *       dir;
 	int                err;
 
 	pt = malloc(sizeof(*pt));
 	if (!pt)
 		return NULL;
 
-	err = mnt_strcpy(pt->fsname, entry->mnt_fsname, sizeof(pt->fsname));
+	/* Locate end of optional fields. */
+	sep = strstr(line, " - ");
+	if (!sep) {
+		err = -EBADMSG;
+		goto free;
+	}
+	*sep = '\0';
+	sep += 3;
+
+	err = mnt_parse_id(strsep(&left, " "), &pt->id);
 	if (err)
 		goto free;
 
-	err = mnt_strcpy(pt->dir, entry->mnt_dir, sizeof(pt->dir));
+	err = mnt_parse_id(strsep(&left, " "), &pt->parent_id);
 	if (err)
 		goto free;
 
-	err = mnt_strcpy(pt->type, entry->mnt_type, sizeof(pt->type));
+	/* Skip major:minor and root fields. */
+	strsep(&left, " ");
+	strsep(&left, " ");
+
+	dir = strsep(&left, " ");
+	if (!dir || !dir[0]) {
+		err = -EBADMSG;
+		goto free;
+	}
+
+	err = mnt_unescape(pt->dir, dir, sizeof(pt->dir));
 	if (err)
 		goto free;
 
+	/* Strip trailing newline when there are no more fields. */
+	sep[strcspn(sep, "\n")] = '\0';
+	err = mnt_strcpy(pt->type, strsep(&sep, " "), sizeof(pt->type));
+	if (err)
+		goto free;
+
+	stroll_slist_init(&pt->children);
+	pt->parent = NULL;
+
 	return pt;
 
 free:
 	free(pt);
 
-	if (err != -ENOMEM)
-		tinit_err("'%.16s': cannot probe mountpoint: %s (%d).",
-		          entry->mnt_dir,
-		          strerror(-err),
-		          -err);
-
 	errno = -err;
 	return NULL;
 }
@@ -548,29 +903,108 @@ mnt_release_points(struct mnt_table * table)
 	}
 }
 
+static int
+mnt_cmp_point_id(const void * first, const void * second)
+{
+	unsigned int fst = (*(const struct mnt_point * const *)first)->id;
+	unsigned int snd = (*(const struct mnt_point * const *)second)->id;
+
+	return (fst > snd) - (fst < snd);
+}
+
+static int
+mnt_search_point_id(const void * key, const void * point)
+{
+	unsigned int id = *(const unsigned int *)key;
+	unsigned int cur = (*(const struct mnt_point * const *)point)->id;
+
+	return (id > cur) - (id < cur);
+}
+
+/*
+ * Link mount points to their parent so that the table may be walked as a tree.
+ * Children are queued in reverse mounting order so that the most recent mount
+ * point is unmounted first.
+ * Parents are looked up into an array of mount points sorted by mount ID to
+ * keep it O(n.log(n)) since namespaces may host thousands of mount points.
+ */
+static int
+mnt_build_tree(struct mnt_table * table)
+{
+	assert(table);
+
+	struct mnt_point *  pt;
+	struct mnt_point ** sorted;
+	size_t              nr = 0;
+
+	stroll_slist_foreach_entry(&table->points, pt, node)
+		nr++;
+
+	if (!nr)
+		return 0;
+
+	sorted = malloc(nr * sizeof(sorted[0]));
+	if (!sorted)
+		return -errno;
+
+	nr = 0;
+	stroll_slist_foreach_entry(&table->points, pt, node)
+		sorted[nr++] = pt;
+
+	qsort(sorted, nr, sizeof(sorted[0]), mnt_cmp_point_id);
+
+	stroll_slist_foreach_entry(&table->points, pt, node) {
+		struct mnt_point ** parent;
+
+		parent = bsearch(&pt->parent_id,
+		                 sorted,
+		                 nr,
+		                 sizeof(sorted[0]),
+		                 mnt_search_point_id);
+		if (!parent || (*parent == pt))
+			continue;
+
+		pt->parent = *parent;
+		stroll_slist_nqueue_front(&(*parent)->children, &pt->sibling);
+	}
+
+	free(sorted);
+
+	return 0;
+}
+
 static int
 mnt_load_points(struct mnt_table * table)
 {
 	assert(table);
 
-	FILE * mnt;
+	FILE * file;
+	char * ln;
+	size_t max = LINE_MAX;
 	int    ret;
 
-	mnt = setmntent(CONFIG_TINIT_MNTTAB_PATH, "r");
-	if (!mnt) {
-		assert(errno != EINVAL);
+	file = fopen(CONFIG_TINIT_MNTINFO_PATH, "r");
+	if (!file)
 		return -errno;
+
+	ln = malloc(max);
+	if (!ln) {
+		ret = -errno;
+		goto close;
 	}
 
 	stroll_slist_init(&table->points);
 
 	while (true) {
-		struct mntent    * ent;
+		ssize_t            len;
 		struct mnt_point * pt;
 
-		ent = getmntent(mnt);
-		if (!ent) {
-			if (errno = EAGAIN)
+		errno = 0;
+		len = getline(&ln, &max, file);
+		if (len < 0) {
+			assert(errno != EINVAL);
+
+			if (!errno || (errno == EAGAIN))
 				/* End of file. */
 				break;
 
@@ -578,31 +1012,31 @@ mnt_load_points(struct mnt_table * table)
 			tinit_err("cannot fetch mount point infos: %s (%d).",
 			          strerror(-ret),
 			          -ret);
-			goto end;
+			goto free;
 		}
 
-		pt = mnt_create_point(ent);
+		pt = mnt_create_point(ln);
 		if (!pt) {
 			if (errno == ENOMEM) {
 				ret = -ENOMEM;
-				goto end;
+				goto free;
 			}
 
-			tinit_err("'%s': "
-			          "cannot load mount point infos: %s (%d).",
-			          ent->mnt_fsname,
+			tinit_err("cannot load mount point infos: %s (%d).",
 			          strerror(errno),
 			          errno);
 			continue;
 		}
 
-		stroll_slist_nqueue_front(&table->points, &pt->node);
+		stroll_slist_nqueue_back(&table->points, &pt->node);
 	}
 
-	ret = 0;
+	ret = mnt_build_tree(table);
 
-end:
-	endmntent(mnt);
+free:
+	free(ln);
+close:
+	fclose(file);
 
 	if (ret)
 		mnt_release_points(table);
@@ -635,75 +1069,299 @@ mnt_close_table(struct mnt_table * table)
 	mnt_release_points(table);
 }
 
+static void
+mnt_sync_point(const struct mnt_point * point)
+{
+	int fd;
+
+	fd = open(point->dir,
+	          O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0)
+		return;
+
+	if (syncfs(fd))
+		tinit_warn("'%s': cannot sync filesystem: %s (%d).",
+		           point->dir,
+		           strerror(errno),
+		           errno);
+
+	close(fd);
+}
+
+/*
+ * Make a busy mount point read-only, starting with the whole superblock then
+ * falling back to this mount point only.
+ */
+static int
+mnt_protect_point(const struct mnt_point * point)
+{
+	int err;
+
+	err = mnt_remount(point->dir, MS_RDONLY, NULL);
+	if (!err) {
+		tinit_warn("'%s': remounted read-only.", point->dir);
+		return 0;
+	}
+
+#if defined(MOUNT_ATTR_RDONLY)
+	{
+		struct mount_attr attr = { .attr_set = MOUNT_ATTR_RDONLY };
+
+		if (!mount_setattr(AT_FDCWD,
+		                   point->dir,
+		                   AT_SYMLINK_NOFOLLOW,
+		                   &attr,
+		                   sizeof(attr))) {
+			/* Superblock still writable: detach from namespace. */
+			umount2(point->dir, MNT_DETACH | UMOUNT_NOFOLLOW);
+			tinit_warn("'%s': made read-only and detached.",
+			           point->dir);
+			return 0;
+		}
+	}
+#endif /* defined(MOUNT_ATTR_RDONLY) */
+
+	tinit_err("'%s': cannot remount read-only: %s (%d).",
+	          point->dir,
+	          strerror(-err),
+	          -err);
+
+	return err;
+}
+
+static int
+mnt_umount_point(struct mnt_table *       table,
+                 const struct mnt_point * point,
+                 int                      flags,
+                 bool                     last)
+{
+	assert(table);
+	assert(point);
+
+	const struct mnt_fstype * type;
+	int                       err;
+
+	type = mnt_find_fstype(table, point->type);
+	if (type && type->skip) {
+		tinit_debug("'%s': skipping '%s' filesystem...",
+		            point->dir,
+		            type->name);
+		return 0;
+	}
+
+	tinit_debug("'%s': unmounting '%s' filesystem...",
+	            point->dir,
+	            point->type);
+
+	/* Flush this filesystem only, concurrently with other workers. */
+	mnt_sync_point(point);
+
+	if (type)
+		flags &= type->mask;
+
+	if (!umount2(point->dir, flags | UMOUNT_NOFOLLOW))
+		return 0;
+
+	err = -errno;
+	assert(err != -EAGAIN);
+	assert(err != -EFAULT);
+	assert(err != -ENAMETOOLONG);
+	assert(err != -EPERM);
+
+	switch (err) {
+	case -EINVAL:
+	case -ENOENT:
+		/* Already unmounted, i.e. at retry time. */
+		return 0;
+
+	case -EBUSY:
+		/*
+		 * May be held by a mount point from another subtree (overlay
+		 * lower directories for example): let caller retry once all
+		 * workers are done.
+		 */
+		if (!last)
+			return err;
+
+		return mnt_protect_point(point);
+
+	default:
+		tinit_err("'%s': cannot unmount: %s (%d).",
+		          point->dir,
+		          strerror(-err),
+		          -err);
+		return err;
+	}
+}
+
+/* Unmount a mount point subtree, children first. */
+static int
+mnt_umount_tree(struct mnt_table *       table,
+                const struct mnt_point * point,
+                int                      flags,
+                bool                     last)
+{
+	assert(table);
+	assert(point);
+
+	const struct mnt_point * child;
+	int                      ret = 0;
+	int                      err;
+
+	stroll_slist_foreach_entry(&point->children, child, sibling) {
+		err = mnt_umount_tree(table, child, flags, last);
+		if (err && !ret)
+			ret = err;
+	}
+
+	err = mnt_umount_point(table, point, flags, last);
+
+	return ret ? ret : err;
+}
+
+struct mnt_job {
+	const struct mnt_point * point;
+	pid_t                    pid;
+	bool                     failed;
+};
+
+static pid_t
+mnt_spawn_job(struct mnt_table * table, struct mnt_job * job, int flags)
+{
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0) {
+		int err = -errno;
+
+		/* Cannot fork: run it from current process. */
+		job->failed = !!mnt_umount_tree(table,
+		                                job->point,
+		                                flags,
+		                                false);
+
+		return err;
+	}
+	else if (pid > 0) {
+		job->pid = pid;
+
+		return pid;
+	}
+
+	/* Child. */
+	_exit(mnt_umount_tree(table, job->point, flags, false) ?
+	      EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+static void
+mnt_wait_job(struct mnt_job * jobs, unsigned int nr)
+{
+	int          status;
+	pid_t        pid;
+	unsigned int j;
+
+	do {
+		pid = waitpid(-1, &status, 0);
+	} while ((pid < 0) && (errno == EINTR));
+
+	if (pid < 0)
+		return;
+
+	for (j = 0; j < nr; j++) {
+		if (jobs[j].pid == pid) {
+			jobs[j].failed = !WIFEXITED(status) ||
+			                 WEXITSTATUS(status);
+			jobs[j].pid = -1;
+			return;
+		}
+	}
+}
+
+/*
+ * Build the list of independent subtrees, i.e. children of the root mount
+ * point plus mount points which parent lies outside of our namespace.
+ */
+static unsigned int
+mnt_build_jobs(const struct mnt_table * table, struct mnt_job * jobs)
+{
+	const struct mnt_point * pt;
+	unsigned int             nr = 0;
+
+	stroll_slist_foreach_entry(&table->points, pt, node) {
+		const struct mnt_point * child;
+
+		if (pt->parent)
+			continue;
+
+		if (strcmp(pt->dir, "/")) {
+			jobs[nr++] = (struct mnt_job){ pt, -1, false };
+			continue;
+		}
+
+		stroll_slist_foreach_entry(&pt->children, child, sibling)
+			jobs[nr++] = (struct mnt_job){ child, -1, false };
+	}
+
+	return nr;
+}
+
 void
 mnt_umount_all(int flags)
 {
 	assert(!(flags & ~(MNT_FORCE | MNT_DETACH)));
 
 	struct mnt_table   tab;
+	struct mnt_job *   jobs;
+	unsigned int       nr = 0;
+	unsigned int       running = 0;
+	unsigned int       j;
 	struct mnt_point * pt;
 	int                ret = 0;
 
 	if (mnt_open_table(&tab))
 	    goto err;
 
-	stroll_slist_foreach_entry(&tab.points, pt, node) {
-		const struct mnt_fstype * type;
+	stroll_slist_foreach_entry(&tab.points, pt, node)
+		nr++;
 
-		if (!strcmp(pt->dir, "/"))
-			/*
-			 * Skip root FS since required to be remounted
-			 * read-only.
-			 */
-			continue;
+	jobs = malloc(nr * sizeof(jobs[0]));
+	if (!jobs) {
+		mnt_close_table(&tab);
+		goto err;
+	}
 
-		type = mnt_find_fstype(&tab, pt->type);
-		assert(type);
-		if (type->skip) {
-			tinit_debug("'%s': skipping '%s' filesystem...",
-			            pt->dir,
-			            type->name);
-			continue;
-		}
+	nr = mnt_build_jobs(&tab, jobs);
 
-		tinit_debug("'%s': unmounting '%s' filesystem...",
-		            pt->dir,
-		            pt->type);
-
-		if (umount2(pt->dir, (flags & type->mask) | UMOUNT_NOFOLLOW)) {
-			int err = -errno;
-
-			assert(err != -EAGAIN);
-			assert(err != -EFAULT);
-			assert(err != -EINVAL);
-			assert(err != -ENAMETOOLONG);
-			assert(err != -ENOENT);
-			assert(err != -EPERM);
-
-			if (err == -EBUSY) {
-				err = mnt_remount(pt->dir, MS_RDONLY, NULL);
-				if (err)
-					tinit_err("'%s': "
-					          "cannot remount read-only: "
-					          "%s (%d).",
-					          pt->dir,
-					          strerror(-err),
-					          -err);
-				else
-					tinit_warn("'%s': remounted read-only.",
-					           pt->dir);
-			}
-			else
-				tinit_err("'%s': cannot unmount: %s (%d).",
-				          pt->dir,
-				          strerror(-err),
-				          -err);
-
-			if (err && !ret)
-				ret = err;
+	/* Unmount independent subtrees concurrently. */
+	for (j = 0; j < nr; j++) {
+		if (running >= MNT_WORKER_MAX) {
+			mnt_wait_job(jobs, nr);
+			running--;
 		}
+
+		if (mnt_spawn_job(&tab, &jobs[j], flags) > 0)
+			running++;
+	}
+
+	while (running--)
+		mnt_wait_job(jobs, nr);
+
+	/*
+	 * Retry failed subtrees serially, most recent first, since these may
+	 * have been held by mount points from other subtrees.
+	 */
+	for (j = nr; j > 0; j--) {
+		int err;
+
+		if (!jobs[j - 1].failed)
+			continue;
+
+		err = mnt_umount_tree(&tab, jobs[j - 1].point, flags, true);
+		if (err && !ret)
+			ret = err;
 	}
 
+	free(jobs);
 	mnt_close_table(&tab);
 
 	remount_root();
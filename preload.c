@@ -0,0 +1,290 @@
+#include "preload.h"
+#include "conf.h"
+#include "log.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+#include <errno.h>
+#include <assert.h>
+#include <pthread.h>
+
+/*
+ * Boot target services configuration preloading.
+ *
+ * The loader thread only parses configuration files and never touches the
+ * service repository. Results are handed over to the main thread once joined,
+ * hence no locking is required. The loader thread never logs since loggers are
+ * not thread safe: parsing errors are reported once files are loaded again by
+ * the main thread and other errors are recorded for the main thread to report
+ * them once joined.
+ */
+
+struct tinit_preload_entry {
+	char              base[NAME_MAX + 1];
+	struct conf_svc * conf;
+};
+
+struct tinit_preload {
+	pthread_t                    thread;
+	bool                         running;
+	int                          err;
+	char *                       target;
+	unsigned int                 nr;
+	unsigned int                 cnt;
+	struct tinit_preload_entry * ents;
+};
+
+static struct tinit_preload tinit_preload_inst;
+
+static int
+tinit_preload_add(struct tinit_preload * pre, const char * base)
+{
+	assert(pre);
+	assert(base);
+
+	unsigned int e;
+
+	if (strlen(base) >= sizeof(pre->ents[0].base))
+		return 0;
+
+	for (e = 0; e < pre->cnt; e++)
+		if (!strcmp(pre->ents[e].base, base))
+			return 0;
+
+	if (pre->cnt == pre->nr) {
+		unsigned int                 nr = pre->nr ? (2 * pre->nr) : 16;
+		struct tinit_preload_entry * ents;
+
+		ents = reallocarray(pre->ents, nr, sizeof(ents[0]));
+		if (!ents)
+			return -errno;
+
+		pre->ents = ents;
+		pre->nr = nr;
+	}
+
+	strcpy(pre->ents[pre->cnt].base, base);
+	pre->ents[pre->cnt].conf = NULL;
+	pre->cnt++;
+
+	return 0;
+}
+
+/* Queue notifying services, assuming they are defined into "<name>.conf". */
+static int
+tinit_preload_add_deps(struct tinit_preload * pre, const struct strarr * deps)
+{
+	assert(pre);
+
+	unsigned int nr;
+	unsigned int d;
+
+	if (!deps)
+		return 0;
+
+	nr = strarr_nr(deps);
+	for (d = 0; d < nr; d++) {
+		char base[NAME_MAX + 1];
+		int  err;
+
+		if ((size_t)snprintf(base,
+		                     sizeof(base),
+		                     "%s.conf",
+		                     strarr_get(deps, d)) >= sizeof(base))
+			continue;
+
+		err = tinit_preload_add(pre, base);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+/* Queue services linked from target directory. */
+static int
+tinit_preload_walk_target(struct tinit_preload * pre)
+{
+	assert(pre);
+
+	DIR *                 dir;
+	const struct dirent * ent;
+	char                  path[PATH_MAX];
+	char                  real[PATH_MAX];
+	const size_t          len = sizeof(CONFIG_TINIT_INCLUDE_DIR);
+	int                   err = 0;
+
+	dir = opendir(pre->target);
+	if (!dir)
+		return -errno;
+
+	while ((ent = readdir(dir))) {
+		if (ent->d_type != DT_LNK)
+			continue;
+
+		if (snprintf(path,
+		             sizeof(path),
+		             "%s/%s",
+		             pre->target,
+		             ent->d_name) >= (int)sizeof(path))
+			continue;
+
+		if (!realpath(path, real) ||
+		    strncmp(real, CONFIG_TINIT_INCLUDE_DIR "/", len))
+			/* Will be reported by target walk. */
+			continue;
+
+		err = tinit_preload_add(pre, &real[len]);
+		if (err)
+			break;
+	}
+
+	closedir(dir);
+
+	return err;
+}
+
+static void *
+tinit_preload_run(void * arg)
+{
+	struct tinit_preload * pre = arg;
+	char                   path[PATH_MAX];
+	unsigned int           e;
+	int                    err;
+
+	pre->err = tinit_preload_walk_target(pre);
+	if (pre->err)
+		return NULL;
+
+	/* Entries are appended while iterating to load dependencies. */
+	for (e = 0; e < pre->cnt; e++) {
+		struct conf_svc * conf;
+
+		if ((size_t)snprintf(path,
+		                     sizeof(path),
+		                     CONFIG_TINIT_INCLUDE_DIR "/%s",
+		                     pre->ents[e].base) >= sizeof(path))
+			continue;
+
+		if (access(path, F_OK))
+			continue;
+
+		conf = conf_probe_file(path);
+		if (!conf)
+			/* Reported once loaded again by main thread. */
+			continue;
+
+		pre->ents[e].conf = conf;
+
+		err = tinit_preload_add_deps(pre, conf_get_starton(conf));
+		if (!err)
+			err = tinit_preload_add_deps(pre,
+			                             conf_get_stopon(conf));
+		if (err) {
+			pre->err = err;
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+static void
+tinit_preload_join(struct tinit_preload * pre)
+{
+	assert(pre);
+
+	if (!pre->running)
+		return;
+
+	pthread_join(pre->thread, NULL);
+	pre->running = false;
+
+	/* Services not preloaded are parsed on demand by main thread. */
+	if (pre->err)
+		tinit_warn("cannot preload '%s' configuration: %s (%d).",
+		           pre->target,
+		           strerror(-pre->err),
+		           -pre->err);
+
+	free(pre->target);
+	pre->target = NULL;
+}
+
+int
+tinit_preload_start(const char * dir_path, const char * target)
+{
+	assert(dir_path);
+	assert(target);
+
+	struct tinit_preload * pre = &tinit_preload_inst;
+	int                    err;
+
+	assert(!pre->running);
+
+	if (asprintf(&pre->target, "%s/%s", dir_path, target) < 0)
+		return -ENOMEM;
+
+	err = pthread_create(&pre->thread, NULL, tinit_preload_run, pre);
+	if (err) {
+		tinit_warn("cannot start configuration loader: %s (%d).",
+		           strerror(err),
+		           err);
+		free(pre->target);
+		pre->target = NULL;
+		return -err;
+	}
+
+	pre->running = true;
+
+	return 0;
+}
+
+void
+tinit_preload_wait(void)
+{
+	tinit_preload_join(&tinit_preload_inst);
+}
+
+struct conf_svc *
+tinit_preload_take(const char * base)
+{
+	assert(base);
+
+	struct tinit_preload * pre = &tinit_preload_inst;
+	unsigned int           e;
+
+	tinit_preload_join(pre);
+
+	for (e = 0; e < pre->cnt; e++) {
+		struct conf_svc * conf = pre->ents[e].conf;
+
+		if (conf && !strcmp(pre->ents[e].base, base)) {
+			pre->ents[e].conf = NULL;
+			return conf;
+		}
+	}
+
+	return NULL;
+}
+
+void
+tinit_preload_finish(void)
+{
+	struct tinit_preload * pre = &tinit_preload_inst;
+	unsigned int           e;
+
+	tinit_preload_join(pre);
+
+	for (e = 0; e < pre->cnt; e++)
+		if (pre->ents[e].conf)
+			conf_destroy(pre->ents[e].conf);
+
+	free(pre->ents);
+	pre->ents = NULL;
+	pre->nr = 0;
+	pre->cnt = 0;
+}
@@ -0,0 +1,57 @@
+#ifndef _TINIT_PRELOAD_H
+#define _TINIT_PRELOAD_H
+
+#include "common.h"
+
+struct conf_svc;
+
+/*
+ * tinit_preload_start() - Start parsing boot target services configuration
+ *                         in the background.
+ *
+ * @dir_path: path to targets top-level directory
+ * @target:   name of boot target
+ *
+ * Configuration files of services linked from @target, as well as the ones of
+ * their starton / stopon notifying services, are parsed by a dedicated thread
+ * so that parsing overlaps with early boot filesystems and logs setup.
+ * Must be called once signals are blocked so that the loader thread does not
+ * get any of them.
+ * The loader thread never logs: errors are reported by the main thread once
+ * the loader thread is joined.
+ *
+ * Return: 0 if successful, a negative errno-like value otherwise.
+ */
+extern int
+tinit_preload_start(const char * dir_path, const char * target);
+
+/*
+ * tinit_preload_wait() - Wait for background configuration parsing to
+ *                        complete.
+ */
+extern void
+tinit_preload_wait(void);
+
+/*
+ * tinit_preload_take() - Retrieve a configuration parsed in the background.
+ *
+ * @base: name of file found into CONFIG_TINIT_INCLUDE_DIR
+ *
+ * Waits for the loader thread to complete on first call.
+ * Ownership of the returned configuration is transferred to the caller.
+ *
+ * Return: configuration if found, NULL otherwise.
+ */
+extern struct conf_svc *
+tinit_preload_take(const char * base);
+
+/*
+ * tinit_preload_finish() - Release configurations not taken.
+ *
+ * Waits for the loader thread to complete if still running. Must be called
+ * before spawning any service process.
+ */
+extern void
+tinit_preload_finish(void);
+
+#endif /* _TINIT_PRELOAD_H */
@@ -10,6 +10,11 @@ enum tinit_msg_type {
 	TINIT_RESTART_MSG_TYPE,
 	TINIT_RELOAD_MSG_TYPE,
 	TINIT_SWITCH_MSG_TYPE,
+	TINIT_RELOAD_REPO_MSG_TYPE,
+	TINIT_LOGS_MSG_TYPE,
+	TINIT_EVENTS_MSG_TYPE,
+	TINIT_WAIT_MSG_TYPE,
+	TINIT_XSTATUS_MSG_TYPE,
 	TINIT_MSG_TYPE_NR
 };
 
@@ -19,21 +24,85 @@ struct tinit_request_msg {
 	char     pattern[0];
 };
 
+/*
+ * Wait request: reply is sent back once named service has reached @state or
+ * @tmout milliseconds have elapsed.
+ */
+struct tinit_wait_msg {
+	uint16_t seq;
+	uint16_t type;
+	uint16_t state;
+	uint16_t pad;
+	uint32_t tmout;
+	char     name[0];
+};
+
+/*
+ * Status request: records of services matching @pattern are replied starting
+ * from the @start th service of the repository search, as given by the @next
+ * field of the previous reply page.
+ */
+struct tinit_status_msg {
+	uint16_t seq;
+	uint16_t type;
+	uint16_t start;
+	uint16_t flags;
+	char     pattern[0];
+};
+
+/* Extended status records carry service description. */
+#define TINIT_STATUS_DESC_FLAG (1U << 0)
+
 struct tinit_reply_head {
 	uint16_t seq;
 	uint16_t type;
 	uint16_t ret;
 };
 
+/*
+ * Status reply: @next is the start of next reply page, 0 when all records have
+ * been replied.
+ */
 struct tinit_status_reply {
-	struct tinit_reply_head  head;
-	struct tinit_status_data statuses[0];
+	struct tinit_reply_head head;
+	uint16_t                next;
+	char                    data[0];
+};
+
+struct tinit_logs_reply {
+	struct tinit_reply_head head;
+	char                    data[0];
+};
+
+struct tinit_events_reply {
+	struct tinit_reply_head head;
+	struct tinit_event      events[0];
 };
 
+/* Status records alignment within status replies. */
+#define TINIT_STATUS_ALIGN     (sizeof(uint64_t))
+
+/* Maximum length of service description carried by extended status replies. */
+#define TINIT_STATUS_DESC_MAX  (128U)
+
 #define TINIT_SVC_PATTERN_MAX  (256U)
 #define TINIT_REQUEST_SIZE_MAX \
-	(sizeof(struct tinit_request_msg) + TINIT_SVC_PATTERN_MAX)
+	(sizeof(struct tinit_wait_msg) + TINIT_SVC_PATTERN_MAX)
 #define TINIT_MSG_SIZE_MAX     (4096U)
 #define TINIT_SOCK_PATH        CONFIG_TINIT_RUNSTATEDIR "/tinit.sock"
 
+enum tinit_fdstore_op {
+	TINIT_FDSTORE_PUSH_OP = 0,
+	TINIT_FDSTORE_FLUSH_OP,
+	TINIT_FDSTORE_OP_NR
+};
+
+struct tinit_fdstore_msg {
+	uint16_t op;
+};
+
+#define TINIT_FDSTORE_PATH     CONFIG_TINIT_RUNSTATEDIR "/tinit-fds.sock"
+
+#define TINIT_METRICS_PATH     CONFIG_TINIT_RUNSTATEDIR "/tinit-metrics.sock"
+
 #endif /* _TINIT_PROTO_H */
@@ -0,0 +1,390 @@
+#include "reexec.h"
+#include "repo.h"
+#include "target.h"
+#include "sigchan.h"
+#include "svc.h"
+#include "conf.h"
+#include "log.h"
+#include "capture.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <assert.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#define TINIT_REEXEC_MAGIC   (0x74696e69U)
+#define TINIT_REEXEC_VERSION (4U)
+
+/*
+ * Saved state layout: a header followed by svc_nr service records, each one
+ * immediately followed by the snap.grp_nr PIDs of its start command group.
+ * TINIT_REEXEC_VERSION MUST be bumped whenever layout changes. Header magic,
+ * version, svc_nr and sig_fd fields MUST never move however so that an init
+ * binary may adopt the signal channel of any other one.
+ */
+struct tinit_reexec_head {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t svc_nr;
+	int32_t  sig_fd;
+	char     target[TINIT_SVC_NAME_MAX];
+};
+
+struct tinit_reexec_svc {
+	char            name[TINIT_SVC_NAME_MAX];
+	struct svc_snap snap;
+};
+
+static int
+tinit_reexec_write(int fd, const void * data, size_t size)
+{
+	assert(fd >= 0);
+	assert(data);
+	assert(size);
+
+	do {
+		ssize_t ret;
+
+		ret = write(fd, data, size);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+
+		data = (const char *)data + ret;
+		size -= (size_t)ret;
+	} while (size);
+
+	return 0;
+}
+
+static int
+tinit_reexec_read(int fd, void * data, size_t size)
+{
+	assert(fd >= 0);
+	assert(data);
+	assert(size);
+
+	do {
+		ssize_t ret;
+
+		ret = read(fd, data, size);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		else if (!ret)
+			return -ENODATA;
+
+		data = (char *)data + ret;
+		size -= (size_t)ret;
+	} while (size);
+
+	return 0;
+}
+
+static int
+tinit_reexec_save(int fd, const struct tinit_sigchan * chan)
+{
+	assert(fd >= 0);
+	assert(chan);
+
+	const struct tinit_repo * repo = tinit_repo_get();
+	struct tinit_reexec_head  head = {
+		.magic   = TINIT_REEXEC_MAGIC,
+		.version = TINIT_REEXEC_VERSION,
+		.svc_nr  = 0,
+		.sig_fd  = chan->fd
+	};
+	const char *              target;
+	const struct svc *        svc;
+	int                       err;
+
+	target = tinit_target_current();
+	if (target)
+		strncpy(head.target, target, sizeof(head.target) - 1);
+
+	tinit_repo_foreach(repo, svc)
+		head.svc_nr++;
+
+	err = tinit_reexec_write(fd, &head, sizeof(head));
+	if (err)
+		return err;
+
+	tinit_repo_foreach(repo, svc) {
+		struct tinit_reexec_svc rec = { 0, };
+		const pid_t *           pids;
+
+		strncpy(rec.name,
+		        conf_get_name(svc->conf),
+		        sizeof(rec.name) - 1);
+		pids = svc_save(svc, &rec.snap);
+
+		err = tinit_reexec_write(fd, &rec, sizeof(rec));
+		if (err)
+			return err;
+
+		if (rec.snap.grp_nr) {
+			err = tinit_reexec_write(fd,
+			                         pids,
+			                         rec.snap.grp_nr *
+			                         sizeof(pids[0]));
+			if (err)
+				return err;
+		}
+	}
+
+	if (lseek(fd, 0, SEEK_SET))
+		return -errno;
+
+	return 0;
+}
+
+static void
+tinit_reexec_rollback(const struct tinit_sigchan * chan)
+{
+	const struct tinit_repo * repo = tinit_repo_get();
+	const struct svc *        svc;
+
+	/* Prevent from leaking descriptors to services. */
+	fcntl(chan->fd, F_SETFD, FD_CLOEXEC);
+
+	tinit_repo_foreach(repo, svc) {
+		unsigned int f;
+
+		for (f = 0; f < svc->fd_nr; f++)
+			fcntl(svc->fds[f], F_SETFD, FD_CLOEXEC);
+
+		if (svc->capture) {
+			fcntl(svc->capture->fds[0], F_SETFD, FD_CLOEXEC);
+			fcntl(svc->capture->fds[1], F_SETFD, FD_CLOEXEC);
+		}
+	}
+}
+
+int
+tinit_reexec(const struct tinit_sigchan * chan,
+             const struct upoll *         poller,
+             int                          argc,
+             char * const                 argv[])
+{
+	assert(chan);
+	assert(poller);
+	assert(argc > 0);
+	assert(argv);
+
+	int           fd;
+	const char ** args;
+	char          arg[sizeof(TINIT_REEXEC_KWORD "=") + 10];
+	int           a;
+	int           nr = 0;
+	int           err;
+
+	args = malloc((size_t)(argc + 2) * sizeof(args[0]));
+	if (!args) {
+		err = -errno;
+		goto err;
+	}
+
+	/* No MFD_CLOEXEC: re-executed init inherits it. */
+	fd = memfd_create("tinit-state", 0);
+	if (fd < 0) {
+		err = -errno;
+		goto free;
+	}
+
+	err = tinit_reexec_save(fd, chan);
+	if (err)
+		goto close;
+
+	/* Give original arguments but the one from a previous re-execution. */
+	for (a = 0; a < argc; a++) {
+		if (!strncmp(argv[a],
+		             TINIT_REEXEC_KWORD "=",
+		             sizeof(TINIT_REEXEC_KWORD "=") - 1))
+			continue;
+		args[nr++] = argv[a];
+	}
+	sprintf(arg, TINIT_REEXEC_KWORD "=%d", fd);
+	args[nr++] = arg;
+	args[nr] = NULL;
+
+	if (fcntl(chan->fd, F_SETFD, 0)) {
+		err = -errno;
+		goto rollback;
+	}
+
+	tinit_notice("re-executing...");
+	tinit_unwatch_logs(poller);
+	tinit_reexec_logs();
+
+	execve(TINIT_REEXEC_PATH, (char * const *)args, environ);
+	/* Still there: bring loggers back. */
+	err = -errno;
+	tinit_resume_logs(poller);
+
+rollback:
+	tinit_reexec_rollback(chan);
+close:
+	close(fd);
+free:
+	free(args);
+err:
+	tinit_err("cannot re-execute: %s (%d).", strerror(-err), -err);
+
+	return err;
+}
+
+/*
+ * Release descriptors inherited from a service record which could not be
+ * restored so that they do not leak into processes spawned later on.
+ */
+static void
+tinit_reexec_drop_snap(const struct svc_snap * snap)
+{
+	assert(snap);
+
+	unsigned int nr = stroll_min(snap->fd_nr, TINIT_STORE_FD_MAX);
+	unsigned int f;
+
+	for (f = 0; f < nr; f++)
+		if (snap->fds[f] >= 0)
+			close(snap->fds[f]);
+
+	for (f = 0; f < stroll_array_nr(snap->capture); f++)
+		if (snap->capture[f] >= 0)
+			close(snap->capture[f]);
+}
+
+static void
+tinit_reexec_restore_svc(const struct tinit_repo *       repo,
+                         const struct tinit_reexec_svc * rec,
+                         const pid_t *                   pids)
+{
+	struct svc * svc;
+	int          err;
+
+	svc = tinit_repo_search_byname(repo, rec->name);
+	if (!svc) {
+		tinit_warn("%s: service not found: "
+		           "cannot restore state.",
+		           rec->name);
+		tinit_reexec_drop_snap(&rec->snap);
+		return;
+	}
+
+	err = svc_restore(svc, &rec->snap, pids);
+	if (err) {
+		tinit_warn("%s: cannot restore state: %s (%d).",
+		           rec->name,
+		           strerror(-err),
+		           -err);
+		tinit_reexec_drop_snap(&rec->snap);
+	}
+}
+
+int
+tinit_reexec_restore(int                    fd,
+                     struct tinit_sigchan * chan,
+                     const struct upoll *   poller)
+{
+	assert(fd >= 0);
+	assert(chan);
+	assert(poller);
+
+	const struct tinit_repo * repo = tinit_repo_get();
+	struct tinit_reexec_head  head;
+	unsigned int              s;
+	int                       err;
+
+	err = tinit_reexec_read(fd, &head, sizeof(head));
+	if (err)
+		goto close;
+
+	if ((head.magic != TINIT_REEXEC_MAGIC) || (head.sig_fd < 0)) {
+		err = -EPROTO;
+		goto close;
+	}
+
+	err = tinit_sigchan_adopt(chan, head.sig_fd);
+	if (err) {
+		close(head.sig_fd);
+		goto close;
+	}
+
+	if (head.version != TINIT_REEXEC_VERSION) {
+		/*
+		 * Saved by an init binary with a different layout: services
+		 * cannot be restored and descriptors saved along with them
+		 * cannot be located. Let the caller start services from
+		 * scratch with the adopted signal channel: processes left over
+		 * are reaped as unknown ones.
+		 */
+		tinit_warn("unsupported saved state version %hu: "
+		           "services left unmanaged.",
+		           head.version);
+		close(fd);
+
+		return -EPROTONOSUPPORT;
+	}
+
+	for (s = 0; s < head.svc_nr; s++) {
+		struct tinit_reexec_svc rec;
+		pid_t *                 pids = NULL;
+
+		err = tinit_reexec_read(fd, &rec, sizeof(rec));
+		if (err)
+			goto sigs;
+
+		if (rec.snap.grp_nr) {
+			size_t sz = rec.snap.grp_nr * sizeof(pids[0]);
+
+			pids = malloc(sz);
+			if (!pids) {
+				err = -errno;
+				goto sigs;
+			}
+
+			err = tinit_reexec_read(fd, pids, sz);
+			if (err) {
+				free(pids);
+				goto sigs;
+			}
+		}
+
+		rec.name[sizeof(rec.name) - 1] = '\0';
+		if (rec.name[0])
+			tinit_reexec_restore_svc(repo, &rec, pids);
+		else
+			tinit_reexec_drop_snap(&rec.snap);
+
+		free(pids);
+	}
+
+	head.target[sizeof(head.target) - 1] = '\0';
+
+	err = tinit_sigchan_start(chan, poller);
+	if (err)
+		goto sigs;
+
+	if (head.target[0])
+		tinit_target_resume(head.target);
+
+	close(fd);
+
+	tinit_notice("re-executed.");
+
+	return 0;
+
+sigs:
+	tinit_sigchan_close(chan);
+close:
+	close(fd);
+
+	tinit_err("cannot restore state: %s (%d).", strerror(-err), -err);
+
+	return err;
+}
@@ -0,0 +1,59 @@
+#ifndef _TINIT_REEXEC_H
+#define _TINIT_REEXEC_H
+
+#include "common.h"
+
+struct tinit_sigchan;
+struct upoll;
+
+/*
+ * Path to init binary to re-execute, i.e. the one installed by upgrades since
+ * /proc/self/exe still refers to the running one.
+ */
+#define TINIT_REEXEC_PATH "/sbin/init"
+
+/*
+ * Kernel command line keyword used to hand saved state file descriptor over
+ * to the re-executed init.
+ */
+#define TINIT_REEXEC_KWORD "reexec"
+
+/*
+ * tinit_reexec() - Re-execute init while keeping services running.
+ *
+ * @chan:   signal channel to hand over
+ * @poller: poller loggers are registered to
+ * @argc:   number of command line arguments given to current init
+ * @argv:   command line arguments given to current init
+ *
+ * Save runtime state of all services into a memory file then execve() the
+ * init binary found at TINIT_REEXEC_PATH. Loggers torn down before execve()
+ * are restored upon failure.
+ *
+ * Return: a negative errno-like value since it returns only upon failure.
+ */
+extern int
+tinit_reexec(const struct tinit_sigchan * chan,
+             const struct upoll *         poller,
+             int                          argc,
+             char * const                 argv[]);
+
+/*
+ * tinit_reexec_restore() - Restore runtime state saved by tinit_reexec().
+ *
+ * @fd:     file descriptor to memory file holding saved state
+ * @chan:   signal channel to setup from the inherited signalfd
+ * @poller: poller to register signal channel to
+ *
+ * State saved with an unsupported layout version is discarded: the signal
+ * channel is adopted, though not started, and -EPROTONOSUPPORT is returned so
+ * that the caller may start services from scratch.
+ *
+ * Return: 0 if successful, a negative errno-like value otherwise.
+ */
+extern int
+tinit_reexec_restore(int                    fd,
+                     struct tinit_sigchan * chan,
+                     const struct upoll *   poller);
+
+#endif /* _TINIT_REEXEC_H */
@@ -3,11 +3,17 @@
 #include "svc.h"
 #include "conf.h"
 #include "notif.h"
+#include "preload.h"
 #include <assert.h>
 #include <string.h>
+#include <stdio.h>
 #include <dirent.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 #define TINIT_INCLUDE_DIR_LEN \
 	(sizeof(CONFIG_TINIT_INCLUDE_DIR) - 1)
@@ -19,9 +25,138 @@
 	          _err)
 
 struct tinit_repo tinit_repo_inst = {
-	.list = STROLL_DLIST_INIT(tinit_repo_inst.list)
+	.list     = STROLL_DLIST_INIT(tinit_repo_inst.list),
+	.index    = NULL,
+	.nr       = 0,
+	.stale    = true,
+	.complete = false
 };
 
+/*
+ * Background loading of services not reachable from boot target. Services are
+ * loaded by slices so that the main loop is not held for too long.
+ */
+static struct utimer tinit_repo_timer;
+static unsigned int  tinit_repo_defer_cnt;
+static DIR *         tinit_repo_slice_dir;
+static char *        tinit_repo_slice_path;
+
+#define TINIT_REPO_DEFER_TMOUT (1U)
+
+/* Maximum number of boot settling polls before loading anyway. */
+#define TINIT_REPO_DEFER_MAX   (60U)
+
+/* Number of services loaded per slice. */
+#define TINIT_REPO_SLICE_NR    (8U)
+
+/* Delay between slices (milliseconds). */
+#define TINIT_REPO_SLICE_TMOUT (10U)
+
+static int
+tinit_repo_cmp_svc(const void * first, const void * second)
+{
+	const struct svc * fst = *(const struct svc * const *)first;
+	const struct svc * snd = *(const struct svc * const *)second;
+
+	return strcmp(conf_get_name(fst->conf), conf_get_name(snd->conf));
+}
+
+static int
+tinit_repo_build_index(struct tinit_repo * repo)
+{
+	assert(repo);
+	assert(repo->stale);
+
+	struct svc *  svc;
+	unsigned int  nr = 0;
+	struct svc ** index;
+
+	tinit_repo_foreach(repo, svc)
+		nr++;
+
+	if (nr > repo->nr) {
+		index = realloc(repo->index, nr * sizeof(index[0]));
+		if (!index)
+			return -errno;
+
+		repo->index = index;
+	}
+
+	nr = 0;
+	tinit_repo_foreach(repo, svc)
+		repo->index[nr++] = svc;
+
+	qsort(repo->index, nr, sizeof(repo->index[0]), tinit_repo_cmp_svc);
+
+	repo->nr = nr;
+	repo->stale = false;
+
+	return 0;
+}
+
+/*
+ * Return index of first entry which name compares greater than (@strict) or
+ * greater than or equal to (!@strict) the given prefix.
+ */
+static unsigned int
+tinit_repo_bound_prefix(const struct tinit_repo * repo,
+                        const char *              prefix,
+                        size_t                    len,
+                        bool                      strict)
+{
+	unsigned int lo = 0;
+	unsigned int hi = repo->nr;
+
+	while (lo < hi) {
+		unsigned int mid = lo + ((hi - lo) / 2);
+		int          cmp;
+
+		cmp = strncmp(conf_get_name(repo->index[mid]->conf),
+		              prefix,
+		              len);
+		if ((cmp < 0) || (strict && !cmp))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+int
+tinit_repo_search_prefix(struct tinit_repo *   repo,
+                         const char *          prefix,
+                         size_t                len,
+                         struct svc * const ** svcs)
+{
+	assert(repo);
+	assert(prefix || !len);
+	assert(svcs);
+
+	unsigned int first;
+	unsigned int last;
+
+	if (repo->stale) {
+		int err;
+
+		err = tinit_repo_build_index(repo);
+		if (err)
+			return err;
+	}
+
+	if (!len) {
+		*svcs = repo->index;
+		return (int)repo->nr;
+	}
+
+	first = tinit_repo_bound_prefix(repo, prefix, len, false);
+	last = tinit_repo_bound_prefix(repo, prefix, len, true);
+
+	*svcs = &repo->index[first];
+
+	return (int)(last - first);
+}
+
 struct svc *
 tinit_repo_search_byname(
 	const struct tinit_repo * repo,
@@ -35,6 +170,10 @@ tinit_repo_search_byname(
 	const struct svc * svc;
 
 	tinit_repo_foreach(repo, svc) {
+		/* Services which configuration file was removed are hidden. */
+		if (svc->gone)
+			continue;
+
 		if (!strncmp(conf_get_name(svc->conf),
 		             name,
 		             TINIT_SVC_NAME_MAX))
@@ -56,6 +195,9 @@ tinit_repo_search_bypath(const struct tinit_repo * repo,
 	const struct svc * svc;
 
 	tinit_repo_foreach(repo, svc) {
+		if (svc->gone)
+			continue;
+
 		if (!strncmp(conf_get_path(svc->conf), path, NAME_MAX))
 			return (struct svc *)svc;
 	}
@@ -63,23 +205,34 @@ tinit_repo_search_bypath(const struct tinit_repo * repo,
 	return NULL;
 }
 
-struct svc *
-tinit_repo_search_bypid(const struct tinit_repo * repo,
-                        pid_t                              pid)
+/* Same as tinit_repo_search_bypath() including removed services. */
+static struct svc *
+tinit_repo_lookup_bypath(const struct tinit_repo * repo, const char * path)
 {
 	assert(repo);
-	assert(pid > 0);
+	assert(path);
 
-	const struct svc * svc;
+	struct svc * svc;
 
 	tinit_repo_foreach(repo, svc) {
-		if (svc->child == pid)
-			return (struct svc *)svc;
+		if (!strncmp(conf_get_path(svc->conf), path, NAME_MAX))
+			return svc;
 	}
 
 	return NULL;
 }
 
+struct svc *
+tinit_repo_search_bypid(const struct tinit_repo * repo __unused,
+                        pid_t                     pid)
+{
+	assert(repo);
+	assert(pid > 0);
+
+	/* All services are registered: scan storage directly. */
+	return svc_search_bypid(pid);
+}
+
 #warning factorize me with tinit_repo_setup_svc_stopon()
 static void
 tinit_repo_setup_svc_starton(const struct tinit_repo * repo,
@@ -178,35 +331,656 @@ tinit_repo_read_dirent(DIR * dir, const struct dirent ** ent)
 	return -err;
 }
 
+static bool
+tinit_repo_is_conf_name(const char * name)
+{
+	const char * ext;
+
+	/* Search for a '.conf' file name extension. */
+	ext = strrchr(name, '.');
+	if (!ext || strcmp(&ext[1], "conf")) {
+		tinit_debug("'" CONFIG_TINIT_INCLUDE_DIR "/%s': "
+		            "skipping service configuration entry.",
+		            name);
+		return false;
+	}
+
+	return true;
+}
+
 static int
-tinit_repo_load_svc(struct tinit_repo *   repo,
-                    const struct dirent * ent,
-                    char                           path[PATH_MAX])
+tinit_repo_load_svc(struct tinit_repo * repo,
+                    const char *        name,
+                    char                path[PATH_MAX],
+                    struct svc **       loaded)
 {
-	const char *      ext;
+	assert(repo);
+	assert(name);
+	assert(path);
+	assert(loaded);
+
 	struct conf_svc * conf;
 	struct svc *      svc;
 
-	/* Skip non regular files. */
-	if (ent->d_type != DT_REG)
+	*loaded = NULL;
+
+	/*
+	 * Build absolute path and give it to service configuration parser
+	 * unless already parsed at boot time.
+	 */
+	strcpy(&path[TINIT_INCLUDE_DIR_LEN + 1], name);
+	conf = tinit_preload_take(name);
+	if (!conf)
+		conf = conf_create_from_file(path);
+	if (!conf)
+		/* Skip invalid configuration items. */
+		return (errno != ENOMEM) ? 0 : -ENOMEM;
+
+	/* Create a service descriptor using loaded configuration. */
+	svc = svc_create(conf);
+	if (!svc) {
+		assert(errno == ENOMEM);
+		conf_destroy(conf);
+		return -ENOMEM;
+	}
+
+	/* Register main service repository. */
+	stroll_dlist_append(&repo->list, &svc->repo);
+	tinit_repo_invalidate(repo);
+
+	*loaded = svc;
+
+	return 0;
+}
+
+static int
+tinit_repo_open_dir(DIR ** dir, char ** path)
+{
+	assert(dir);
+	assert(path);
+	assert((TINIT_INCLUDE_DIR_LEN + 1 + NAME_MAX) <= PATH_MAX);
+
+	int ret;
+
+	*dir = opendir(CONFIG_TINIT_INCLUDE_DIR);
+	if (!*dir) {
+		ret = errno;
+		assert(ret != EBADF);
+
+		tinit_repo_err(ret,
+		               "cannot open service configuration directory");
+		return -ret;
+	}
+
+	*path = malloc(PATH_MAX);
+	if (!*path) {
+		ret = -errno;
+		closedir(*dir);
+		return ret;
+	}
+
+	memcpy(*path, CONFIG_TINIT_INCLUDE_DIR, TINIT_INCLUDE_DIR_LEN);
+	(*path)[TINIT_INCLUDE_DIR_LEN] = '/';
+
+	return 0;
+}
+
+static void
+tinit_repo_close_dir(DIR * dir, char * path)
+{
+	free(path);
+	closedir(dir);
+}
+
+/*
+ * Load services found into configuration directory, @max of them at most.
+ * When @skip is true, services already loaded are left alone.
+ *
+ * Return: 0 once directory end is reached, -EAGAIN when @max services have
+ *         been loaded, another negative errno-like value otherwise.
+ */
+static int
+tinit_repo_load_dirents(struct tinit_repo * repo,
+                        DIR *               dir,
+                        char *              path,
+                        bool                skip,
+                        unsigned int        max)
+{
+	assert(repo);
+	assert(dir);
+	assert(path);
+	assert(max);
+
+	int ret;
+
+	do {
+		const struct dirent * ent;
+		struct svc *          svc;
+
+		ret = tinit_repo_read_dirent(dir, &ent);
+		if (ret) {
+			if (ret == -ENOENT)
+				/* End of directory iteration. */
+				ret = 0;
+			break;
+		}
+
+		/* Skip non regular files. */
+		if (ent->d_type != DT_REG)
+			continue;
+
+		/* Skip if no '.conf' file name extension found. */
+		if (!tinit_repo_is_conf_name(ent->d_name))
+			continue;
+
+		if (skip && tinit_repo_lookup_bypath(repo, ent->d_name))
+			continue;
+
+		ret = tinit_repo_load_svc(repo, ent->d_name, path, &svc);
+		if (!ret && svc && !--max)
+			ret = -EAGAIN;
+	} while (!ret);
+
+	return ret;
+}
+
+/*
+ * Load all services found into configuration directory. When @skip is true,
+ * services already loaded are left alone.
+ */
+static int
+tinit_repo_load_dir(struct tinit_repo * repo, bool skip)
+{
+	assert(repo);
+
+	int    ret;
+	DIR *  dir;
+	char * path;
+
+	ret = tinit_repo_open_dir(&dir, &path);
+	if (ret)
+		return ret;
+
+	ret = tinit_repo_load_dirents(repo, dir, path, skip, UINT_MAX);
+
+	tinit_repo_close_dir(dir, path);
+
+	return ret;
+}
+
+int
+tinit_repo_load(struct tinit_repo * repo)
+{
+	assert(repo);
+
+	int          ret;
+	struct svc * svc;
+
+	ret = tinit_repo_load_dir(repo, false);
+	if (ret) {
+		tinit_repo_clear(repo);
+		return ret;
+	}
+
+	tinit_repo_foreach(repo, svc) {
+		tinit_repo_setup_svc_starton(repo, svc);
+		tinit_repo_setup_svc_stopon(repo, svc);
+	}
+
+	repo->complete = true;
+
+	tinit_debug("service configuration loaded.");
+
+	return 0;
+}
+
+/* Stop loading services in the background. */
+static void
+tinit_repo_cancel_defer(void)
+{
+	if (utimer_is_armed(&tinit_repo_timer))
+		utimer_cancel(&tinit_repo_timer);
+
+	if (tinit_repo_slice_dir) {
+		tinit_repo_close_dir(tinit_repo_slice_dir,
+		                     tinit_repo_slice_path);
+		tinit_repo_slice_dir = NULL;
+	}
+}
+
+int
+tinit_repo_complete(struct tinit_repo * repo)
+{
+	assert(repo);
+
+	int ret;
+
+	if (repo->complete)
 		return 0;
 
-	/* Search for a '.conf' file name extension and skip if not found. */
-	ext = strrchr(ent->d_name, '.');
-	if (!ext || strcmp(&ext[1], "conf")) {
-		tinit_debug("'" CONFIG_TINIT_INCLUDE_DIR "/%s': "
-		            "skipping service configuration entry.",
-		            ent->d_name);
+	tinit_repo_cancel_defer();
+
+	ret = tinit_repo_load_dir(repo, true);
+	if (ret)
+		return ret;
+
+	repo->complete = true;
+	tinit_repo_rewire(repo);
+
+	tinit_debug("remaining service configuration loaded.");
+
+	return 0;
+}
+
+static int
+tinit_repo_fetch_conf(struct tinit_repo * repo,
+                      const char *        name,
+                      char                path[PATH_MAX],
+                      struct svc **       svc);
+
+/*
+ * Load service named @name when not loaded yet. Service is expected to be
+ * defined into a file named after it, i.e. "<name>.conf". When this is not the
+ * case, fall back to loading all services.
+ */
+static int
+tinit_repo_fetch_name(struct tinit_repo * repo,
+                      const char *        name,
+                      char                path[PATH_MAX])
+{
+	assert(repo);
+	assert(name);
+	assert(path);
+
+	char         base[NAME_MAX + 1];
+	struct svc * svc;
+	int          err;
+
+	if (repo->complete || tinit_repo_search_byname(repo, name))
+		return 0;
+
+	if ((size_t)snprintf(base, sizeof(base), "%s.conf", name) >=
+	    sizeof(base))
+		return tinit_repo_complete(repo);
+
+	if (tinit_repo_lookup_bypath(repo, base))
+		/* File loaded but defines another service. */
+		return tinit_repo_complete(repo);
+
+	strcpy(&path[TINIT_INCLUDE_DIR_LEN + 1], base);
+	if (access(path, F_OK))
+		return tinit_repo_complete(repo);
+
+	err = tinit_repo_fetch_conf(repo, base, path, &svc);
+	if (err)
+		return err;
+
+	if (!svc || strcmp(conf_get_name(svc->conf), name))
+		return tinit_repo_complete(repo);
+
+	return 0;
+}
+
+/* Load starton / stopon notifying services not loaded yet. */
+static int
+tinit_repo_fetch_deps(struct tinit_repo *   repo,
+                      const struct strarr * deps,
+                      char                  path[PATH_MAX])
+{
+	assert(repo);
+	assert(path);
+
+	unsigned int nr;
+	unsigned int d;
+
+	if (!deps)
 		return 0;
+
+	nr = strarr_nr(deps);
+	for (d = 0; d < nr; d++) {
+		int err;
+
+		err = tinit_repo_fetch_name(repo, strarr_get(deps, d), path);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+/* Load a service and the services it depends on. */
+static int
+tinit_repo_fetch_conf(struct tinit_repo * repo,
+                      const char *        name,
+                      char                path[PATH_MAX],
+                      struct svc **       svc)
+{
+	assert(repo);
+	assert(name);
+	assert(path);
+	assert(svc);
+
+	int err;
+
+	err = tinit_repo_load_svc(repo, name, path, svc);
+	if (err || !*svc)
+		return err;
+
+	err = tinit_repo_fetch_deps(repo, conf_get_starton((*svc)->conf), path);
+	if (err)
+		return err;
+
+	return tinit_repo_fetch_deps(repo, conf_get_stopon((*svc)->conf), path);
+}
+
+struct svc *
+tinit_repo_fetch_bypath(struct tinit_repo * repo, const char * base)
+{
+	assert(repo);
+	assert(base);
+	assert(*base);
+	assert((TINIT_INCLUDE_DIR_LEN + 1 + NAME_MAX) <= PATH_MAX);
+
+	struct svc * svc;
+	char *       path;
+	int          err;
+
+	svc = tinit_repo_search_bypath(repo, base);
+	if (svc || repo->complete)
+		return svc;
+
+	path = malloc(PATH_MAX);
+	if (!path)
+		return NULL;
+
+	memcpy(path, CONFIG_TINIT_INCLUDE_DIR, TINIT_INCLUDE_DIR_LEN);
+	path[TINIT_INCLUDE_DIR_LEN] = '/';
+
+	err = tinit_repo_fetch_conf(repo, base, path, &svc);
+
+	free(path);
+
+	if (err) {
+		errno = -err;
+		return NULL;
 	}
 
+	/* Dependencies may have triggered a full load in between. */
+	return svc ? svc : tinit_repo_search_bypath(repo, base);
+}
+
+int
+tinit_repo_fetch_byname(struct tinit_repo * repo,
+                        const char *        name,
+                        struct svc **       svc)
+{
+	assert(repo);
+	assert(name);
+	assert(*name);
+	assert(svc);
+	assert((TINIT_INCLUDE_DIR_LEN + 1 + NAME_MAX) <= PATH_MAX);
+
+	char * path;
+	int    err;
+
+	*svc = tinit_repo_search_byname(repo, name);
+	if (*svc)
+		return 0;
+	if (repo->complete)
+		return -ENOENT;
+
+	path = malloc(PATH_MAX);
+	if (!path)
+		return -errno;
+
+	memcpy(path, CONFIG_TINIT_INCLUDE_DIR, TINIT_INCLUDE_DIR_LEN);
+	path[TINIT_INCLUDE_DIR_LEN] = '/';
+
+	err = tinit_repo_fetch_name(repo, name, path);
+
+	free(path);
+
+	/* Wire services loaded in between, even partially. */
+	tinit_repo_rewire(repo);
+
+	if (err)
+		return err;
+
+	*svc = tinit_repo_search_byname(repo, name);
+
+	return *svc ? 0 : -ENOENT;
+}
+
+/*
+ * Load the next slice of services not loaded yet.
+ *
+ * Return: 0 once all services are loaded, -EAGAIN when more slices are to come,
+ *         another negative errno-like value otherwise.
+ */
+static int
+tinit_repo_complete_slice(struct tinit_repo * repo)
+{
+	assert(repo);
+	assert(!repo->complete);
+
+	int ret;
+
+	if (!tinit_repo_slice_dir) {
+		ret = tinit_repo_open_dir(&tinit_repo_slice_dir,
+		                          &tinit_repo_slice_path);
+		if (ret) {
+			tinit_repo_slice_dir = NULL;
+			return ret;
+		}
+	}
+
+	ret = tinit_repo_load_dirents(repo,
+	                              tinit_repo_slice_dir,
+	                              tinit_repo_slice_path,
+	                              true,
+	                              TINIT_REPO_SLICE_NR);
+	if (ret != -EAGAIN) {
+		tinit_repo_close_dir(tinit_repo_slice_dir,
+		                     tinit_repo_slice_path);
+		tinit_repo_slice_dir = NULL;
+		if (ret)
+			return ret;
+
+		repo->complete = true;
+		tinit_debug("remaining service configuration loaded.");
+	}
+
+	/* Wire services loaded by this slice. */
+	tinit_repo_rewire(repo);
+
+	return ret;
+}
+
+static void
+tinit_repo_expire(struct utimer * timer)
+{
+	struct tinit_repo * repo = tinit_repo_get();
+	const struct svc *  svc;
+	int                 ret;
+
+	/*
+	 * Wait for boot to complete, i.e. for start commands to complete.
+	 * Services waiting for a respawn delay, for notifiers or for admission
+	 * are not waited for so that a service stuck into a crash loop does
+	 * not defer loading forever. Give up waiting after a while anyway
+	 * since a failing start command may run for longer than the poll
+	 * period.
+	 */
+	if (!tinit_repo_slice_dir &&
+	    (++tinit_repo_defer_cnt < TINIT_REPO_DEFER_MAX)) {
+		tinit_repo_foreach(repo, svc) {
+			if ((svc->state == TINIT_SVC_STARTING_STAT) &&
+			    (svc->child > 0)) {
+				utimer_arm_sec(timer, TINIT_REPO_DEFER_TMOUT);
+				return;
+			}
+		}
+	}
+
+	ret = tinit_repo_complete_slice(repo);
+	if (ret == -EAGAIN) {
+		utimer_arm_msec(timer, TINIT_REPO_SLICE_TMOUT);
+		return;
+	}
+
+	if (ret)
+		tinit_warn("cannot load remaining service configuration: "
+		           "%s (%d).",
+		           strerror(-ret),
+		           -ret);
+}
+
+void
+tinit_repo_defer_complete(struct tinit_repo * repo)
+{
+	assert(repo);
+
+	if (repo->complete)
+		return;
+
+	tinit_repo_defer_cnt = 0;
+	utimer_init(&tinit_repo_timer);
+	utimer_setup(&tinit_repo_timer, tinit_repo_expire);
+	utimer_arm_sec(&tinit_repo_timer, TINIT_REPO_DEFER_TMOUT);
+}
+
+void
+tinit_repo_rewire(struct tinit_repo * repo)
+{
+	assert(repo);
+
+	struct svc * svc;
+
+	/*
+	 * Drop all start / stop notification edges first so that registering
+	 * below starts from empty notification polls.
+	 */
+	tinit_repo_foreach(repo, svc) {
+		if (svc->starton_notif)
+			notif_unregister_poll_sinks(svc->starton_notif);
+		if (svc->stopon_notif)
+			notif_unregister_poll_sinks(svc->stopon_notif);
+	}
+
+	tinit_repo_foreach(repo, svc) {
+		if (svc->gone)
+			continue;
+
+		tinit_repo_setup_svc_starton(repo, svc);
+		tinit_repo_setup_svc_stopon(repo, svc);
+	}
+
+	/* Start services which notifiers may have just become ready. */
+	tinit_repo_foreach(repo, svc) {
+		if (!svc->gone)
+			svc_kick(svc);
+	}
+}
+
+void
+tinit_repo_reap(struct tinit_repo * repo)
+{
+	assert(repo);
+
+	struct stroll_dlist_node * node;
+	bool                       rewire = false;
+
+	node = stroll_dlist_next(&repo->list);
+	while (node != &repo->list) {
+		struct svc * svc;
+
+		svc = stroll_dlist_entry(node, struct svc, repo);
+		node = stroll_dlist_next(node);
+
+		if (!svc->gone) {
+			/* Apply configuration changes pending till stopped. */
+			if (svc_settle(svc))
+				rewire = true;
+			continue;
+		}
+
+		if (svc->state != TINIT_SVC_STOPPED_STAT)
+			continue;
+
+		tinit_info("%s: service removed.", conf_get_name(svc->conf));
+
+		stroll_dlist_remove(&svc->repo);
+		tinit_repo_invalidate(repo);
+		svc_destroy(svc);
+	}
+
+	if (rewire)
+		tinit_repo_rewire(repo);
+}
+
+static void
+tinit_repo_retire_svc(struct svc * svc)
+{
+	assert(svc);
+
+	if (svc->gone)
+		return;
+
+	tinit_info("%s: service configuration removed.",
+	           conf_get_name(svc->conf));
+
+	svc->gone = true;
+	if ((svc->state == TINIT_SVC_STARTING_STAT) ||
+	    (svc->state == TINIT_SVC_READY_STAT))
+		svc_stop(svc);
+}
+
+static int
+tinit_repo_reload_svc(struct tinit_repo * repo,
+                      const char *        name,
+                      char                path[PATH_MAX])
+{
+	assert(repo);
+	assert(name);
+	assert(path);
+
+	struct conf_svc * conf;
+	struct svc *      svc;
+
 	/* Build absolute path and give it to service configuration parser. */
-	strcpy(&path[TINIT_INCLUDE_DIR_LEN + 1], ent->d_name);
+	strcpy(&path[TINIT_INCLUDE_DIR_LEN + 1], name);
 	conf = conf_create_from_file(path);
 	if (!conf)
-		/* Skip invalid configuration items. */
+		/* Keep current configuration when the new one is invalid. */
 		return (errno != ENOMEM) ? 0 : -ENOMEM;
 
+	svc = tinit_repo_lookup_bypath(repo, conf_get_path(conf));
+	if (svc) {
+		svc->gone = false;
+
+		if (conf_equal(svc->conf, conf)) {
+			/* Nothing changed: leave the service alone. */
+			conf_destroy(conf);
+			return 0;
+		}
+
+		tinit_info("%s: service configuration changed.",
+		           conf_get_name(conf));
+
+		svc_reconf(svc, conf);
+
+		return 0;
+	}
+
+	if (tinit_repo_search_byname(repo, conf_get_name(conf))) {
+		tinit_warn("'" CONFIG_TINIT_INCLUDE_DIR "/%s': "
+		           "service '%s' already exists.",
+		           name,
+		           conf_get_name(conf));
+		conf_destroy(conf);
+		return 0;
+	}
+
 	/* Create a service descriptor using loaded configuration. */
 	svc = svc_create(conf);
 	if (!svc) {
@@ -217,12 +991,95 @@ tinit_repo_load_svc(struct tinit_repo *   repo,
 
 	/* Register main service repository. */
 	stroll_dlist_append(&repo->list, &svc->repo);
+	tinit_repo_invalidate(repo);
+
+	tinit_info("%s: service added.", conf_get_name(conf));
+
+	return 0;
+}
+
+static int
+tinit_repo_update_svc(struct tinit_repo * repo,
+                      int                 dir,
+                      const char *        name,
+                      char                path[PATH_MAX])
+{
+	assert(repo);
+	assert(dir >= 0);
+	assert(name);
+	assert(path);
+
+	struct stat  st;
+	struct svc * svc;
+
+	if (!tinit_repo_is_conf_name(name))
+		return 0;
+
+	if (!fstatat(dir, name, &st, 0)) {
+		/* Skip non regular files. */
+		if (!S_ISREG(st.st_mode))
+			return 0;
+
+		return tinit_repo_reload_svc(repo, name, path);
+	}
+
+	if (errno != ENOENT)
+		return 0;
+
+	svc = tinit_repo_search_bypath(repo, name);
+	if (svc)
+		tinit_repo_retire_svc(svc);
 
 	return 0;
 }
 
 int
-tinit_repo_load(struct tinit_repo * repo)
+tinit_repo_update(struct tinit_repo * repo,
+                  const char * const  names[],
+                  unsigned int        nr)
+{
+	assert(repo);
+	assert(!nr || names);
+	assert((TINIT_INCLUDE_DIR_LEN + 1 + NAME_MAX) <= PATH_MAX);
+
+	int          ret;
+	int          dir;
+	char *       path;
+	unsigned int n;
+
+	dir = open(CONFIG_TINIT_INCLUDE_DIR,
+	           O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dir < 0) {
+		ret = errno;
+		tinit_repo_err(ret,
+		               "cannot open service configuration directory");
+		return -ret;
+	}
+
+	path = malloc(PATH_MAX);
+	if (!path) {
+		ret = -errno;
+		goto close;
+	}
+
+	memcpy(path, CONFIG_TINIT_INCLUDE_DIR, TINIT_INCLUDE_DIR_LEN);
+	path[TINIT_INCLUDE_DIR_LEN] = '/';
+
+	for (n = 0, ret = 0; (n < nr) && !ret; n++)
+		ret = tinit_repo_update_svc(repo, dir, names[n], path);
+
+	tinit_repo_reap(repo);
+	tinit_repo_rewire(repo);
+
+	free(path);
+close:
+	close(dir);
+
+	return ret;
+}
+
+int
+tinit_repo_reload(struct tinit_repo * repo)
 {
 	assert(repo);
 	assert((TINIT_INCLUDE_DIR_LEN + 1 + NAME_MAX) <= PATH_MAX);
@@ -251,6 +1108,14 @@ tinit_repo_load(struct tinit_repo * repo)
 	memcpy(path, CONFIG_TINIT_INCLUDE_DIR, TINIT_INCLUDE_DIR_LEN);
 	path[TINIT_INCLUDE_DIR_LEN] = '/';
 
+	/* Retire services which configuration file has disappeared... */
+	tinit_repo_foreach(repo, svc) {
+		if (faccessat(dirfd(dir), conf_get_path(svc->conf), F_OK, 0) &&
+		    (errno == ENOENT))
+			tinit_repo_retire_svc(svc);
+	}
+
+	/* ...then load new and modified ones. */
 	do {
 		const struct dirent * ent;
 
@@ -262,22 +1127,22 @@ tinit_repo_load(struct tinit_repo * repo)
 			break;
 		}
 
-		ret = tinit_repo_load_svc(repo, ent, path);
+		if ((ent->d_type != DT_REG) ||
+		    !tinit_repo_is_conf_name(ent->d_name))
+			continue;
+
+		ret = tinit_repo_reload_svc(repo, ent->d_name, path);
 	} while (!ret);
 
-	if (ret) {
-		tinit_repo_clear(repo);
-		goto free;
-	}
+	tinit_repo_reap(repo);
+	tinit_repo_rewire(repo);
 
-	tinit_repo_foreach(repo, svc) {
-		tinit_repo_setup_svc_starton(repo, svc);
-		tinit_repo_setup_svc_stopon(repo, svc);
+	if (!ret) {
+		tinit_repo_cancel_defer();
+		repo->complete = true;
+		tinit_debug("service configuration reloaded.");
 	}
 
-	tinit_debug("service configuration loaded.");
-
-free:
 	free(path);
 close:
 	closedir(dir);
@@ -292,6 +1157,8 @@ tinit_repo_clear(struct tinit_repo * repo)
 {
 	assert(repo);
 
+	tinit_repo_cancel_defer();
+
 	while (!stroll_dlist_empty(&repo->list)) {
 		struct svc * svc;
 
@@ -303,6 +1170,12 @@ tinit_repo_clear(struct tinit_repo * repo)
 
 		svc_destroy(svc);
 	}
+
+	free(repo->index);
+	repo->index = NULL;
+	repo->nr = 0;
+	repo->stale = true;
+	repo->complete = false;
 }
 
 #endif /* defined(CONFIG_TINIT_DEBUG) */
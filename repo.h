@@ -6,8 +6,21 @@
 
 struct svc;
 
+/*
+ * struct tinit_repo - Service repository.
+ *
+ * @list:  services in registration order
+ * @index: services sorted by name, rebuilt on demand once marked @stale
+ * @nr:       number of entries found into @index
+ * @stale:    whether @index must be rebuilt
+ * @complete: whether all service configuration files have been loaded
+ */
 struct tinit_repo {
 	struct stroll_dlist_node list;
+	struct svc **            index;
+	unsigned int             nr;
+	bool                     stale;
+	bool                     complete;
 };
 
 #define tinit_repo_foreach(_repo, _svc) \
@@ -18,6 +31,40 @@ tinit_repo_search_byname(
 	const struct tinit_repo * repo,
 	const char                name[TINIT_SVC_NAME_MAX]);
 
+/*
+ * tinit_repo_search_prefix() - Retrieve services which name starts with a
+ *                              given prefix.
+ *
+ * @repo:   the repository to search
+ * @prefix: name prefix, not necessarily NUL terminated
+ * @len:    length of @prefix, 0 to retrieve all services
+ * @svcs:   where to store the address of the first service found
+ *
+ * Services are found sorted by name thanks to the repository name index.
+ * Entries found at @svcs remain valid till the repository is modified.
+ *
+ * Return: number of services found at @svcs if successful, a negative
+ *         errno-like value otherwise.
+ */
+extern int
+tinit_repo_search_prefix(struct tinit_repo *   repo,
+                         const char *          prefix,
+                         size_t                len,
+                         struct svc * const ** svcs);
+
+/*
+ * tinit_repo_invalidate() - Mark repository name index as stale.
+ *
+ * @repo: the repository to invalidate
+ *
+ * Must be called each time services are registered, unregistered or renamed.
+ */
+static inline void
+tinit_repo_invalidate(struct tinit_repo * repo)
+{
+	repo->stale = true;
+}
+
 extern struct svc *
 tinit_repo_search_bypath(const struct tinit_repo * repo,
                          const char                path[NAME_MAX]);
@@ -29,6 +76,114 @@ tinit_repo_search_bypid(const struct tinit_repo * repo,
 extern int
 tinit_repo_load(struct tinit_repo * repo);
 
+/*
+ * tinit_repo_fetch_bypath() - Retrieve a service by configuration file name,
+ *                             loading it on demand.
+ *
+ * @repo: the repository to search
+ * @base: name of file found into CONFIG_TINIT_INCLUDE_DIR
+ *
+ * When not loaded yet, the service is loaded together with the starton /
+ * stopon notifying services it depends on. Caller is responsible for
+ * rewiring notifications. See tinit_repo_rewire().
+ *
+ * Return: service if found, NULL otherwise.
+ */
+extern struct svc *
+tinit_repo_fetch_bypath(struct tinit_repo * repo, const char * base);
+
+/*
+ * tinit_repo_fetch_byname() - Retrieve a service by name, loading it on demand.
+ *
+ * @repo: the repository to search
+ * @name: name of service to retrieve
+ * @svc:  where to store the address of service found
+ *
+ * Meant to look services up on behalf of clients since the repository may
+ * have been only partially loaded at boot time. When not loaded yet, the
+ * service is fetched from "<name>.conf", falling back to loading all services
+ * not loaded yet. Notifications are rewired as needed.
+ *
+ * Return: 0 if successful, -ENOENT if no such service, another negative
+ *         errno-like value otherwise.
+ */
+extern int
+tinit_repo_fetch_byname(struct tinit_repo * repo,
+                        const char *        name,
+                        struct svc **       svc);
+
+/*
+ * tinit_repo_complete() - Load services not loaded yet.
+ *
+ * @repo: the repository to complete
+ *
+ * Must be called before walking all services on behalf of clients since the
+ * repository may have been only partially loaded at boot time.
+ *
+ * Return: 0 if successful, a negative errno-like value otherwise.
+ */
+extern int
+tinit_repo_complete(struct tinit_repo * repo);
+
+/*
+ * tinit_repo_defer_complete() - Complete repository once boot is over.
+ *
+ * @repo: the repository to complete
+ *
+ * Remaining services are loaded once no service is starting anymore.
+ */
+extern void
+tinit_repo_defer_complete(struct tinit_repo * repo);
+
+/*
+ * tinit_repo_update() - Reload a set of service configuration files.
+ *
+ * @repo:  the repository to update
+ * @names: names of files found into CONFIG_TINIT_INCLUDE_DIR
+ * @nr:    number of entries found into @names
+ *
+ * Only services which configuration has actually changed are restarted.
+ * Services which configuration file has been removed are stopped then
+ * destroyed.
+ *
+ * Return: 0 if successful, a negative errno-like value otherwise.
+ */
+extern int
+tinit_repo_update(struct tinit_repo * repo,
+                  const char * const  names[],
+                  unsigned int        nr);
+
+/*
+ * tinit_repo_reload() - Reload all service configuration files.
+ *
+ * @repo: the repository to reload
+ *
+ * Same as tinit_repo_update() for the whole CONFIG_TINIT_INCLUDE_DIR content.
+ *
+ * Return: 0 if successful, a negative errno-like value otherwise.
+ */
+extern int
+tinit_repo_reload(struct tinit_repo * repo);
+
+/*
+ * tinit_repo_rewire() - Rebuild start / stop notification edges.
+ *
+ * @repo: the repository to rewire
+ */
+extern void
+tinit_repo_rewire(struct tinit_repo * repo);
+
+/*
+ * tinit_repo_reap() - Destroy removed services once stopped.
+ *
+ * @repo: the repository to reap
+ *
+ * Also applies configuration changes deferred till services stopped and
+ * rewires notifications accordingly. See svc_settle().
+ */
+extern void
+tinit_repo_reap(struct tinit_repo * repo);
+
 #if defined(CONFIG_TINIT_DEBUG)
 
 extern void
@@ -2,16 +2,26 @@
 #include "svc.h"
 #include "repo.h"
 #include "log.h"
+#include "evlog.h"
 #include <stroll/cdefs.h>
 #include <utils/signal.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/eventfd.h>
 
 /*
  * Enough entries to hold the following regular signals:
- * SIGCHLD, SIGTERM, SIGUSR1, SIGUSR2, SIGPWR.
+ * SIGCHLD, SIGTERM, SIGUSR1, SIGUSR2, SIGPWR, SIGHUP.
  */
-#define TINIT_SIGNAL_NR (5U)
+#define TINIT_SIGNAL_NR (6U)
+
+/*
+ * Deferred work wake up eventfd. Standalone so that services and targets may
+ * wake the channel up without holding a reference to it.
+ */
+static int tinit_sigchan_defer_fd = -1;
 
 #if defined(CONFIG_TINIT_DEBUG)
 
@@ -95,12 +105,58 @@ tinit_sigchan_from_worker(const struct upoll_worker * worker)
 	return containerof(worker, struct tinit_sigchan, work);
 }
 
-static unsigned int
+static struct tinit_sigchan *
+tinit_sigchan_from_defer(const struct upoll_worker * worker)
+{
+	return containerof(worker, struct tinit_sigchan, defer);
+}
+
+static void
+tinit_sigchan_clear_defer(void)
+{
+	assert(tinit_sigchan_defer_fd >= 0);
+
+	uint64_t cnt;
+
+	/* Reset wake up counter ; nothing to do if already cleared. */
+	if (read(tinit_sigchan_defer_fd, &cnt, sizeof(cnt)) < 0)
+		assert(errno == EAGAIN);
+}
+
+void
+tinit_sigchan_defer(void)
+{
+	const uint64_t cnt = 1;
+
+	if (tinit_sigchan_defer_fd < 0)
+		return;
+
+	/* Counter cannot practically saturate: EAGAIN may be ignored. */
+	if (write(tinit_sigchan_defer_fd, &cnt, sizeof(cnt)) < 0)
+		assert(errno == EAGAIN);
+}
+
+/*
+ * Processes left behind by stopping services are reaped as unknown processes
+ * once orphaned: tell stopping services to check whether theirs are gone.
+ */
+static void
+tinit_sigchan_reap_leftovers(const struct tinit_repo * repo)
+{
+	assert(repo);
+
+	struct svc * svc;
+
+	tinit_repo_foreach(repo, svc)
+		svc_reap_leftover(svc);
+}
+
+static void
 tinit_sigchan_handle_sigchld(const struct tinit_repo * repo)
 {
 	assert(repo);
 
-	unsigned int cnt = 0;
+	bool orphans = false;
 
 	while (true) {
 		int          err;
@@ -120,7 +176,7 @@ tinit_sigchan_handle_sigchld(const struct tinit_repo * repo)
 			/* No more children in waitable state. */
 			assert(errno == ECHILD);
 
-			return cnt;
+			break;
 		}
 
 		/* For SIGCHLD, valid siginfo_t fields are:
@@ -144,7 +200,7 @@ tinit_sigchan_handle_sigchld(const struct tinit_repo * repo)
 		 */
 		if (!info.si_pid || !info.si_signo)
 			/* No more child in waitable state. */
-			return cnt;
+			break;
 
 		assert(info.si_pid);
 		assert(info.si_signo == SIGCHLD);
@@ -153,17 +209,29 @@ tinit_sigchan_handle_sigchld(const struct tinit_repo * repo)
 
 		tinit_sigchan_log_info(&info, svc);
 
-		if (!svc)
+		if (!svc) {
+			orphans = true;
 			continue;
+		}
+
+		tinit_metrics_reap_svc(&svc->metrics, &info);
 
 		switch (info.si_code) {
 		case CLD_EXITED:
-			svc_handle_evts(svc, SVC_EXIT_EVT, info.si_status);
+			tinit_evlog_record(TINIT_EXIT_EVENT,
+			                   svc_get_id(svc),
+			                   info.si_pid,
+			                   info.si_status);
+			svc_handle_exit(svc, info.si_pid, info.si_status);
 			break;
 
 		case CLD_KILLED:
 		case CLD_DUMPED:
-			svc_handle_evts(svc, SVC_EXIT_EVT, -info.si_status);
+			tinit_evlog_record(TINIT_EXIT_EVENT,
+			                   svc_get_id(svc),
+			                   info.si_pid,
+			                   -info.si_status);
+			svc_handle_exit(svc, info.si_pid, -info.si_status);
 			break;
 
 		default:
@@ -178,10 +246,10 @@ tinit_sigchan_handle_sigchld(const struct tinit_repo * repo)
 			 */
 			assert(0);
 		}
-
-		if (svc->state == TINIT_SVC_STOPPED_STAT)
-			cnt++;
 	}
+
+	if (orphans)
+		tinit_sigchan_reap_leftovers(repo);
 }
 
 static int
@@ -223,6 +291,8 @@ tinit_sigchan_dispatch_started(struct upoll_worker * worker,
 		switch (info->ssi_signo) {
 		case SIGCHLD:
 			tinit_sigchan_handle_sigchld(repo);
+			/* Release services removed from configuration. */
+			tinit_repo_reap(repo);
 			break;
 
 		case SIGTERM:
@@ -240,13 +310,28 @@ tinit_sigchan_dispatch_started(struct upoll_worker * worker,
 				break;
 			}
 
-			/* Tell the caller we were requested to shutdown. */
-			if (!chan->signo) {
+			/*
+			 * Tell the caller we were requested to shutdown.
+			 * Shutdown takes precedence over re-execution.
+			 */
+			if (!chan->signo || (chan->signo == SIGHUP)) {
 				chan->signo = info->ssi_signo;
 				ret = -ESHUTDOWN;
 			}
 			break;
 
+		case SIGHUP:
+			if ((info->ssi_code != SI_USER) &&
+			    (info->ssi_code != SI_QUEUE))
+				break;
+
+			/* Tell the caller we were requested to re-execute. */
+			if (!chan->signo) {
+				chan->signo = SIGHUP;
+				ret = -ESHUTDOWN;
+			}
+			break;
+
 		default:
 			assert(0);
 		}
@@ -255,26 +340,58 @@ tinit_sigchan_dispatch_started(struct upoll_worker * worker,
 	return ret;
 }
 
+static int
+tinit_sigchan_dispatch_defer_started(struct upoll_worker * worker,
+                                     uint32_t              state __unused,
+                                     const struct upoll *  poller __unused)
+{
+	assert(worker);
+	assert(state & EPOLLIN);
+	assert(poller);
+
+	tinit_sigchan_clear_defer();
+
+	/* Release services removed from configuration. */
+	tinit_repo_reap(tinit_repo_get());
+
+	return 0;
+}
+
 int
 tinit_sigchan_start(struct tinit_sigchan *        chan,
                     const struct upoll * poller)
 {
 	assert(chan);
+	assert(tinit_sigchan_defer_fd >= 0);
 
 	int err;
 
 	chan->work.dispatch = tinit_sigchan_dispatch_started;
 	err = upoll_register(poller, chan->fd, EPOLLIN, &chan->work);
+	if (err)
+		goto err;
+
+	/* Work deferred before channel was started is run once polled. */
+	chan->defer.dispatch = tinit_sigchan_dispatch_defer_started;
+	err = upoll_register(poller,
+	                     tinit_sigchan_defer_fd,
+	                     EPOLLIN,
+	                     &chan->defer);
 	if (err) {
-		tinit_err("signal: cannot start channel: %s (%d).",
-		          strerror(err),
-		          err);
-		return err;
+		upoll_unregister(poller, chan->fd);
+		goto err;
 	}
 
 	tinit_debug("signal: channel started.");
 
 	return 0;
+
+err:
+	tinit_err("signal: cannot start channel: %s (%d).",
+	          strerror(-err),
+	          -err);
+
+	return err;
 }
 
 static int
@@ -298,7 +415,7 @@ tinit_sigchan_dispatch_stopping(struct upoll_worker * worker,
 	struct tinit_repo *     repo;
 	unsigned int            i;
 
-	assert(chan->cnt);
+	assert(chan->stopped);
 
 	ret = usig_read_fd(chan->fd, infos, stroll_array_nr(infos));
 	assert(ret);
@@ -311,13 +428,8 @@ tinit_sigchan_dispatch_stopping(struct upoll_worker * worker,
 		const struct signalfd_siginfo * info = &infos[i];
 
 		if (info->ssi_signo == SIGCHLD) {
-			unsigned int cnt;
-
-			cnt = tinit_sigchan_handle_sigchld(repo);
-			assert(cnt <= chan->cnt);
-
-			chan->cnt -= cnt;
-			if (!chan->cnt)
+			tinit_sigchan_handle_sigchld(repo);
+			if (chan->stopped())
 				goto closed;
 		}
 	}
@@ -325,22 +437,71 @@ tinit_sigchan_dispatch_stopping(struct upoll_worker * worker,
 	return 0;
 
 closed:
+	upoll_unregister(poller, tinit_sigchan_defer_fd);
+	upoll_unregister(poller, chan->fd);
+
+	return -ESHUTDOWN;
+}
+
+static int
+tinit_sigchan_dispatch_defer_stopping(struct upoll_worker * worker,
+                                      uint32_t              state __unused,
+                                      const struct upoll *  poller)
+{
+	assert(worker);
+	assert(state & EPOLLIN);
+	assert(poller);
+
+	struct tinit_sigchan * chan = tinit_sigchan_from_defer(worker);
+
+	assert(chan->stopped);
+
+	tinit_sigchan_clear_defer();
+
+	if (!chan->stopped())
+		return 0;
+
+	upoll_unregister(poller, tinit_sigchan_defer_fd);
 	upoll_unregister(poller, chan->fd);
 
 	return -ESHUTDOWN;
 }
 
 void
-tinit_sigchan_stop(struct tinit_sigchan * chan, unsigned int cnt)
+tinit_sigchan_stop(struct tinit_sigchan *  chan,
+                   tinit_sigchan_stop_fn * stopped)
 {
 	assert(chan);
+	assert(stopped);
 
 	chan->work.dispatch = tinit_sigchan_dispatch_stopping;
-	chan->cnt = cnt;
+	chan->defer.dispatch = tinit_sigchan_dispatch_defer_stopping;
+	chan->stopped = stopped;
 
 	tinit_debug("signal: stopping channel...");
 }
 
+static int
+tinit_sigchan_open_defer(void)
+{
+	assert(tinit_sigchan_defer_fd < 0);
+
+	int fd;
+
+	fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (fd < 0) {
+		tinit_err("signal: cannot open deferred work channel: "
+		          "%s (%d).",
+		          strerror(errno),
+		          errno);
+		return -errno;
+	}
+
+	tinit_sigchan_defer_fd = fd;
+
+	return 0;
+}
+
 int
 tinit_sigchan_open(struct tinit_sigchan * chan)
 {
@@ -348,12 +509,14 @@ tinit_sigchan_open(struct tinit_sigchan * chan)
 
 	sigset_t msk = sig_empty_msk;
 	int      fd;
+	int      err;
 
 	usig_addset(&msk, SIGTERM);
 	usig_addset(&msk, SIGUSR1);
 	usig_addset(&msk, SIGUSR2);
 	usig_addset(&msk, SIGPWR);
 	usig_addset(&msk, SIGCHLD);
+	usig_addset(&msk, SIGHUP);
 
 	fd = usig_open_fd(&msk, SFD_NONBLOCK | SFD_CLOEXEC);
 	if (fd < 0) {
@@ -363,6 +526,12 @@ tinit_sigchan_open(struct tinit_sigchan * chan)
 		return -errno;
 	}
 
+	err = tinit_sigchan_open_defer();
+	if (err) {
+		usig_close_fd(fd);
+		return err;
+	}
+
 	chan->fd = fd;
 
 	tinit_debug("signal: channel opened.");
@@ -370,8 +539,34 @@ tinit_sigchan_open(struct tinit_sigchan * chan)
 	return 0;
 }
 
+int
+tinit_sigchan_adopt(struct tinit_sigchan * chan, int fd)
+{
+	assert(chan);
+	assert(fd >= 0);
+
+	int err;
+
+	/* Deferred work eventfd is not inherited: it is closed on exec. */
+	err = tinit_sigchan_open_defer();
+	if (err)
+		return err;
+
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	chan->fd = fd;
+
+	tinit_debug("signal: channel adopted.");
+
+	return 0;
+}
+
 void
 tinit_sigchan_close(const struct tinit_sigchan * chan)
 {
+	assert(tinit_sigchan_defer_fd >= 0);
+
+	close(tinit_sigchan_defer_fd);
+	tinit_sigchan_defer_fd = -1;
+
 	usig_close_fd(chan->fd);
 }
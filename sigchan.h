@@ -2,13 +2,24 @@
 #define _TINIT_SIGCHAN_H
 
 #include <utils/poll.h>
+#include <stdbool.h>
 #include <assert.h>
 
+/*
+ * tinit_sigchan_stop_fn - Shutdown progress callback.
+ *
+ * Run each time child processes have been reaped while stopping.
+ *
+ * Return: true once all services are stopped, false otherwise.
+ */
+typedef bool (tinit_sigchan_stop_fn)(void);
+
 struct tinit_sigchan {
-	struct upoll_worker work;
-	int                 fd;
-	int                 signo;
-	unsigned int        cnt;
+	struct upoll_worker     work;
+	struct upoll_worker     defer;
+	int                     fd;
+	int                     signo;
+	tinit_sigchan_stop_fn * stopped;
 };
 
 static inline int
@@ -23,12 +34,39 @@ extern int
 tinit_sigchan_start(struct tinit_sigchan *        chan,
                     const struct upoll * poller);
 
+/*
+ * tinit_sigchan_stop() - Switch channel to shutdown mode.
+ *
+ * @chan:    the channel to switch
+ * @stopped: callback telling whether shutdown is over
+ *
+ * Channel gets closed, and poll loop exits, as soon as @stopped returns true.
+ */
 extern void
-tinit_sigchan_stop(struct tinit_sigchan * chan, unsigned int cnt);
+tinit_sigchan_stop(struct tinit_sigchan *  chan,
+                   tinit_sigchan_stop_fn * stopped);
 
 extern int
 tinit_sigchan_open(struct tinit_sigchan * chan);
 
+/*
+ * tinit_sigchan_adopt() - Setup channel from a signalfd inherited across
+ *                         re-execution.
+ */
+extern int
+tinit_sigchan_adopt(struct tinit_sigchan * chan, int fd);
+
+/*
+ * tinit_sigchan_defer() - Wake channel up to run deferred work from main loop.
+ *
+ * Services removed from configuration are released, and shutdown progress is
+ * checked, just as if child processes had been reaped. Meant for callers that
+ * may not do so themselves, e.g. from within a service notification walk or a
+ * timer handler.
+ */
+extern void
+tinit_sigchan_defer(void);
+
 extern void
 tinit_sigchan_close(const struct tinit_sigchan * chan);
 
@@ -4,15 +4,22 @@
 #include "target.h"
 #include "svc.h"
 #include "conf.h"
+#include "capture.h"
+#include "evlog.h"
+#include "metrics.h"
+#include "match.h"
 #include "log.h"
 #include <stdlib.h>
 #include <assert.h>
 #include <errno.h>
-#include <fnmatch.h>
 #include <sys/stat.h>
 
 #define TINIT_SRV_SEND_BUFF_NR (16U)
 
+#if TINIT_SRV_WAIT_NR >= TINIT_SRV_SEND_BUFF_NR
+#error Parked wait requests must leave room for other requests !
+#endif
+
 /******************************************************************************
  * Server side protocol payload handling
  ******************************************************************************/
@@ -24,19 +31,54 @@ tinit_srv_parse_request(const struct unsk_dgram_buff * buff,
 {
 	const struct tinit_request_msg * msg = (struct tinit_request_msg *)
 	                                       buff->data;
-	size_t                           sz = buff->unsk.bytes - sizeof(*msg);
+	const char *                     str = msg->pattern;
+	size_t                           sz;
 
-	if ((sz <= 1) || (sz > TINIT_SVC_PATTERN_MAX))
+	if (buff->unsk.bytes < sizeof(*msg))
 		return -EPROTO;
 
 	if (msg->type >= TINIT_MSG_TYPE_NR)
 		return -EPROTO;
 
-	if ((strnlen(msg->pattern, sz) + 1) != sz)
+	switch (msg->type) {
+	case TINIT_STATUS_MSG_TYPE:
+	case TINIT_XSTATUS_MSG_TYPE:
+		/* Status requests carry paging arguments before pattern. */
+		if (buff->unsk.bytes < sizeof(struct tinit_status_msg))
+			return -EPROTO;
+		str = ((const struct tinit_status_msg *)msg)->pattern;
+		break;
+
+	case TINIT_WAIT_MSG_TYPE:
+		/* Wait requests carry extra arguments before service name. */
+		if (buff->unsk.bytes < sizeof(struct tinit_wait_msg))
+			return -EPROTO;
+		str = ((const struct tinit_wait_msg *)msg)->name;
+		break;
+
+	case TINIT_RELOAD_REPO_MSG_TYPE:
+		/*
+		 * Repository reload requests carry no pattern. Still accept
+		 * the dummy one given by former clients.
+		 */
+		if (buff->unsk.bytes == sizeof(*msg)) {
+			*type = msg->type;
+			pattern[0] = '\0';
+
+			return 0;
+		}
+		break;
+	}
+
+	sz = buff->unsk.bytes - (size_t)(str - buff->data);
+	if ((sz <= 1) || (sz > TINIT_SVC_PATTERN_MAX))
+		return -EPROTO;
+
+	if ((strnlen(str, sz) + 1) != sz)
 		return -EPROTO;
 
 	*type = msg->type;
-	memcpy(pattern, msg->pattern, sz);
+	memcpy(pattern, str, sz);
 
 	return sz - 1;
 }
@@ -64,54 +106,97 @@ tinit_srv_setup_status_reply(struct unsk_dgram_buff * buff)
 	struct tinit_status_reply * msg = (struct tinit_status_reply *)
 	                                  buff->data;
 
-	assert(msg->head.type == TINIT_STATUS_MSG_TYPE);
+	assert((msg->head.type == TINIT_STATUS_MSG_TYPE) ||
+	       (msg->head.type == TINIT_XSTATUS_MSG_TYPE));
 
 	msg->head.ret = 0;
+	msg->next = 0;
 	buff->unsk.bytes = sizeof(*msg);
 }
 
+/*
+ * Append status record of a service. Extended records (@ext) are prefixed by a
+ * header carrying runtime data and also carry service name, as well as service
+ * description when requested (@desc), so that clients need not parse service
+ * configuration files.
+ */
 static int
 tinit_srv_append_status_reply(struct unsk_dgram_buff * buff,
-                              pid_t                             pid,
-                              bool                              on,
-                              enum tinit_svc_state              state,
-                              const char *             path,
-                              size_t                            len)
+                              const struct svc *       svc,
+                              bool                     ext,
+                              bool                     desc)
 {
 	assert(buff);
-	assert((state == TINIT_SVC_STOPPED_STAT) ||
-	       (state == TINIT_SVC_STARTING_STAT) ||
-	       (state == TINIT_SVC_READY_STAT) ||
-	       (state == TINIT_SVC_STOPPING_STAT));
-	assert(path);
-	assert(path[0]);
-	assert(len);
-	assert(len < NAME_MAX);
-
+	assert(svc);
+	assert(ext || !desc);
+	assert((svc->state == TINIT_SVC_STOPPED_STAT) ||
+	       (svc->state == TINIT_SVC_STARTING_STAT) ||
+	       (svc->state == TINIT_SVC_READY_STAT) ||
+	       (svc->state == TINIT_SVC_STOPPING_STAT));
+
+	const char *                path = conf_get_path(svc->conf);
+	size_t                      len = strlen(path);
+	const char *                name = NULL;
+	size_t                      name_len = 0;
+	const char *                str = NULL;
+	size_t                      desc_len = 0;
 	size_t                      sz;
+	struct tinit_status_ext *   xt = NULL;
 	struct tinit_status_data *  data;
 	struct tinit_status_reply * msg = (struct tinit_status_reply *)
 	                                  buff->data;
 
+	assert(path[0]);
+	assert(len < NAME_MAX);
 	assert(!msg->head.ret);
 	assert(buff->unsk.bytes >= sizeof(*msg));
 	assert(buff->unsk.bytes <= TINIT_MSG_SIZE_MAX);
 
-	sz = stroll_round_upper(buff->unsk.bytes, sizeof(*data));
+	sz = stroll_round_upper(buff->unsk.bytes, TINIT_STATUS_ALIGN);
+	if (ext) {
+		name = conf_get_name(svc->conf);
+		name_len = strlen(name);
+		assert(name_len);
+		assert(name_len < TINIT_SVC_NAME_MAX);
+
+		if (desc && svc->conf->desc) {
+			str = svc->conf->desc;
+			desc_len = strnlen(str, TINIT_STATUS_DESC_MAX);
+		}
+
+		xt = (struct tinit_status_ext *)&buff->data[sz];
+		sz += sizeof(*xt);
+	}
+
 	data = (struct tinit_status_data *)&buff->data[sz];
 	sz += sizeof(*data) + len + 1;
-	if (sz > TINIT_MSG_SIZE_MAX) {
-		msg->head.ret = (uint16_t)ENOSPC;
-		buff->unsk.bytes = sizeof(msg->head);
-
+	if (xt)
+		sz += name_len + 1 + desc_len + 1;
+	if (sz > TINIT_MSG_SIZE_MAX)
 		return -ENOSPC;
-	}
 
-	data->pid = pid;
-	data->adm_state = (uint8_t)on;
-	data->run_state = (uint8_t)state;
+	data->pid = svc->child;
+	data->adm_state = (uint8_t)svc_is_on(svc);
+	data->run_state = (uint8_t)svc->state;
+	data->pad = 0;
+	data->svc_id = svc_get_id(svc);
 	memcpy(data->conf_path, path, len + 1);
 
+	if (xt) {
+		char * tail = &data->conf_path[len + 1];
+
+		xt->since = svc->metrics.since;
+		xt->restarts = (uint32_t)svc->metrics.restarts;
+		xt->name_len = (uint8_t)name_len;
+		xt->desc_len = (uint8_t)desc_len;
+		xt->pad = 0;
+
+		memcpy(tail, name, name_len + 1);
+		tail += name_len + 1;
+		memcpy(tail, str ? str : "", desc_len);
+		tail[desc_len] = '\0';
+	}
+
 	buff->unsk.bytes = sz;
 
 	return 0;
@@ -123,47 +208,100 @@ tinit_srv_append_status_reply(struct unsk_dgram_buff * buff,
 
 static int
 tinit_srv_request_status(struct unsk_dgram_buff * buff,
-                         const char *             pattern)
+                         const char *             pattern,
+                         size_t                   len,
+                         bool                     ext)
 {
-	const struct tinit_repo * repo;
-	const struct svc *        svc;
-	int                       ret = 0;
-	unsigned int              cnt = 0;
-
+	const struct tinit_status_msg * req = (const struct tinit_status_msg *)
+	                                      buff->data;
+	int                             start = req->start;
+	bool                            desc = ext &&
+	                                       (req->flags &
+	                                        TINIT_STATUS_DESC_FLAG);
+	struct tinit_match              match;
+	struct svc * const *            svcs;
+	int                             nr;
+	int                             s;
+	int                             ret = 0;
+	unsigned int                    cnt = 0;
+
+	/* Paging arguments fetched above as reply overwrites request. */
 	tinit_srv_setup_status_reply(buff);
 
-	repo = tinit_repo_get();
-	tinit_repo_foreach(repo, svc) {
-		const struct conf_svc * conf = svc->conf;
-		const char *            path;
+	/*
+	 * Compile pattern once for all services and only visit services which
+	 * name starts with the pattern literal prefix if any.
+	 */
+	tinit_match_compile(&match, pattern, len);
+
+	/*
+	 * A literal pattern names a single service which may not have been
+	 * loaded at boot time. Wildcard patterns only match services loaded so
+	 * far, till the background load of remaining ones completes.
+	 */
+	if ((tinit_match_fixed_len(&match) == len) &&
+	    !tinit_check_svc_name(pattern, len)) {
+		struct svc * svc;
+
+		ret = tinit_repo_fetch_byname(tinit_repo_get(), pattern, &svc);
+		if (ret && (ret != -ENOENT)) {
+			tinit_srv_build_reply(buff, ret);
+			return 0;
+		}
+	}
+
+	nr = tinit_repo_search_prefix(tinit_repo_get(),
+	                              pattern,
+	                              tinit_match_fixed_len(&match),
+	                              &svcs);
+	if (nr < 0) {
+		tinit_srv_build_reply(buff, nr);
+		return 0;
+	}
+
+	/*
+	 * Resume from where previous reply page stopped. Records may be missed
+	 * or repeated if services are loaded in between.
+	 */
+	for (s = start; s < nr; s++) {
+		const struct svc * svc = svcs[s];
 
-		ret = fnmatch(pattern,
-		              conf_get_name(conf),
-		              FNM_NOESCAPE | FNM_PERIOD | FNM_EXTMATCH);
-		if (ret == FNM_NOMATCH)
+		ret = tinit_match_name(&match, conf_get_name(svc->conf));
+		if (!ret)
 			continue;
 
-		if (ret) {
-			tinit_srv_build_reply(buff, -EINVAL);
+		if (ret < 0) {
+			tinit_srv_build_reply(buff, ret);
 			return 0;
 		}
 
-		path = conf_get_path(svc->conf);
-		ret = tinit_srv_append_status_reply(buff,
-		                                    svc->child,
-		                                    svc_is_on(svc),
-		                                    svc->state,
-		                                    path,
-		                                    strlen(path));
-		if (ret)
+		ret = tinit_srv_append_status_reply(buff, svc, ext, desc);
+		if (ret) {
+			struct tinit_status_reply * msg =
+				(struct tinit_status_reply *)buff->data;
+
+			assert(ret == -ENOSPC);
+			if (!cnt) {
+				tinit_metrics_count_nospc();
+				tinit_srv_build_reply(buff, ret);
+				return 0;
+			}
+
+			/* Full: client will request remaining records. */
+			msg->next = (uint16_t)s;
 			return 0;
+		}
 
 		cnt++;
 	}
 
-	if (!cnt)
+	if (!cnt && !start)
 		tinit_srv_build_reply(buff, -ENOENT);
 
+	/*
+	 * Otherwise, services matched by previous pages are gone: give an empty
+	 * final page.
+	 */
 	return 0;
 }
 
@@ -179,8 +317,8 @@ tinit_srv_request_start(struct unsk_dgram_buff * buff,
 	if (ret)
 		goto reply;
 
-	svc = tinit_repo_search_byname(tinit_repo_get(), name);
-	if (svc) {
+	ret = tinit_repo_fetch_byname(tinit_repo_get(), name, &svc);
+	if (!ret) {
 		switch (svc->state) {
 		case TINIT_SVC_STARTING_STAT:
 		case TINIT_SVC_READY_STAT:
@@ -189,11 +327,7 @@ tinit_srv_request_start(struct unsk_dgram_buff * buff,
 		default:
 			svc_start(svc);
 		}
-
-		ret = 0;
 	}
-	else
-		ret = -ENOENT;
 
 reply:
 	tinit_srv_build_reply(buff, ret);
@@ -213,8 +347,8 @@ tinit_srv_request_stop(struct unsk_dgram_buff * buff,
 	if (ret)
 		goto reply;
 
-	svc = tinit_repo_search_byname(tinit_repo_get(), name);
-	if (svc) {
+	ret = tinit_repo_fetch_byname(tinit_repo_get(), name, &svc);
+	if (!ret) {
 		switch (svc->state) {
 		case TINIT_SVC_STOPPED_STAT:
 		case TINIT_SVC_STOPPING_STAT:
@@ -223,11 +357,7 @@ tinit_srv_request_stop(struct unsk_dgram_buff * buff,
 		default:
 			svc_stop(svc);
 		}
-
-		ret = 0;
 	}
-	else
-		ret = -ENOENT;
 
 reply:
 	tinit_srv_build_reply(buff, ret);
@@ -258,8 +388,8 @@ tinit_srv_request_reload(struct unsk_dgram_buff * buff,
 	if (ret)
 		goto reply;
 
-	svc = tinit_repo_search_byname(tinit_repo_get(), name);
-	if (svc) {
+	ret = tinit_repo_fetch_byname(tinit_repo_get(), name, &svc);
+	if (!ret) {
 		switch (svc->state) {
 		case TINIT_SVC_STOPPED_STAT:
 		case TINIT_SVC_STOPPING_STAT:
@@ -276,11 +406,7 @@ tinit_srv_request_reload(struct unsk_dgram_buff * buff,
 		default:
 			assert(0);
 		}
-
-		ret = 0;
 	}
-	else
-		ret = -ENOENT;
 
 reply:
 	tinit_srv_build_reply(buff, ret);
@@ -304,6 +430,174 @@ tinit_srv_request_switch(struct unsk_dgram_buff * buff,
 	return 0;
 }
 
+static int
+tinit_srv_request_reload_repo(struct unsk_dgram_buff * buff)
+{
+	tinit_srv_build_reply(buff, tinit_repo_reload(tinit_repo_get()));
+
+	return 0;
+}
+
+static int
+tinit_srv_request_logs(struct unsk_dgram_buff * buff,
+                       const char *             name,
+                       size_t                   len)
+{
+	struct tinit_logs_reply * msg = (struct tinit_logs_reply *)buff->data;
+	struct svc *              svc;
+	int                       ret;
+
+	ret = tinit_check_svc_name(name, len);
+	if (ret)
+		goto reply;
+
+	ret = tinit_repo_fetch_byname(tinit_repo_get(), name, &svc);
+	if (ret)
+		goto reply;
+
+	if (!svc->capture) {
+		ret = -ENODATA;
+		goto reply;
+	}
+
+	msg->head.ret = 0;
+	buff->unsk.bytes = sizeof(*msg) +
+	                   capture_read_tail(svc->capture,
+	                                     msg->data,
+	                                     TINIT_MSG_SIZE_MAX - sizeof(*msg));
+
+	return 0;
+
+reply:
+	tinit_srv_build_reply(buff, ret);
+
+	return 0;
+}
+
+static int
+tinit_srv_request_events(struct unsk_dgram_buff * buff)
+{
+	struct tinit_events_reply * msg = (struct tinit_events_reply *)
+	                                  buff->data;
+	unsigned int                nr;
+
+	nr = tinit_evlog_read(msg->events,
+	                      (TINIT_MSG_SIZE_MAX - sizeof(*msg)) /
+	                      sizeof(msg->events[0]));
+
+	msg->head.ret = 0;
+	buff->unsk.bytes = sizeof(*msg) + (nr * sizeof(msg->events[0]));
+
+	return 0;
+}
+
+static void
+tinit_srv_complete_wait(struct tinit_srv_wait * wait, int ret)
+{
+	assert(wait);
+	assert(wait->srv);
+	assert(wait->buff);
+
+	struct tinit_srv * srv = wait->srv;
+
+	tinit_srv_build_reply(wait->buff, ret);
+	unsk_dgram_buffq_nqueue_busy(&srv->buffq, wait->buff);
+	wait->buff = NULL;
+
+	/* Have reply sent from within the next server dispatch. */
+	upoll_enable_watch(&srv->unsk.work, EPOLLOUT);
+	unsk_async_svc_apply_watch(&srv->unsk, srv->poller);
+}
+
+static void
+tinit_srv_wake_wait(struct svc_waiter * waiter, int ret)
+{
+	struct tinit_srv_wait * wait = containerof(waiter,
+	                                           struct tinit_srv_wait,
+	                                           waiter);
+
+	utimer_cancel(&wait->timer);
+	tinit_srv_complete_wait(wait, ret);
+}
+
+static void
+tinit_srv_expire_wait(struct utimer * timer)
+{
+	struct tinit_srv_wait * wait = containerof(timer,
+	                                           struct tinit_srv_wait,
+	                                           timer);
+
+	svc_unwait(&wait->waiter);
+	tinit_srv_complete_wait(wait, -ETIME);
+}
+
+/*
+ * Park wait requests till service reaches the requested state: the request
+ * buffer is held and replied to from within service state transitions or
+ * timeout expiry.
+ *
+ * Return: -EINPROGRESS when the request has been parked, 0 when a reply is
+ *         ready to be sent.
+ */
+static int
+tinit_srv_request_wait(struct tinit_srv *       srv,
+                       struct unsk_dgram_buff * buff,
+                       const char *             name,
+                       size_t                   len)
+{
+	const struct tinit_wait_msg * msg = (struct tinit_wait_msg *)
+	                                    buff->data;
+	struct svc *                  svc;
+	unsigned int                  w;
+	int                           ret;
+
+	ret = tinit_check_svc_name(name, len);
+	if (ret)
+		goto reply;
+
+	if (msg->state > TINIT_SVC_STOPPING_STAT) {
+		ret = -EINVAL;
+		goto reply;
+	}
+
+	ret = tinit_repo_fetch_byname(tinit_repo_get(), name, &svc);
+	if (ret)
+		goto reply;
+
+	if (svc->state == msg->state) {
+		ret = 0;
+		goto reply;
+	}
+
+	if (!msg->tmout) {
+		ret = -ETIME;
+		goto reply;
+	}
+
+	for (w = 0; w < stroll_array_nr(srv->waits); w++) {
+		struct tinit_srv_wait * wait = &srv->waits[w];
+
+		if (wait->buff)
+			continue;
+
+		wait->buff = buff;
+		svc_wait(svc,
+		         &wait->waiter,
+		         (enum tinit_svc_state)msg->state,
+		         tinit_srv_wake_wait);
+		utimer_arm_msec(&wait->timer, msg->tmout);
+
+		return -EINPROGRESS;
+	}
+
+	ret = -EBUSY;
+
+reply:
+	tinit_srv_build_reply(buff, ret);
+
+	return 0;
+}
+
 /******************************************************************************
  * Server side transport handling
  ******************************************************************************/
@@ -391,9 +685,15 @@ tinit_srv_process_request(struct tinit_srv *       srv,
 		return ret;
 	}
 
+	tinit_metrics_count_request(type);
+
 	switch (type) {
 	case TINIT_STATUS_MSG_TYPE:
-		ret = tinit_srv_request_status(buff, srv->pattern);
+		ret = tinit_srv_request_status(buff, srv->pattern, ret, false);
+		break;
+
+	case TINIT_XSTATUS_MSG_TYPE:
+		ret = tinit_srv_request_status(buff, srv->pattern, ret, true);
 		break;
 
 	case TINIT_START_MSG_TYPE:
@@ -416,6 +716,22 @@ tinit_srv_process_request(struct tinit_srv *       srv,
 		ret = tinit_srv_request_switch(buff, srv->pattern, ret);
 		break;
 
+	case TINIT_RELOAD_REPO_MSG_TYPE:
+		ret = tinit_srv_request_reload_repo(buff);
+		break;
+
+	case TINIT_LOGS_MSG_TYPE:
+		ret = tinit_srv_request_logs(buff, srv->pattern, ret);
+		break;
+
+	case TINIT_EVENTS_MSG_TYPE:
+		ret = tinit_srv_request_events(buff);
+		break;
+
+	case TINIT_WAIT_MSG_TYPE:
+		ret = tinit_srv_request_wait(srv, buff, srv->pattern, ret);
+		break;
+
 	default:
 		assert(0);
 	}
@@ -441,6 +757,9 @@ tinit_srv_handle_requests(struct tinit_srv * srv)
 				unsk_dgram_buffq_nqueue_busy(&srv->buffq, buff);
 				continue;
 			}
+			else if (ret == -EINPROGRESS)
+				/* Request parked, buffer held till reply. */
+				continue;
 		}
 
 		unsk_dgram_buffq_release(&srv->buffq, buff);
@@ -560,8 +879,9 @@ tinit_srv_open(struct tinit_srv *   srv,
 {
 	assert(srv);
 
-	int    err;
-	mode_t msk;
+	int          err;
+	mode_t       msk;
+	unsigned int w;
 
 	srv->pattern = NULL;
 
@@ -601,6 +921,16 @@ tinit_srv_open(struct tinit_srv *   srv,
 		goto free;
 	}
 
+	srv->poller = poller;
+	for (w = 0; w < stroll_array_nr(srv->waits); w++) {
+		struct tinit_srv_wait * wait = &srv->waits[w];
+
+		utimer_init(&wait->timer);
+		utimer_setup(&wait->timer, tinit_srv_expire_wait);
+		wait->srv = srv;
+		wait->buff = NULL;
+	}
+
 	tinit_debug("server: opened.");
 
 	return 0;
@@ -620,7 +950,24 @@ tinit_srv_close(struct tinit_srv *   srv,
 {
 	assert(srv);
 
-	int err;
+	int          err;
+	unsigned int w;
+
+	/* Tell clients still waiting that no reply will ever come. */
+	for (w = 0; w < stroll_array_nr(srv->waits); w++) {
+		struct tinit_srv_wait * wait = &srv->waits[w];
+
+		if (!wait->buff)
+			continue;
+
+		svc_unwait(&wait->waiter);
+		utimer_cancel(&wait->timer);
+
+		tinit_srv_build_reply(wait->buff, -ECANCELED);
+		tinit_srv_send(srv, wait->buff, MSG_DONTWAIT);
+		unsk_dgram_buffq_release(&srv->buffq, wait->buff);
+		wait->buff = NULL;
+	}
 
 	err = unsk_dgram_async_svc_close(&srv->unsk, poller);
 	if (err)
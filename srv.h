@@ -1,13 +1,31 @@
 #ifndef _TINIT_SRV_H
 #define _TINIT_SRV_H
 
-#include "common.h"
+#include "svc.h"
 #include <utils/unsk.h>
+#include <utils/timer.h>
+
+/*
+ * Maximum number of wait requests parked at once. Each of them holds a request
+ * buffer till replied to and must leave room for regular requests.
+ */
+#define TINIT_SRV_WAIT_NR (8U)
+
+struct tinit_srv;
+
+struct tinit_srv_wait {
+	struct svc_waiter        waiter;
+	struct utimer            timer;
+	struct tinit_srv *       srv;
+	struct unsk_dgram_buff * buff;
+};
 
 struct tinit_srv {
 	struct unsk_async_svc unsk;
 	struct unsk_buffq     buffq;
 	char *                pattern;
+	const struct upoll *  poller;
+	struct tinit_srv_wait waits[TINIT_SRV_WAIT_NR];
 };
 
 extern int
@@ -1,18 +1,45 @@
 #include "svc.h"
 #include "conf.h"
 #include "notif.h"
+#include "repo.h"
 #include "mnt.h"
 #include "log.h"
+#include "capture.h"
+#include "evlog.h"
+#include "builtin.h"
+#include "sigchan.h"
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <dirent.h>
+#include <stdio.h>
 #include <errno.h>
+#include <signal.h>
 #include <sysexits.h>
 #include <sys/stat.h>
 #include <sys/mount.h>
 #include <sys/epoll.h>
 
+/* Delay before respawning a failed start command / daemon (seconds). */
+#define SVC_START_TMOUT (1U)
+
+/* Delay before killing a stop command that does not complete (seconds). */
+#define SVC_STOP_TMOUT  (5U)
+
+/*
+ * struct svc_group - Group of start commands running concurrently.
+ *
+ * @nr:     number of members still running
+ * @status: exit status of the first member that failed, 0 if none
+ * @pids:   PIDs of members still running
+ */
+struct svc_group {
+	unsigned int nr;
+	int          status;
+	pid_t        pids[];
+};
+
 static void svc_handle_on_evts(struct svc * svc, enum svc_evt evt, int status);
 
 static void svc_handle_off_evts(struct svc * svc, enum svc_evt evt, int status);
@@ -23,6 +50,14 @@ static void svc_handle_on_notif(struct svc *       svc,
 static void svc_handle_off_notif(struct svc *       svc,
                                  const struct svc * src);
 
+static void svc_sched_release(struct svc * svc);
+
+static void svc_drop_session(struct svc * svc);
+
+static int svc_kill(struct svc * svc, int signo);
+
+static void svc_apply_conf(struct svc * svc);
+
 /*
  * svc_handle_notif() - Handle source service state change notifications.
  *
@@ -42,21 +77,75 @@ svc_handle_notif(struct svc * svc, const struct svc * src)
 	svc->handle_notif(svc, src);
 }
 
+static void
+svc_wake_waiters(struct svc * svc)
+{
+	struct svc_waiter * waiter;
+	struct svc_waiter * tmp;
+
+	stroll_dlist_foreach_entry_safe(&svc->waiters, waiter, node, tmp) {
+		if (waiter->state == svc->state) {
+			stroll_dlist_remove(&waiter->node);
+			waiter->wake(waiter, 0);
+		}
+	}
+}
+
+/* Number of critical services starting, see svc_sched_quiescent(). */
+static unsigned int svc_sched_critical;
+
+/*
+ * Switch service to a new state. All state changes MUST go through here so
+ * that metrics, waiters and scheduler are kept in sync.
+ */
+static void
+svc_set_state(struct svc * svc, enum tinit_svc_state state)
+{
+	assert(svc);
+
+	if (conf_get_prio(svc->conf) == CONF_CRITICAL_PRIO) {
+		if (svc->state == TINIT_SVC_STARTING_STAT) {
+			assert(svc_sched_critical);
+			svc_sched_critical--;
+		}
+		if (state == TINIT_SVC_STARTING_STAT)
+			svc_sched_critical++;
+	}
+
+	svc->state = state;
+	tinit_metrics_change_svc(&svc->metrics, state);
+	svc_wake_waiters(svc);
+}
+
 static void
 svc_mark_stopped(struct svc * svc)
 {
 	const struct notif * obs;
 
 	svc->child = -1;
-	svc->state = TINIT_SVC_STOPPED_STAT;
+	svc->leftover = 0;
+	svc_drop_session(svc);
+	if (utimer_is_armed(&svc->timer))
+		utimer_cancel(&svc->timer);
 
-	tinit_info("%s: service stopped.", conf_get_name(svc->conf));
+	tinit_evlog_record(TINIT_DOWN_EVENT, svc_get_id(svc), 0, 0);
+	tinit_debug("%s: service stopped.", conf_get_name(svc->conf));
+	svc_set_state(svc, TINIT_SVC_STOPPED_STAT);
 
 	notif_foreach(&svc->stopon_obsrv, obs) {
 		assert(notif_get_src(obs) == svc);
 
 		svc_handle_notif(notif_get_sink(obs), svc);
 	}
+
+	if (svc->next_conf || svc->restart)
+		/*
+		 * Configuration has changed while we were running. We may be
+		 * called from within another service notification walk: apply
+		 * it from main loop once signal channel is woken up. See
+		 * svc_settle().
+		 */
+		tinit_sigchan_defer();
 }
 
 static void
@@ -64,9 +153,10 @@ svc_mark_ready(struct svc * svc)
 {
 	const struct notif * obs;
 
-	svc->state = TINIT_SVC_READY_STAT;
-
-	tinit_info("%s: service ready.", conf_get_name(svc->conf));
+	tinit_evlog_record(TINIT_READY_EVENT, svc_get_id(svc), 0, 0);
+	tinit_debug("%s: service ready.", conf_get_name(svc->conf));
+	svc_set_state(svc, TINIT_SVC_READY_STAT);
+	svc_sched_release(svc);
 
 	notif_foreach(&svc->starton_obsrv, obs) {
 		assert(notif_get_src(obs) == svc);
@@ -124,8 +214,54 @@ svc_reopen_stdout(const char * path)
 	return 0;
 }
 
+/*
+ * Hand file descriptors stored on behalf of the service back to the service
+ * process, starting at TINIT_STORE_FD_START.
+ *
+ * Stored descriptors are first duplicated above the target range so that
+ * installing one of them cannot clobber another one not installed yet.
+ * Temporary duplicates carry the close-on-exec flag and are released by
+ * execve(2).
+ */
+static int
+svc_restore_fds(const struct svc * svc)
+{
+	assert(svc);
+	assert(svc->fd_nr <= TINIT_STORE_FD_MAX);
+
+	int          fds[TINIT_STORE_FD_MAX];
+	unsigned int f;
+	int          ret;
+
+	for (f = 0; f < svc->fd_nr; f++) {
+		fds[f] = fcntl(svc->fds[f],
+		               F_DUPFD_CLOEXEC,
+		               TINIT_STORE_FD_START + (int)svc->fd_nr);
+		if (fds[f] < 0) {
+			ret = errno;
+
+			tinit_err("%s: cannot restore stored file descriptor: "
+			          "%s (%d).",
+			          conf_get_name(svc->conf),
+			          strerror(ret),
+			          ret);
+			return -ret;
+		}
+	}
+
+	for (f = 0; f < svc->fd_nr; f++) {
+		ret = sys_dup2(fds[f], TINIT_STORE_FD_START + (int)f);
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
 static void __noreturn
-svc_exec(const struct svc * svc, const char * const * args)
+svc_exec(const struct svc *   svc,
+         const char * const * args,
+         const char * const * env)
 {
 	assert(svc);
 	assert(args);
@@ -133,7 +269,6 @@ svc_exec(const struct svc * svc, const char * const * args)
 
 	int                     ret;
 	const struct conf_svc * conf = svc->conf;
-	char * const *          env;
 
 	/* Create a new session and make ourself the process group leader. */
 	ret = setsid();
@@ -148,16 +283,27 @@ svc_exec(const struct svc * svc, const char * const * args)
 		if (svc_reopen_stdin(conf->stdin))
 			goto exit;
 
-	if (conf->stdout) {
+	if (svc->capture) {
+		ret = sys_dup2(capture_get_sink(svc->capture), STDOUT_FILENO);
+		if (ret < 0)
+			goto exit;
+	}
+	else if (conf->stdout) {
 		if (svc_reopen_stdout(conf->stdout))
 			goto exit;
+	}
 
+	if (svc->capture || conf->stdout) {
 		/* Duplicate stderr onto stdout. */
 		ret = sys_dup2(STDOUT_FILENO, STDERR_FILENO);
 		if (ret < 0)
 			goto exit;
 	}
 
+	if (svc->fd_nr)
+		if (svc_restore_fds(svc))
+			goto exit;
+
 	/*
 	 * No need to worry about signals disposititon since during an
 	 * execve(2), the dispositions of handled signals are reset to the
@@ -177,8 +323,7 @@ svc_exec(const struct svc * svc, const char * const * args)
 	 *          this will properly work while running onto Linux (and a few
 	 *          other UNIX variants) but this is not portable !
 	 */
-	env = (char * const *)conf_get_env(conf);
-	if (execve(args[0], (char * const *)args, env)) {
+	if (execve(args[0], (char * const *)args, (char * const *)env)) {
 		int ret = errno;
 
 		assert(ret != EFAULT);
@@ -194,6 +339,39 @@ exit:
 	_exit(EX_OSERR);
 }
 
+/*
+ * Build the environment of a service owning stored file descriptors, i.e.
+ * the configured environment with the TINIT_STORE_FD_ENV variable appended.
+ */
+static const char **
+svc_make_fds_env(const struct svc * svc, char * var)
+{
+	assert(svc);
+	assert(svc->fd_nr);
+	assert(var);
+
+	const char * const * orig = conf_get_env(svc->conf);
+	unsigned int         nr = 0;
+	const char **        env;
+
+	if (orig)
+		while (orig[nr])
+			nr++;
+
+	env = malloc((nr + 2) * sizeof(env[0]));
+	if (!env)
+		return NULL;
+
+	if (nr)
+		memcpy(env, orig, nr * sizeof(env[0]));
+
+	sprintf(var, TINIT_STORE_FD_ENV "=%u", svc->fd_nr);
+	env[nr] = var;
+	env[nr + 1] = NULL;
+
+	return env;
+}
+
 static pid_t
 svc_spawn(struct svc * svc, const char * const * args, unsigned int tmout)
 {
@@ -201,13 +379,38 @@ svc_spawn(struct svc * svc, const char * const * args, unsigned int tmout)
 	assert(args);
 	assert(args[0]);
 
-	pid_t pid;
+	char                 var[sizeof(TINIT_STORE_FD_ENV "=") + 10];
+	const char **        fds_env = NULL;
+	const char * const * env;
+	pid_t                pid;
+
+	if (svc->fd_nr) {
+		fds_env = svc_make_fds_env(svc, var);
+		if (!fds_env) {
+			tinit_err("%s: %s: cannot spawn: %s (%d).",
+			          conf_get_name(svc->conf),
+			          args[0],
+			          strerror(ENOMEM),
+			          ENOMEM);
+			return -ENOMEM;
+		}
+
+		env = fds_env;
+	}
+	else
+		env = conf_get_env(svc->conf);
+
+	if (conf_get_capture(svc->conf) && !svc->capture)
+		/* Upon failure, service output goes to init standard I/Os. */
+		svc->capture = capture_create(svc, NULL);
 
 	pid = vfork();
 	if (pid < 0) {
 		/* Fork failed. */
 		int err = errno;
 
+		free(fds_env);
+
 		assert(err != ENOSYS);
 
 		tinit_err("%s: %s: cannot spawn: %s (%d).",
@@ -219,6 +422,9 @@ svc_spawn(struct svc * svc, const char * const * args, unsigned int tmout)
 	}
 	else if (pid > 0) {
 		/* Parent: we are blocked till child calls execve() or exits. */
+		free(fds_env);
+
+		tinit_evlog_record(TINIT_SPAWN_EVENT, svc_get_id(svc), pid, 0);
 		tinit_debug("%s: %s[%d]: spawned.",
 		            conf_get_name(svc->conf),
 		            args[0],
@@ -230,7 +436,352 @@ svc_spawn(struct svc * svc, const char * const * args, unsigned int tmout)
 	}
 	else
 		/* Child. */
-		svc_exec(svc, args);
+		svc_exec(svc, args, env);
+}
+
+/*
+ * Run a built-in start / stop sequence command in-process, sparing a fork /
+ * exec / SIGCHLD round trip for trivial commands.
+ */
+static int
+svc_run_builtin(const struct svc * svc, const char * const * args)
+{
+	assert(svc);
+	assert(builtin_is_cmd(args));
+
+	int err;
+
+	err = builtin_run(args);
+	if (err) {
+		tinit_err("%s: %s: built-in failed: %s (%d).",
+		          conf_get_name(svc->conf),
+		          args[0],
+		          strerror(-err),
+		          -err);
+		return err;
+	}
+
+	tinit_debug("%s: %s: built-in done.",
+	            conf_get_name(svc->conf),
+	            args[0]);
+
+	return 0;
+}
+
+/******************************************************************************
+ * Start command spawn scheduling.
+ ******************************************************************************/
+
+/*
+ * Spawning dozens of start commands at once thrashes page cache of slow
+ * storage and makes boot slower. Services are therefore admitted to spawn
+ * start commands by a global scheduler which limits the number of services
+ * running a start command concurrently. Services which cannot be admitted
+ * are queued by priority class, in FIFO order within a class, and admitted
+ * as soon as a running start command exits. Daemons are admitted the same
+ * way but release their slot right after execve() since vfork() returns only
+ * once it has completed.
+ *
+ * Idle class services are held back till system is quiescent, i.e. till no
+ * critical service is starting and load average is low. Starting critical
+ * services are counted as they change state while load average is sampled
+ * every SVC_IDLE_POLL_TMOUT seconds as long as idle services are waiting.
+ *
+ * Stop commands are not scheduled: shutdown must not be delayed.
+ */
+
+#define SVC_IDLE_POLL_TMOUT (1U)
+
+/* Queues ordered from the most to the least important class. */
+static const enum conf_prio     svc_sched_order[] = {
+	CONF_CRITICAL_PRIO,
+	CONF_NORMAL_PRIO,
+	CONF_IDLE_PRIO
+};
+static struct stroll_dlist_node svc_sched_queues[CONF_PRIO_NR];
+static struct utimer            svc_sched_timer;
+static unsigned int             svc_sched_busy;
+static unsigned int             svc_sched_max;
+static bool                     svc_sched_admitting;
+static long                     svc_sched_cpus;
+static bool                     svc_sched_calm;
+
+static void svc_spawn_start_cmd(struct svc * svc);
+
+static void svc_sched_admit(void);
+
+/* Sample load average, see svc_sched_quiescent(). */
+static void
+svc_sched_sample(void)
+{
+	double load;
+
+	if (getloadavg(&load, 1) != 1) {
+		/* No load average: do not hold idle services forever. */
+		svc_sched_calm = true;
+		return;
+	}
+
+	svc_sched_calm = (load * 100.0) <
+	                 (double)(svc_sched_cpus * CONFIG_TINIT_IDLE_LOAD);
+}
+
+static void
+svc_sched_expire(struct utimer * timer __unused)
+{
+	svc_sched_sample();
+	svc_sched_admit();
+
+	if (!utimer_is_armed(&svc_sched_timer))
+		/* No more sampling: do not rely on a stale load average. */
+		svc_sched_calm = false;
+}
+
+static void
+svc_sched_setup(void)
+{
+	unsigned int q;
+
+	if (svc_sched_max)
+		return;
+
+	svc_sched_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (svc_sched_cpus <= 0)
+		svc_sched_cpus = 1;
+
+#if CONFIG_TINIT_SPAWN_MAX > 0
+	svc_sched_max = CONFIG_TINIT_SPAWN_MAX;
+#else
+	svc_sched_max = 2U * (unsigned int)svc_sched_cpus;
+#endif
+
+	for (q = 0; q < CONF_PRIO_NR; q++)
+		stroll_dlist_init(&svc_sched_queues[q]);
+
+	utimer_init(&svc_sched_timer);
+	utimer_setup(&svc_sched_timer, svc_sched_expire);
+}
+
+/*
+ * Idle services wait for the first load average sample, taken once they have
+ * been queued.
+ */
+static bool
+svc_sched_quiescent(void)
+{
+	return !svc_sched_critical && svc_sched_calm;
+}
+
+static void
+svc_sched_enqueue(struct svc * svc)
+{
+	assert(svc);
+	assert(stroll_dlist_empty(&svc->sched));
+
+	enum conf_prio prio = conf_get_prio(svc->conf);
+
+	stroll_dlist_nqueue_back(&svc_sched_queues[prio], &svc->sched);
+	if ((prio == CONF_IDLE_PRIO) && !utimer_is_armed(&svc_sched_timer))
+		utimer_arm_sec(&svc_sched_timer, SVC_IDLE_POLL_TMOUT);
+
+	tinit_debug("%s: spawn queued.", conf_get_name(svc->conf));
+}
+
+static struct svc *
+svc_sched_dequeue(bool quiescent)
+{
+	unsigned int q;
+
+	for (q = 0; q < stroll_array_nr(svc_sched_order); q++) {
+		struct stroll_dlist_node * queue;
+		struct stroll_dlist_node * node;
+
+		queue = &svc_sched_queues[svc_sched_order[q]];
+		if (stroll_dlist_empty(queue))
+			continue;
+
+		if ((svc_sched_order[q] == CONF_IDLE_PRIO) && !quiescent)
+			break;
+
+		node = stroll_dlist_dqueue_front(queue);
+		stroll_dlist_init(node);
+
+		return stroll_dlist_entry(node, struct svc, sched);
+	}
+
+	return NULL;
+}
+
+/* Admit queued services while slots are available. */
+static void
+svc_sched_admit(void)
+{
+	bool quiescent;
+
+	/* Admitted services may release their slot synchronously. */
+	if (svc_sched_admitting)
+		return;
+
+	svc_sched_admitting = true;
+
+	quiescent = svc_sched_quiescent();
+	while (svc_sched_busy < svc_sched_max) {
+		struct svc * next;
+
+		next = svc_sched_dequeue(quiescent);
+		if (!next)
+			break;
+
+		svc_spawn_start_cmd(next);
+	}
+
+	if (!stroll_dlist_empty(&svc_sched_queues[CONF_IDLE_PRIO]) &&
+	    !utimer_is_armed(&svc_sched_timer))
+		utimer_arm_sec(&svc_sched_timer, SVC_IDLE_POLL_TMOUT);
+
+	svc_sched_admitting = false;
+}
+
+/*
+ * Spawn slot is held from first start command till start sequence completes,
+ * fails or is interrupted so that services are not queued again between
+ * sequence commands.
+ */
+static bool
+svc_sched_acquire(struct svc * svc)
+{
+	assert(svc);
+
+	if (svc->sched_held)
+		return true;
+
+	svc_sched_setup();
+
+	if (!stroll_dlist_empty(&svc->sched))
+		/* Already waiting for admission. */
+		return false;
+
+	if ((svc_sched_busy >= svc_sched_max) ||
+	    ((conf_get_prio(svc->conf) == CONF_IDLE_PRIO) &&
+	     !svc_sched_quiescent())) {
+		svc_sched_enqueue(svc);
+		return false;
+	}
+
+	svc_sched_busy++;
+	svc->sched_held = true;
+
+	return true;
+}
+
+static void
+svc_sched_release(struct svc * svc)
+{
+	assert(svc);
+
+	if (!svc->sched_held)
+		return;
+
+	assert(svc_sched_busy);
+	svc_sched_busy--;
+	svc->sched_held = false;
+
+	svc_sched_admit();
+}
+
+/* Withdraw a service from the admission queue if queued. */
+static void
+svc_sched_cancel(struct svc * svc)
+{
+	assert(svc);
+
+	if (!stroll_dlist_empty(&svc->sched))
+		stroll_dlist_remove_init(&svc->sched);
+}
+
+/* Move on to next start sequence step, stepping over current group if any. */
+static void
+svc_step_start_cmd(struct svc * svc)
+{
+	assert(svc);
+
+	svc->start_cmd = conf_get_start_group_end(svc->conf, svc->start_cmd);
+}
+
+/* Retry current start sequence step once timer expires. */
+static void
+svc_retry_start_cmd(struct svc * svc)
+{
+	assert(svc);
+
+	tinit_metrics_restart_svc(&svc->metrics);
+	svc->child = -1;
+	utimer_arm_sec(&svc->timer, SVC_START_TMOUT);
+	svc_sched_release(svc);
+}
+
+/*
+ * Run all commands of the start sequence group beginning at current start
+ * command concurrently, up to the @end command (excluded).
+ *
+ * Return: 0 when group members are running, 1 when group completed
+ * in-process, i.e. consists of built-ins only, a negative errno like value
+ * otherwise.
+ */
+static int
+svc_spawn_start_group(struct svc * svc, unsigned int end)
+{
+	assert(svc);
+	assert(!svc->group);
+	assert(end > (svc->start_cmd + 1));
+
+	struct svc_group * grp;
+	unsigned int       c;
+
+	grp = malloc(sizeof(*grp) +
+	             ((end - svc->start_cmd) * sizeof(grp->pids[0])));
+	if (!grp) {
+		tinit_err("%s: cannot spawn command group: %s (%d).",
+		          conf_get_name(svc->conf),
+		          strerror(ENOMEM),
+		          ENOMEM);
+		return -ENOMEM;
+	}
+
+	grp->nr = 0;
+	grp->status = 0;
+	for (c = svc->start_cmd; c < end; c++) {
+		const char * const * args = conf_get_start_cmd(svc->conf, c);
+		pid_t                pid;
+
+		if (builtin_is_cmd(args)) {
+			if (svc_run_builtin(svc, args))
+				grp->status = EX_OSERR;
+			continue;
+		}
+
+		pid = svc_spawn(svc, args, SVC_START_TMOUT);
+		if (pid < 0) {
+			grp->status = EX_OSERR;
+			continue;
+		}
+
+		grp->pids[grp->nr++] = pid;
+	}
+
+	if (!grp->nr) {
+		int err = grp->status ? -ECHILD : 1;
+
+		free(grp);
+
+		return err;
+	}
+
+	/* Let the barrier collect the status of members still running. */
+	svc->group = grp;
+	svc->child = grp->pids[0];
+
+	return 0;
 }
 
 static void
@@ -239,6 +790,46 @@ svc_spawn_start_cmd(struct svc * svc)
 	const char * const * args;
 	bool                 mark;
 
+	/*
+	 * Run leading built-in commands and command groups of start
+	 * sequence.
+	 */
+	while (svc->start_cmd < conf_get_start_cmd_nr(svc->conf)) {
+		unsigned int end;
+
+		end = conf_get_start_group_end(svc->conf, svc->start_cmd);
+		if (end > (svc->start_cmd + 1)) {
+			int ret;
+
+			if (!svc_sched_acquire(svc))
+				return;
+
+			ret = svc_spawn_start_group(svc, end);
+			if (!ret)
+				return;
+
+			if (ret < 0) {
+				svc_retry_start_cmd(svc);
+				return;
+			}
+
+			svc_step_start_cmd(svc);
+			continue;
+		}
+
+		args = conf_get_start_cmd(svc->conf, svc->start_cmd);
+		if (!builtin_is_cmd(args))
+			break;
+
+		if (svc_run_builtin(svc, args)) {
+			/* Retry once timer expires as for failed commands. */
+			svc_retry_start_cmd(svc);
+			return;
+		}
+
+		svc_step_start_cmd(svc);
+	}
+
 	if (svc->start_cmd < conf_get_start_cmd_nr(svc->conf)) {
 		/* Get next start sequence command. */
 		args = conf_get_start_cmd(svc->conf, svc->start_cmd);
@@ -251,7 +842,13 @@ svc_spawn_start_cmd(struct svc * svc)
 	}
 
 	if (args) {
-		svc->child = svc_spawn(svc, args, 1U);
+		if (!svc_sched_acquire(svc))
+			return;
+
+		svc->child = svc_spawn(svc, args, SVC_START_TMOUT);
+		if (mark || (svc->child < 0))
+			/* Daemon execve() is over or spawn failed. */
+			svc_sched_release(svc);
 		if (svc->child < 0)
 			return;
 	}
@@ -334,14 +931,39 @@ svc_expire_on(struct utimer * timer)
 	}
 }
 
+void
+svc_wait(struct svc *         svc,
+         struct svc_waiter *  waiter,
+         enum tinit_svc_state state,
+         svc_wake_fn *        wake)
+{
+	assert(svc);
+	assert(waiter);
+	assert(state != svc->state);
+	assert(wake);
+
+	waiter->state = state;
+	waiter->wake = wake;
+	stroll_dlist_nqueue_back(&svc->waiters, &waiter->node);
+}
+
 void
 svc_start(struct svc * svc)
 {
-	tinit_info("%s: starting service...", conf_get_name(svc->conf));
+	tinit_evlog_record(TINIT_START_EVENT, svc_get_id(svc), 0, 0);
+	tinit_debug("%s: starting service...", conf_get_name(svc->conf));
+
+	if (svc->leftover) {
+		/* Restarted while stopping: do not leave leftovers behind. */
+		svc_kill(svc, SIGKILL);
+		svc->leftover = 0;
+	}
+	svc_drop_session(svc);
 
 	svc->handle_evts = svc_handle_on_evts;
 	svc->handle_notif = svc_handle_on_notif;
-	svc->state = TINIT_SVC_STARTING_STAT;
+	svc->restart = false;
+	svc_set_state(svc, TINIT_SVC_STARTING_STAT);
 	utimer_setup(&svc->timer, svc_expire_on);
 	svc->start_cmd = 0;
 
@@ -354,19 +976,29 @@ svc_spawn_stop_cmd(struct svc * svc)
 {
 	assert(svc);
 
-	svc->stop_cmd++;
+	const char * const * args;
 
-	if ((unsigned int)svc->stop_cmd >= conf_get_stop_cmd_nr(svc->conf)) {
-		/* Stop sequence is over: switch to stopped state. */
-		svc_mark_stopped(svc);
+	while (true) {
+		svc->stop_cmd++;
 
-		return;
+		if ((unsigned int)svc->stop_cmd >=
+		    conf_get_stop_cmd_nr(svc->conf)) {
+			/* Stop sequence is over: switch to stopped state. */
+			svc_mark_stopped(svc);
+
+			return;
+		}
+
+		args = conf_get_stop_cmd(svc->conf, svc->stop_cmd);
+		if (!builtin_is_cmd(args))
+			break;
+
+		/* Stop sequence goes on whatever the built-in outcome. */
+		svc_run_builtin(svc, args);
 	}
 
-	/* Get stop sequence command and spawn it. */
-	svc->child = svc_spawn(svc,
-	                       conf_get_stop_cmd(svc->conf, svc->stop_cmd),
-	                       5U);
+	/* Spawn stop sequence command. */
+	svc->child = svc_spawn(svc, args, SVC_STOP_TMOUT);
 }
 
 #warning factorize me with svc_may_start()
@@ -480,21 +1112,202 @@ svc_handle_off_notif(struct svc * svc, const struct svc * src)
 		svc_spawn_stop_cmd(svc);
 }
 
+/* Forget about session members collected by svc_scan_session(). */
+static void
+svc_drop_session(struct svc * svc)
+{
+	assert(svc);
+
+	free(svc->sess_pids);
+	svc->sess_pids = NULL;
+	svc->sess_nr = 0;
+}
+
+/* Collect processes belonging to the session which leader is given PID. */
 static int
-svc_kill(const struct svc *svc, int signo)
+svc_scan_session(struct svc * svc, pid_t sid)
 {
 	assert(svc);
+	assert(sid > 0);
+
+	DIR *                 dir;
+	const struct dirent * ent;
+	unsigned int          nr = 0;
+	unsigned int          max = 16;
+	pid_t *               pids;
+	int                   err = 0;
+
+	dir = opendir("/proc");
+	if (!dir)
+		return -errno;
+
+	pids = malloc(max * sizeof(pids[0]));
+	if (!pids) {
+		err = -ENOMEM;
+		goto close;
+	}
+
+	while ((ent = readdir(dir))) {
+		char * end;
+		pid_t  pid;
 
-	if (svc->child <= 0)
-		return -ESRCH;
+		pid = (pid_t)strtol(ent->d_name, &end, 10);
+		if ((pid <= 1) || *end || (getsid(pid) != sid))
+			continue;
 
-	if (kill(svc->child, signo)) {
-		assert(errno == ESRCH);
+		if (nr == max) {
+			pid_t * tmp;
 
-		return -ESRCH;
+			tmp = reallocarray(pids, 2 * max, sizeof(pids[0]));
+			if (!tmp) {
+				free(pids);
+				err = -ENOMEM;
+				goto close;
+			}
+
+			pids = tmp;
+			max *= 2;
+		}
+
+		pids[nr++] = pid;
 	}
 
-	return 0;
+	svc_drop_session(svc);
+	svc->sess_id = sid;
+	svc->sess_nr = nr;
+	svc->sess_pids = pids;
+
+close:
+	closedir(dir);
+
+	return err;
+}
+
+/*
+ * Signal all processes belonging to the session which leader is given PID,
+ * including the ones that switched to another process group.
+ *
+ * As scanning procfs is costly, session members are collected once per stop
+ * and signaled directly by following escalation steps. The final SIGKILL
+ * scans again to catch processes forked in between.
+ */
+static int
+svc_kill_session(struct svc * svc, pid_t sid, int signo)
+{
+	assert(svc);
+	assert(sid > 0);
+
+	unsigned int p = 0;
+	int          ret = -ESRCH;
+
+	if (!svc->sess_pids || (svc->sess_id != sid) || (signo == SIGKILL)) {
+		if (svc_scan_session(svc, sid))
+			/* Fallback to session leader process group. */
+			return kill(-sid, signo) ? -ESRCH : 0;
+	}
+
+	while (p < svc->sess_nr) {
+		pid_t pid = svc->sess_pids[p];
+
+		if (getsid(pid) != sid) {
+			/* Exited, and PID possibly reused since. */
+			svc->sess_pids[p] = svc->sess_pids[--svc->sess_nr];
+			continue;
+		}
+
+		if (!kill(pid, signo))
+			ret = 0;
+		p++;
+	}
+
+	return ret;
+}
+
+/* Signal a service process and its relatives according to kill mode. */
+static int
+svc_kill_pid(struct svc * svc, pid_t pid, int signo)
+{
+	assert(svc);
+	assert(pid > 0);
+
+	int ret;
+
+	switch (conf_get_kill_mode(svc->conf)) {
+	case CONF_PROCESS_KILL:
+		ret = kill(pid, signo) ? -ESRCH : 0;
+		break;
+
+	case CONF_GROUP_KILL:
+		/* svc_exec() made process a process group leader. */
+		ret = kill(-pid, signo) ? -ESRCH : 0;
+		break;
+
+	case CONF_SESSION_KILL:
+		ret = svc_kill_session(svc, pid, signo);
+		break;
+
+	default:
+		assert(0);
+	}
+
+	if (!ret && signo)
+		tinit_evlog_record(TINIT_SIGNAL_EVENT,
+		                   svc_get_id(svc),
+		                   pid,
+		                   signo);
+
+	return ret;
+}
+
+static int
+svc_kill(struct svc *svc, int signo)
+{
+	assert(svc);
+
+	if (svc->group) {
+		const struct svc_group * grp = svc->group;
+		unsigned int             m;
+		int                      ret = -ESRCH;
+
+		for (m = 0; m < grp->nr; m++) {
+			if (!svc_kill_pid(svc, grp->pids[m], signo))
+				ret = 0;
+		}
+
+		return ret;
+	}
+
+	if (svc->child > 0)
+		return svc_kill_pid(svc, svc->child, signo);
+
+	if (svc->leftover > 0)
+		/* Processes left behind by an exited service process. */
+		return svc_kill_pid(svc, svc->leftover, signo);
+
+	return -ESRCH;
+}
+
+/*
+ * Send signal of current stop escalation step and wait for step delay.
+ *
+ * Return: 0 if a process was signaled, -ESRCH otherwise.
+ */
+static int
+svc_escalate_stop(struct svc * svc)
+{
+	assert(svc);
+	assert(svc->state == TINIT_SVC_STOPPING_STAT);
+
+	const struct conf_kill_step * step;
+	int                           ret;
+
+	step = conf_get_kill_step(svc->conf, svc->kill_step);
+
+	ret = svc_kill(svc, step->signo);
+	if (!ret)
+		utimer_arm_sec(&svc->timer, step->delay);
+
+	return ret;
 }
 
 static void
@@ -507,40 +1320,68 @@ svc_expire_off(struct utimer * timer)
 		break;
 
 	case TINIT_SVC_STOPPING_STAT:
+		if ((svc->stop_cmd < 0) &&
+		    (++svc->kill_step < conf_get_kill_nr(svc->conf))) {
+			/* Escalate to next stop signal. */
+			if (svc_escalate_stop(svc)) {
+				svc->leftover = 0;
+				svc_spawn_stop_cmd(svc);
+			}
+			break;
+		}
+
 		/* Child still seems to exist. Kill it roughly ! */
-		if (svc_kill(svc, SIGKILL))
-			/* Process to kill not found: keep going. */
+		if (svc_kill(svc, SIGKILL) || svc->leftover) {
+			/*
+			 * Process to kill not found, or SIGKILLed leftovers
+			 * which are not waited for: keep going.
+			 */
+			svc->leftover = 0;
 			svc_spawn_stop_cmd(svc);
+		}
 		break;
 
 	default:
 		assert(0);
 	}
 }
-
-void
-svc_stop(struct svc * svc)
+
+static void
+svc_do_stop(struct svc * svc)
 {
-	tinit_info("%s: stopping service...", conf_get_name(svc->conf));
+	tinit_evlog_record(TINIT_STOP_EVENT, svc_get_id(svc), 0, 0);
+	tinit_debug("%s: stopping service...", conf_get_name(svc->conf));
 
 	svc->handle_evts = svc_handle_off_evts;
 	svc->handle_notif = svc_handle_off_notif;
-	svc->state = TINIT_SVC_STOPPING_STAT;
+	svc_set_state(svc, TINIT_SVC_STOPPING_STAT);
 	utimer_setup(&svc->timer, svc_expire_off);
 	svc->stop_cmd = -1;
+	svc->kill_step = 0;
+	svc->leftover = 0;
+	svc_drop_session(svc);
+	svc_sched_cancel(svc);
+	svc_sched_release(svc);
 
 	if (!svc_may_stop(svc))
 		return;
 
 	/* Kill current service daemon / process if any. */
-	if (!svc_kill(svc, conf_get_stop_sig(svc->conf))) {
-		utimer_arm_sec(&svc->timer, 5U);
+	if (!svc_escalate_stop(svc))
 		return;
-	}
 
 	svc_spawn_stop_cmd(svc);
 }
 
+void
+svc_stop(struct svc * svc)
+{
+	/* Cancel any restart pending on configuration change. */
+	svc->restart = false;
+
+	svc_do_stop(svc);
+}
+
 void
 svc_reload(const struct svc * svc)
 {
@@ -550,7 +1391,12 @@ svc_reload(const struct svc * svc)
 
 	tinit_info("%s: reloading service...", conf_get_name(svc->conf));
 
-	svc_kill(svc, conf_get_reload_sig(svc->conf));
+	/* Reload requests are meant for main process only. */
+	if (!kill(svc->child, conf_get_reload_sig(svc->conf)))
+		tinit_evlog_record(TINIT_SIGNAL_EVENT,
+		                   svc_get_id(svc),
+		                   svc->child,
+		                   conf_get_reload_sig(svc->conf));
 }
 
 static void
@@ -563,22 +1409,25 @@ svc_handle_on_evts(struct svc * svc, enum svc_evt evt, int status)
 			break;
 
 		case SVC_STOP_EVT:
-			svc_stop(svc);
+			svc_do_stop(svc);
 			break;
 
 		case SVC_EXIT_EVT:
 			if (!status) {
-				svc->start_cmd++;
+				svc_step_start_cmd(svc);
 				svc_respawn(svc);
 				break;
 			}
 
+			tinit_metrics_restart_svc(&svc->metrics);
 			if (!utimer_is_armed(&svc->timer)) {
 				svc_respawn(svc);
 				break;
 			}
 
+			/* Do not hold spawn slot till retry delay expires. */
 			svc->child = -1;
+			svc_sched_release(svc);
 			break;
 
 		default:
@@ -592,16 +1441,18 @@ svc_handle_on_evts(struct svc * svc, enum svc_evt evt, int status)
 			break;
 
 		case SVC_STOP_EVT:
-			svc_stop(svc);
+			svc_do_stop(svc);
 			break;
 
 		case SVC_EXIT_EVT:
+			tinit_metrics_restart_svc(&svc->metrics);
+			svc_set_state(svc, TINIT_SVC_STARTING_STAT);
 			if (!utimer_is_armed(&svc->timer)) {
-				svc->state = TINIT_SVC_STARTING_STAT;
 				svc_respawn(svc);
 				break;
 			}
 
+			/* Respawned once timer expires. See svc_expire_on(). */
 			svc->child = -1;
 			break;
 
@@ -615,6 +1466,129 @@ svc_handle_on_evts(struct svc * svc, enum svc_evt evt, int status)
 	}
 }
 
+/*
+ * Run processes left behind by an exited process of a stopping service through
+ * the stop escalation chain. Once orphaned, they are reaped by init as unknown
+ * processes: stop sequence goes on as soon as they are all found gone by
+ * svc_reap_leftover(), at step expiry or once SIGKILLed otherwise. See
+ * svc_expire_off().
+ */
+static void
+svc_kill_leftover(struct svc * svc, pid_t pid)
+{
+	assert(svc);
+	assert(svc->state == TINIT_SVC_STOPPING_STAT);
+	assert(pid > 0);
+
+	svc->child = -1;
+	svc->leftover = pid;
+
+	if (utimer_is_armed(&svc->timer))
+		/* Escalation step or stop command timeout pending. */
+		return;
+
+	if ((svc->stop_cmd < 0) &&
+	    (svc->kill_step < conf_get_kill_nr(svc->conf))) {
+		if (!svc_escalate_stop(svc))
+			return;
+
+		/* Already gone: do not signal them again. */
+	}
+	else
+		/* Escalation is over: kill leftovers roughly and keep going. */
+		svc_kill(svc, SIGKILL);
+
+	svc->leftover = 0;
+	svc_spawn_stop_cmd(svc);
+}
+
+void
+svc_reap_leftover(struct svc * svc)
+{
+	assert(svc);
+
+	if ((svc->state != TINIT_SVC_STOPPING_STAT) || !svc->leftover)
+		return;
+
+	/* Scan session again to catch members forked in between. */
+	svc_drop_session(svc);
+	if (!svc_kill_pid(svc, svc->leftover, 0))
+		/* Some are still running. */
+		return;
+
+	/*
+	 * All gone: forget about them for good since their process group or
+	 * session ID may be reused from now on.
+	 */
+	svc->leftover = 0;
+	if (utimer_is_armed(&svc->timer))
+		utimer_cancel(&svc->timer);
+
+	svc_spawn_stop_cmd(svc);
+}
+
+/*
+ * Account for a group member termination.
+ *
+ * Return: true once all group members have terminated, in which case @status
+ * is updated with the status of the whole group.
+ */
+static bool
+svc_reap_group(struct svc * svc, pid_t pid, int * status)
+{
+	assert(svc);
+	assert(svc->group);
+	assert(svc->group->nr);
+	assert(status);
+
+	struct svc_group * grp = svc->group;
+	unsigned int       m;
+
+	for (m = 0; m < grp->nr; m++) {
+		if (grp->pids[m] == pid)
+			break;
+	}
+
+	assert(m < grp->nr);
+	grp->pids[m] = grp->pids[--grp->nr];
+
+	if (*status && !grp->status)
+		grp->status = *status;
+
+	if (grp->nr) {
+		/* Keep child pointing to a running member. */
+		svc->child = grp->pids[0];
+		return false;
+	}
+
+	*status = grp->status;
+	svc->group = NULL;
+	free(grp);
+
+	return true;
+}
+
+void
+svc_handle_exit(struct svc * svc, pid_t pid, int status)
+{
+	assert(svc);
+	assert(pid > 0);
+
+	if (svc->group && !svc_reap_group(svc, pid, &status))
+		/* Group barrier not reached yet. */
+		return;
+
+	if ((svc->state == TINIT_SVC_STOPPING_STAT) &&
+	    (conf_get_kill_mode(svc->conf) != CONF_PROCESS_KILL) &&
+	    !svc_kill_pid(svc, pid, 0)) {
+		/* Do not leave processes of a stopping service behind. */
+		svc_kill_leftover(svc, pid);
+		return;
+	}
+
+	svc_handle_evts(svc, SVC_EXIT_EVT, status);
+}
+
 static void
 svc_handle_on_notif(struct svc * svc, const struct svc * src)
 {
@@ -645,6 +1619,261 @@ svc_handle_on_notif(struct svc * svc, const struct svc * src)
 		svc_spawn_start_cmd(svc);
 }
 
+unsigned int
+svc_store_fds(struct svc * svc, const int * fds, unsigned int nr)
+{
+	assert(svc);
+	assert(svc->fd_nr <= TINIT_STORE_FD_MAX);
+	assert(fds);
+	assert(nr);
+
+	unsigned int cnt;
+
+	cnt = stroll_min(nr, TINIT_STORE_FD_MAX - svc->fd_nr);
+	memcpy(&svc->fds[svc->fd_nr], fds, cnt * sizeof(fds[0]));
+	svc->fd_nr += cnt;
+
+	tinit_debug("%s: %u file descriptor(s) stored.",
+	            conf_get_name(svc->conf),
+	            cnt);
+
+	return cnt;
+}
+
+void
+svc_flush_fds(struct svc * svc)
+{
+	assert(svc);
+	assert(svc->fd_nr <= TINIT_STORE_FD_MAX);
+
+	unsigned int f;
+
+	for (f = 0; f < svc->fd_nr; f++)
+		close(svc->fds[f]);
+
+	svc->fd_nr = 0;
+}
+
+const pid_t *
+svc_save(const struct svc * svc, struct svc_snap * snap)
+{
+	assert(svc);
+	assert(svc->fd_nr <= TINIT_STORE_FD_MAX);
+	assert(snap);
+
+	unsigned int f;
+
+	snap->child = svc->child;
+	snap->state = svc->state;
+	snap->armed = utimer_is_armed(&svc->timer);
+	snap->restart = svc->restart;
+	snap->start_cmd = svc->start_cmd;
+	snap->stop_cmd = svc->stop_cmd;
+	snap->kill_step = svc->kill_step;
+	snap->leftover = svc->leftover;
+	snap->sess_id = svc->sess_id;
+	snap->sess = !!svc->sess_pids;
+	snap->fd_nr = svc->fd_nr;
+
+	/* Stored file descriptors must survive execve(). */
+	for (f = 0; f < svc->fd_nr; f++) {
+		snap->fds[f] = svc->fds[f];
+		fcntl(svc->fds[f], F_SETFD, 0);
+	}
+
+	/* So does the capture pipe. Captured output is lost however. */
+	if (svc->capture) {
+		for (f = 0; f < stroll_array_nr(snap->capture); f++) {
+			snap->capture[f] = svc->capture->fds[f];
+			fcntl(snap->capture[f], F_SETFD, 0);
+		}
+	}
+	else {
+		snap->capture[0] = -1;
+		snap->capture[1] = -1;
+	}
+
+	if (svc->group) {
+		snap->grp_nr = svc->group->nr;
+		snap->grp_status = svc->group->status;
+
+		return svc->group->pids;
+	}
+
+	snap->grp_nr = 0;
+	snap->grp_status = 0;
+
+	return NULL;
+}
+
+int
+svc_restore(struct svc *          svc,
+            const struct svc_snap * snap,
+            const pid_t *           pids)
+{
+	assert(svc);
+	assert(svc->state == TINIT_SVC_STOPPED_STAT);
+	assert(!svc->group);
+	assert(!svc->fd_nr);
+	assert(snap);
+	assert(!snap->grp_nr || pids);
+
+	unsigned int       f;
+	unsigned int       tmout;
+	struct svc_group * grp = NULL;
+
+	/* Configuration file might have changed in between. */
+	if ((snap->start_cmd > conf_get_start_cmd_nr(svc->conf)) ||
+	    (snap->grp_nr > conf_get_start_cmd_nr(svc->conf)) ||
+	    (snap->stop_cmd < -1) ||
+	    ((snap->stop_cmd >= 0) &&
+	     ((unsigned int)snap->stop_cmd >=
+	      conf_get_stop_cmd_nr(svc->conf))) ||
+	    (snap->kill_step > conf_get_kill_nr(svc->conf)) ||
+	    (snap->leftover < 0) ||
+	    (snap->fd_nr > TINIT_STORE_FD_MAX))
+		return -EINVAL;
+
+	switch (snap->state) {
+	case TINIT_SVC_STOPPED_STAT:
+		tmout = 0;
+		break;
+
+	case TINIT_SVC_STARTING_STAT:
+	case TINIT_SVC_READY_STAT:
+		svc->handle_evts = svc_handle_on_evts;
+		svc->handle_notif = svc_handle_on_notif;
+		utimer_setup(&svc->timer, svc_expire_on);
+		tmout = SVC_START_TMOUT;
+		break;
+
+	case TINIT_SVC_STOPPING_STAT:
+		svc->handle_evts = svc_handle_off_evts;
+		svc->handle_notif = svc_handle_off_notif;
+		utimer_setup(&svc->timer, svc_expire_off);
+		if ((snap->stop_cmd < 0) &&
+		    (snap->kill_step < conf_get_kill_nr(svc->conf)))
+			/* Stop escalation step pending. */
+			tmout = conf_get_kill_step(svc->conf,
+			                           snap->kill_step)->delay;
+		else
+			tmout = SVC_STOP_TMOUT;
+		break;
+
+	default:
+		return -EINVAL;
+	}
+
+	if (snap->leftover && (snap->state != TINIT_SVC_STOPPING_STAT))
+		return -EINVAL;
+
+	if (snap->grp_nr) {
+		size_t sz = snap->grp_nr * sizeof(grp->pids[0]);
+
+		if (snap->state != TINIT_SVC_STARTING_STAT)
+			return -EINVAL;
+
+		grp = malloc(sizeof(*grp) + sz);
+		if (!grp)
+			return -ENOMEM;
+
+		grp->nr = snap->grp_nr;
+		grp->status = snap->grp_status;
+		memcpy(grp->pids, pids, sz);
+	}
+
+	svc_set_state(svc, snap->state);
+	svc->child = grp ? grp->pids[0] : snap->child;
+	svc->group = grp;
+	svc->start_cmd = snap->start_cmd;
+	svc->stop_cmd = snap->stop_cmd;
+	svc->kill_step = snap->kill_step;
+	svc->leftover = snap->leftover;
+	svc->restart = (snap->state == TINIT_SVC_STOPPING_STAT) &&
+	               snap->restart;
+
+	/*
+	 * Collect session members again so that following escalation steps
+	 * still reach the ones that switched to another process group.
+	 */
+	if (snap->sess && (snap->sess_id > 0))
+		svc_scan_session(svc, snap->sess_id);
+
+	/* Remaining delay is unknown: restart a full period. */
+	if (snap->armed && tmout)
+		utimer_arm_sec(&svc->timer, tmout);
+
+	for (f = 0; f < snap->fd_nr; f++) {
+		svc->fds[f] = snap->fds[f];
+		fcntl(svc->fds[f], F_SETFD, FD_CLOEXEC);
+	}
+	svc->fd_nr = snap->fd_nr;
+
+	if ((snap->capture[0] >= 0) && (snap->capture[1] >= 0)) {
+		fcntl(snap->capture[0], F_SETFD, FD_CLOEXEC);
+		fcntl(snap->capture[1], F_SETFD, FD_CLOEXEC);
+
+		if (conf_get_capture(svc->conf))
+			svc->capture = capture_create(svc, snap->capture);
+		else {
+			/* Capture disabled in between: drop the pipe. */
+			close(snap->capture[0]);
+			close(snap->capture[1]);
+		}
+	}
+
+	tinit_debug("%s: service state restored.", conf_get_name(svc->conf));
+
+	return 0;
+}
+
+void
+svc_kick(struct svc * svc)
+{
+	assert(svc);
+
+	/* Only consider services waiting for their first start command. */
+	if ((svc->state != TINIT_SVC_STARTING_STAT) ||
+	    (svc->child > 0) ||
+	    svc->start_cmd ||
+	    utimer_is_armed(&svc->timer))
+		return;
+
+	if (svc_may_start(svc))
+		svc_spawn_start_cmd(svc);
+}
+
+void
+svc_reconf(struct svc * svc, const struct conf_svc * conf)
+{
+	assert(svc);
+	assert(conf);
+
+	/* Drop configuration still pending from a previous change if any. */
+	if (svc->next_conf)
+		conf_destroy((struct conf_svc *)svc->next_conf);
+	svc->next_conf = conf;
+
+	switch (svc->state) {
+	case TINIT_SVC_STOPPED_STAT:
+		svc_apply_conf(svc);
+		break;
+
+	case TINIT_SVC_STOPPING_STAT:
+		/* Will be applied once stopped. See svc_settle(). */
+		break;
+
+	case TINIT_SVC_STARTING_STAT:
+	case TINIT_SVC_READY_STAT:
+		svc->restart = true;
+		svc_do_stop(svc);
+		break;
+
+	default:
+		assert(0);
+	}
+}
+
 bool
 svc_is_on(const struct svc * svc)
 {
@@ -803,9 +2032,22 @@ svc_init(struct svc * svc, const struct conf_svc * conf)
 	svc->handle_evts = svc_handle_off_evts;
 	svc->handle_notif = svc_handle_off_notif;
 	svc->child = -1;
+	svc->leftover = 0;
+	svc->sess_nr = 0;
+	svc->sess_pids = NULL;
 	svc->state = TINIT_SVC_STOPPED_STAT;
 	utimer_init(&svc->timer);
 	svc->conf = conf;
+	svc->next_conf = NULL;
+	svc->restart = false;
+	svc->gone = false;
+	svc->fd_nr = 0;
+	svc->capture = NULL;
+	svc->group = NULL;
+	stroll_dlist_init(&svc->sched);
+	svc->sched_held = false;
+	stroll_dlist_init(&svc->waiters);
+	tinit_metrics_init_svc(&svc->metrics);
 
 	return 0;
 
@@ -816,6 +2058,119 @@ fini:
 	return err;
 }
 
+/*
+ * Services are allocated from chunks of contiguous slots rather than one by
+ * one so that scanning all of them is a sequential memory pass. Chunks are
+ * never released nor moved, service addresses are stable.
+ * A service slot index fits into 16 bits. Slots are reused once services are
+ * destroyed: each slot carries a generation counter bumped at release time so
+ * that identifiers exposed to clients are not ambiguous. See svc_get_id().
+ */
+#define SVC_CHUNK_MAX ((UINT16_MAX + 1U) / SVC_CHUNK_NR)
+
+struct svc_chunk {
+	uint64_t   used;
+	uint16_t   gens[SVC_CHUNK_NR];
+	struct svc slots[SVC_CHUNK_NR];
+};
+
+static struct svc_chunk ** svc_chunks;
+static unsigned int        svc_chunk_nr;
+
+static struct svc *
+svc_alloc(void)
+{
+	unsigned int        c;
+	struct svc_chunk ** chunks;
+	struct svc_chunk *  chunk;
+	unsigned int        s;
+
+	for (c = 0; c < svc_chunk_nr; c++) {
+		chunk = svc_chunks[c];
+		if (~chunk->used)
+			goto alloc;
+	}
+
+	if (svc_chunk_nr == SVC_CHUNK_MAX) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	/* Allocate chunk first so that nothing is left to undo on failure. */
+	chunk = malloc(sizeof(*chunk));
+	if (!chunk)
+		return NULL;
+
+	chunks = realloc(svc_chunks, (svc_chunk_nr + 1) * sizeof(chunks[0]));
+	if (!chunks) {
+		free(chunk);
+		return NULL;
+	}
+	svc_chunks = chunks;
+
+	chunk->used = 0;
+	memset(chunk->gens, 0, sizeof(chunk->gens));
+	svc_chunks[svc_chunk_nr++] = chunk;
+
+alloc:
+	s = (unsigned int)__builtin_ctzll(~chunk->used);
+	chunk->used |= 1ULL << s;
+	chunk->slots[s].id = (c * SVC_CHUNK_NR) + s;
+	chunk->slots[s].gen = chunk->gens[s];
+
+	return &chunk->slots[s];
+}
+
+static void
+svc_free(struct svc * svc)
+{
+	assert(svc);
+	assert((svc->id / SVC_CHUNK_NR) < svc_chunk_nr);
+
+	struct svc_chunk * chunk = svc_chunks[svc->id / SVC_CHUNK_NR];
+
+	assert(svc == &chunk->slots[svc->id % SVC_CHUNK_NR]);
+	assert(chunk->used & (1ULL << (svc->id % SVC_CHUNK_NR)));
+
+	chunk->used &= ~(1ULL << (svc->id % SVC_CHUNK_NR));
+	chunk->gens[svc->id % SVC_CHUNK_NR]++;
+}
+
+struct svc *
+svc_search_bypid(pid_t pid)
+{
+	assert(pid > 0);
+
+	unsigned int c;
+
+	for (c = 0; c < svc_chunk_nr; c++) {
+		struct svc_chunk * chunk = svc_chunks[c];
+		uint64_t           used = chunk->used;
+
+		while (used) {
+			unsigned int s = (unsigned int)__builtin_ctzll(used);
+
+			const struct svc_group * grp = chunk->slots[s].group;
+
+			if (chunk->slots[s].child == pid)
+				return &chunk->slots[s];
+
+			if (grp) {
+				unsigned int m;
+
+				for (m = 0; m < grp->nr; m++) {
+					if (grp->pids[m] == pid)
+						return &chunk->slots[s];
+				}
+			}
+
+			used &= used - 1;
+		}
+	}
+
+	return NULL;
+}
+
 struct svc *
 svc_create(const struct conf_svc * conf)
 {
@@ -823,7 +2178,7 @@ svc_create(const struct conf_svc * conf)
 
 	struct svc * svc;
 
-	svc = malloc(sizeof(*svc));
+	svc = svc_alloc();
 	if (!svc)
 		return NULL;
 
@@ -851,6 +2206,72 @@ svc_unregister_notif_obsrv(struct stroll_dlist_node * obsrv,
 	svc_fini_notif_obsrv(notif);
 }
 
+static void
+svc_apply_conf(struct svc * svc)
+{
+	assert(svc);
+	assert(svc->state == TINIT_SVC_STOPPED_STAT);
+	assert(svc->next_conf);
+
+	const struct conf_svc * conf = svc->next_conf;
+	int                     err;
+
+	svc_unregister_notif_obsrv(&svc->starton_obsrv, svc->starton_notif);
+	svc_unregister_notif_obsrv(&svc->stopon_obsrv, svc->stopon_notif);
+	svc->starton_notif = NULL;
+	svc->stopon_notif = NULL;
+
+	if (svc->capture && !conf_get_capture(conf)) {
+		capture_destroy(svc->capture);
+		svc->capture = NULL;
+	}
+
+	conf_destroy((struct conf_svc *)svc->conf);
+	svc->conf = conf;
+	svc->next_conf = NULL;
+	svc->restart = false;
+
+	err = svc_init_notif_obsrv(svc,
+	                           &svc->starton_notif,
+	                           &svc->starton_obsrv,
+	                           conf_get_starton(conf));
+	if (!err)
+		err = svc_init_notif_obsrv(svc,
+		                           &svc->stopon_notif,
+		                           &svc->stopon_obsrv,
+		                           conf_get_stopon(conf));
+	if (err)
+		tinit_err("%s: cannot setup notifications: %s (%d).",
+		          conf_get_name(conf),
+		          strerror(-err),
+		          -err);
+
+	tinit_info("%s: service reconfigured.", conf_get_name(conf));
+
+	/* Service name may have changed. */
+	tinit_repo_invalidate(tinit_repo_get());
+}
+
+bool
+svc_settle(struct svc * svc)
+{
+	assert(svc);
+
+	bool restart;
+
+	if ((svc->state != TINIT_SVC_STOPPED_STAT) ||
+	    !(svc->next_conf || svc->restart))
+		return false;
+
+	restart = svc->restart;
+	if (svc->next_conf)
+		svc_apply_conf(svc);
+	if (restart)
+		svc_start(svc);
+
+	return true;
+}
+
 static void
 svc_fini(struct svc * svc)
 {
@@ -860,6 +2281,38 @@ svc_fini(struct svc * svc)
 	svc_unregister_notif_obsrv(&svc->starton_obsrv, svc->starton_notif);
 	svc_unregister_notif_obsrv(&svc->stopon_obsrv, svc->stopon_notif);
 
+	/* Release waiters: state they wait for will never be reached. */
+	while (!stroll_dlist_empty(&svc->waiters)) {
+		struct svc_waiter * waiter;
+
+		waiter = stroll_dlist_entry(stroll_dlist_next(&svc->waiters),
+		                            struct svc_waiter,
+		                            node);
+		stroll_dlist_remove(&waiter->node);
+		waiter->wake(waiter, -ENOENT);
+	}
+
+	if (utimer_is_armed(&svc->timer))
+		utimer_cancel(&svc->timer);
+
+	svc_flush_fds(svc);
+
+	free(svc->group);
+	svc_drop_session(svc);
+
+	svc_sched_cancel(svc);
+	svc_sched_release(svc);
+	if ((conf_get_prio(svc->conf) == CONF_CRITICAL_PRIO) &&
+	    (svc->state == TINIT_SVC_STARTING_STAT)) {
+		assert(svc_sched_critical);
+		svc_sched_critical--;
+	}
+
+	if (svc->capture)
+		capture_destroy(svc->capture);
+
+	if (svc->next_conf)
+		conf_destroy((struct conf_svc *)svc->next_conf);
 	conf_destroy((struct conf_svc *)svc->conf);
 }
 
@@ -870,5 +2323,5 @@ svc_destroy(struct svc * svc)
 
 	svc_fini(svc);
 
-	free(svc);
+	svc_free(svc);
 }
@@ -1,6 +1,7 @@
 #ifndef _TINIT_SVC_H
 #define _TINIT_SVC_H
 
+#include "metrics.h"
 #include <tinit/tinit.h>
 #include <utils/timer.h>
 #include <unistd.h>
@@ -9,6 +10,8 @@
 struct svc;
 struct conf_svc;
 struct notif_poll;
+struct capture;
+struct svc_group;
 
 enum svc_evt {
 	SVC_START_EVT,
@@ -23,20 +26,97 @@ typedef void (svc_handle_evts_fn)(struct svc * svc,
 typedef void (svc_handle_notif_fn)(struct svc *       svc,
                                    const struct svc * src);
 
+struct svc_waiter;
+
+/*
+ * svc_wake_fn - Service state waiter wake up callback.
+ *
+ * @waiter: the waiter to wake up
+ * @ret:    0 when service reached the state waited for, -ENOENT when service
+ *          is being destroyed
+ *
+ * @waiter has been removed from service waiters once called.
+ */
+typedef void (svc_wake_fn)(struct svc_waiter * waiter, int ret);
+
+struct svc_waiter {
+	struct stroll_dlist_node node;
+	enum tinit_svc_state     state;
+	svc_wake_fn *            wake;
+};
+
+/* Number of service slots per storage chunk. */
+#define SVC_CHUNK_NR (64U)
+
+/*
+ * struct svc - Service descriptor.
+ *
+ * Fields accessed by repository walks and process reaping come first so that
+ * they share the same cache line. Remaining fields are only touched upon
+ * service state transitions.
+ */
 struct svc {
 	struct stroll_dlist_node repo;
-	svc_handle_evts_fn *     handle_evts;
 	pid_t                    child;
 	enum tinit_svc_state     state;
+	struct svc_group *       group;
+	const struct conf_svc *  conf;
+	unsigned int             id;
+	uint16_t                 gen;
+	bool                     restart;
+	bool                     gone;
+	svc_handle_evts_fn *     handle_evts;
 	svc_handle_notif_fn *    handle_notif;
 	struct utimer            timer;
 	unsigned int             start_cmd;
+	int                      stop_cmd;
+	unsigned int             kill_step;
+	pid_t                    leftover;
+	pid_t                    sess_id;
+	unsigned int             sess_nr;
+	pid_t *                  sess_pids;
 	struct stroll_dlist_node starton_obsrv;
 	struct notif_poll *      starton_notif;
-	int                      stop_cmd;
 	struct stroll_dlist_node stopon_obsrv;
 	struct notif_poll *      stopon_notif;
-	const struct conf_svc *  conf;
+	struct stroll_dlist_node waiters;
+	const struct conf_svc *  next_conf;
+	unsigned int             fd_nr;
+	int                      fds[TINIT_STORE_FD_MAX];
+	struct capture *         capture;
+	struct stroll_dlist_node sched;
+	bool                     sched_held;
+	unsigned int             stop_wave;
+	struct tinit_svc_metrics metrics;
+};
+
+/*
+ * struct svc_snap - Service runtime state saved across init re-execution.
+ *
+ * @grp_nr:     number of running start command group members, 0 if none
+ * @grp_status: exit status of the first group member that failed
+ * @kill_step:  current stop escalation step
+ * @leftover:   process (group / session) left behind by an exited process of a
+ *              stopping service, 0 if none
+ * @sess_id:    session which members were collected for signaling
+ * @sess:       whether session members were collected
+ */
+struct svc_snap {
+	pid_t    child;
+	int32_t  stop_cmd;
+	uint32_t start_cmd;
+	uint8_t  state;
+	uint8_t  armed;
+	uint8_t  restart;
+	uint8_t  fd_nr;
+	int      fds[TINIT_STORE_FD_MAX];
+	int32_t  capture[2];
+	uint32_t grp_nr;
+	int32_t  grp_status;
+	uint32_t kill_step;
+	pid_t    leftover;
+	pid_t    sess_id;
+	uint8_t  sess;
 };
 
 extern bool
@@ -51,6 +131,32 @@ svc_handle_evts(struct svc * svc, enum svc_evt evt, int status)
 	svc->handle_evts(svc, evt, status);
 }
 
+/*
+ * svc_handle_exit() - Handle termination of a service process.
+ *
+ * @svc:    the service owning the terminated process
+ * @pid:    PID of terminated process
+ * @status: exit status, or negated signal number if killed
+ *
+ * When @svc runs a group of start commands, exit is notified only once all
+ * group members have terminated. The reported status is then the one of the
+ * first member that failed, if any.
+ */
+extern void
+svc_handle_exit(struct svc * svc, pid_t pid, int status);
+
+/*
+ * svc_reap_leftover() - Go on stopping once processes left behind are gone.
+ *
+ * @svc: the service to check
+ *
+ * Meant to be called once processes which do not belong to any service have
+ * been reaped since processes left behind by a stopping service are reaped as
+ * such once orphaned.
+ */
+extern void
+svc_reap_leftover(struct svc * svc);
+
 /*
  * svc_register_starton_obsrv() - Register to service ready notifications
  * 
@@ -69,6 +175,28 @@ svc_register_starton_obsrv(struct svc * svc, struct svc * obsrv);
 extern void
 svc_register_stopon_obsrv(struct svc * svc, struct svc * obsrv);
 
+/*
+ * svc_wait() - Register to be woken up once service reaches a given state.
+ *
+ * @svc:    the service to wait for
+ * @waiter: the waiter to register
+ * @state:  the state to wait for
+ * @wake:   callback to run once @svc has switched to @state
+ */
+extern void
+svc_wait(struct svc *         svc,
+         struct svc_waiter *  waiter,
+         enum tinit_svc_state state,
+         svc_wake_fn *        wake);
+
+static inline void
+svc_unwait(struct svc_waiter * waiter)
+{
+	assert(waiter);
+
+	stroll_dlist_remove(&waiter->node);
+}
+
 extern void
 svc_start(struct svc * svc);
 
@@ -78,6 +206,126 @@ svc_stop(struct svc * svc);
 extern void
 svc_reload(const struct svc * svc);
 
+/*
+ * svc_reconf() - Switch a service to a new configuration.
+ *
+ * @svc:  the service to reconfigure
+ * @conf: the new configuration, ownership of which is transferred to @svc
+ *
+ * A stopped service is given @conf immediately. An active service is stopped
+ * first and restarted once @conf has been applied.
+ * In both cases, the caller is responsible for rewiring start / stop
+ * notifications since @conf may register different notifying services. See
+ * tinit_repo_rewire().
+ */
+extern void
+svc_reconf(struct svc * svc, const struct conf_svc * conf);
+
+/*
+ * svc_settle() - Apply a configuration change deferred till service stopped.
+ *
+ * @svc: the service to settle
+ *
+ * Applies the configuration given to svc_reconf() while @svc was active, then
+ * restarts it if required. Must be called from main loop, outside of any
+ * notification walk.
+ * As for svc_reconf(), the caller is responsible for rewiring start / stop
+ * notifications.
+ *
+ * Return: true if @svc was settled, false if nothing was pending.
+ */
+extern bool
+svc_settle(struct svc * svc);
+
+/*
+ * svc_kick() - Start an active service waiting for its starton notifiers.
+ *
+ * @svc: the service to kick
+ *
+ * Required after notifications rewiring since an active service may have been
+ * given new notifiers which are already ready.
+ */
+extern void
+svc_kick(struct svc * svc);
+
+/*
+ * svc_save() - Save service runtime state before init re-execution.
+ *
+ * @svc:  the service to save
+ * @snap: where to store @svc state
+ *
+ * File descriptors stored on behalf of @svc are made inheritable across
+ * execve().
+ *
+ * Return: PIDs of the @snap->grp_nr running start command group members, to
+ *         be saved along with @snap, NULL if none.
+ */
+extern const pid_t *
+svc_save(const struct svc * svc, struct svc_snap * snap);
+
+/*
+ * svc_restore() - Restore service runtime state after init re-execution.
+ *
+ * @svc:  a freshly created service
+ * @snap: the state saved by svc_save()
+ * @pids: the start command group members returned by svc_save()
+ *
+ * Return: 0 if successful, -EINVAL if @snap does not match @svc configuration,
+ *         -ENOMEM if group members cannot be tracked.
+ */
+extern int
+svc_restore(struct svc *          svc,
+            const struct svc_snap * snap,
+            const pid_t *           pids);
+
+/*
+ * svc_store_fds() - Keep file descriptors on behalf of a service
+ *
+ * @svc: the service to store file descriptors for
+ * @fds: file descriptors to store
+ * @nr:  number of file descriptors found into @fds
+ *
+ * Stored file descriptors are handed back to the next spawned service process.
+ * Ownership of stored file descriptors is transferred to @svc.
+ *
+ * Return: number of file descriptors stored, which may be less than @nr when
+ *         the store is full.
+ */
+extern unsigned int
+svc_store_fds(struct svc * svc, const int * fds, unsigned int nr);
+
+extern void
+svc_flush_fds(struct svc * svc);
+
+/*
+ * svc_search_bypid() - Find the service which process is given PID.
+ *
+ * @pid: PID of service process
+ *
+ * Service storage is scanned sequentially, regardless of repository order.
+ *
+ * Return: service if found, NULL otherwise.
+ */
+extern struct svc *
+svc_search_bypid(pid_t pid);
+
+/*
+ * svc_get_id() - Return the identifier of a service exposed to clients.
+ *
+ * @svc: the service to identify
+ *
+ * Identifier is made of the index of the service storage slot and of the
+ * generation of this slot, so that a service created into the slot of a
+ * destroyed one is given a distinct identifier.
+ */
+static inline uint32_t
+svc_get_id(const struct svc * svc)
+{
+	assert(svc);
+
+	return ((uint32_t)svc->gen << 16) | (uint32_t)svc->id;
+}
+
 extern struct svc *
 svc_create(const struct conf_svc * conf);
 
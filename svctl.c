@@ -4,7 +4,6 @@
 #endif /* _GNU_SOURCE */
 
 #include <tinit/tinit.h>
-#include "conf.h"
 #include <stdlib.h>
 #include <time.h>
 #include <stdio.h>
@@ -15,6 +14,9 @@
 
 #define VIEW_HEAD_COLOR "bold"
 
+/* Maximum time to wait for a service state (milliseconds). */
+#define WAIT_TMOUT      (30000U)
+
 #define err(_fmt, ...) \
 	fprintf(stderr, "%s: " _fmt ".\n", argv0, ## __VA_ARGS__)
 
@@ -38,7 +40,7 @@ view_new_row(struct libscols_table *          view,
 	assert(iter);
 
 	struct libscols_line * row;
-	struct conf_svc *      conf;
+	const char *           name;
 	enum tinit_svc_state   run;
 	static const char *    states[] = {
 		[TINIT_SVC_STOPPED_STAT]  = "stopped",
@@ -51,19 +53,10 @@ view_new_row(struct libscols_table *          view,
 	if (!row)
 		return NULL;
 
-	conf = tinit_get_status_conf(iter);
-	if (conf) {
-		int err;
-
-		err = scols_line_set_data(row, NAME_COL, conf_get_name(conf));
-		conf_destroy(conf);
-		if (err)
-			return NULL;
-	}
-	else {
-		if (scols_line_set_data(row, NAME_COL, "??"))
-			return NULL;
-	}
+	/* Extended status replies carry names: no need to parse config. */
+	name = tinit_get_status_name(iter);
+	if (scols_line_set_data(row, NAME_COL, name ? name : "??"))
+		return NULL;
 
 	//scols_line_set_color(row, CUTE_VIEW_SUITE_COLOR);
 	if (scols_line_set_data(row,
@@ -154,7 +147,7 @@ show_status(struct tinit_sock * sock, const char * svc_pattern)
 		return ret;
 	}
 
-	ret = tinit_load_status(sock, svc_pattern, ret, &iter);
+	ret = tinit_load_xstatus(sock, svc_pattern, ret, false, &iter);
 	if (ret) {
 		err("cannot load service status: %s (%d)",
 		    strerror(-ret),
@@ -222,10 +215,254 @@ do_svc_cmd(struct tinit_sock * sock,
 	return 0;
 }
 
+static int
+show_logs(struct tinit_sock * sock, const char * svc_name)
+{
+	ssize_t      ret;
+	const char * data;
+
+	ret = tinit_parse_svc_name(svc_name);
+	if (ret < 0) {
+		err("'%s': invalid service name", svc_name);
+		return (int)ret;
+	}
+
+	ret = tinit_load_logs(sock, svc_name, ret, &data);
+	if (ret < 0) {
+		err("'%s': cannot load service logs: %s (%zd)",
+		    svc_name,
+		    strerror(-ret),
+		    -ret);
+		return (int)ret;
+	}
+
+	if (ret && (fwrite(data, ret, 1, stdout) != 1)) {
+		err("cannot write service logs");
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static int
+wait_svc(struct tinit_sock * sock,
+         const char *        svc_name,
+         const char *        state_name)
+{
+	static const char * const states[] = {
+		[TINIT_SVC_STOPPED_STAT]  = "stopped",
+		[TINIT_SVC_STARTING_STAT] = "starting",
+		[TINIT_SVC_READY_STAT]    = "ready",
+		[TINIT_SVC_STOPPING_STAT] = "stopping"
+	};
+	unsigned int        state = TINIT_SVC_READY_STAT;
+	ssize_t             ret;
+
+	ret = tinit_parse_svc_name(svc_name);
+	if (ret < 0) {
+		err("'%s': invalid service name", svc_name);
+		return (int)ret;
+	}
+
+	if (state_name) {
+		for (state = 0; state < stroll_array_nr(states); state++)
+			if (!strcmp(state_name, states[state]))
+				break;
+
+		if (state == stroll_array_nr(states)) {
+			err("'%s': invalid service state", state_name);
+			return -EINVAL;
+		}
+	}
+
+	ret = tinit_wait_svc(sock, svc_name, ret, state, WAIT_TMOUT);
+	if (ret) {
+		err("'%s': cannot wait for %s service: %s (%zd)",
+		    svc_name,
+		    states[state],
+		    strerror(-ret),
+		    -ret);
+		return (int)ret;
+	}
+
+	return 0;
+}
+
+struct svc_name {
+	unsigned int id;
+	char *       name;
+};
+
+static void
+free_svc_names(struct svc_name * names, unsigned int nr)
+{
+	unsigned int n;
+
+	for (n = 0; n < nr; n++)
+		free(names[n].name);
+
+	free(names);
+}
+
+/*
+ * Build a table mapping service identifiers to service names. Returns the
+ * number of table entries or a negative errno-like value.
+ */
+static int
+load_svc_names(struct tinit_sock * sock, struct svc_name ** names)
+{
+	struct tinit_status_iter iter;
+	struct svc_name *        tbl = NULL;
+	unsigned int             nr = 0;
+	int                      ret;
+
+	ret = tinit_load_xstatus(sock, "*", 1, false, &iter);
+	if (ret) {
+		*names = NULL;
+		return (ret == -ENOENT) ? 0 : ret;
+	}
+
+	do {
+		struct svc_name * tmp;
+		const char *      name;
+
+		tmp = realloc(tbl, (nr + 1) * sizeof(*tbl));
+		if (!tmp) {
+			ret = -ENOMEM;
+			break;
+		}
+		tbl = tmp;
+
+		name = tinit_get_status_name(&iter);
+		tbl[nr].id = tinit_get_status_id(&iter);
+		tbl[nr].name = strdup(name ? name : "??");
+		if (!tbl[nr].name) {
+			ret = -ENOMEM;
+			break;
+		}
+		nr++;
+
+		ret = tinit_step_status(&iter);
+	} while (!ret);
+
+	if (ret != -ENOENT) {
+		free_svc_names(tbl, nr);
+		return ret;
+	}
+
+	*names = tbl;
+
+	return (int)nr;
+}
+
+static const char *
+find_svc_name(const struct svc_name * names, unsigned int nr, unsigned int id)
+{
+	unsigned int n;
+
+	for (n = 0; n < nr; n++) {
+		if (names[n].id == id)
+			return names[n].name;
+	}
+
+	return NULL;
+}
+
+static void
+show_event(const struct tinit_event * evt, const char * name)
+{
+	static const char * const evts[] = {
+		[TINIT_START_EVENT]  = "starting",
+		[TINIT_READY_EVENT]  = "ready",
+		[TINIT_STOP_EVENT]   = "stopping",
+		[TINIT_DOWN_EVENT]   = "stopped",
+		[TINIT_SPAWN_EVENT]  = "spawned",
+		[TINIT_EXIT_EVENT]   = "exited",
+		[TINIT_SIGNAL_EVENT] = "signaled"
+	};
+
+	printf("[%5llu.%06llu] ",
+	       (unsigned long long)(evt->tstamp / 1000000000ULL),
+	       (unsigned long long)((evt->tstamp % 1000000000ULL) / 1000ULL));
+
+	if (name)
+		printf("%s: ", name);
+	else
+		printf("#%u: ", evt->svc_id);
+
+	if (evt->id >= stroll_array_nr(evts)) {
+		printf("unknown event %u\n", evt->id);
+		return;
+	}
+
+	fputs(evts[evt->id], stdout);
+
+	switch (evt->id) {
+	case TINIT_SPAWN_EVENT:
+		printf(" [%u]", evt->pid);
+		break;
+
+	case TINIT_EXIT_EVENT:
+		if (evt->status >= 0)
+			printf(" [%u] with status %d", evt->pid, evt->status);
+		else
+			printf(" [%u] on signal %d", evt->pid, -evt->status);
+		break;
+
+	case TINIT_SIGNAL_EVENT:
+		printf(" [%u] with signal %d", evt->pid, evt->status);
+		break;
+	}
+
+	putchar('\n');
+}
+
+static int
+show_events(struct tinit_sock * sock)
+{
+	struct svc_name *          names;
+	int                        nr;
+	const struct tinit_event * evts;
+	int                        cnt;
+	int                        e;
+
+	/* Load names first since replies share the same buffer. */
+	nr = load_svc_names(sock, &names);
+	if (nr < 0) {
+		err("cannot load service names: %s (%d)", strerror(-nr), -nr);
+		return nr;
+	}
+
+	cnt = tinit_load_events(sock, &evts);
+	if (cnt < 0) {
+		err("cannot load events: %s (%d)", strerror(-cnt), -cnt);
+		free_svc_names(names, (unsigned int)nr);
+		return cnt;
+	}
+
+	for (e = 0; e < cnt; e++)
+		show_event(&evts[e],
+		           find_svc_name(names,
+		                         (unsigned int)nr,
+		                         evts[e].svc_id));
+
+	free_svc_names(names, (unsigned int)nr);
+
+	return 0;
+}
+
 static void
 usage(void)
 {
-	fprintf(stderr, "Usage: %s CMD\n", argv0);
+	fprintf(stderr,
+	        "Usage: %1$s status PATTERN\n"
+	        "       %1$s start|stop|restart|reload SERVICE\n"
+	        "       %1$s switch TARGET\n"
+	        "       %1$s daemon-reload\n"
+	        "       %1$s logs SERVICE\n"
+	        "       %1$s events\n"
+	        "       %1$s wait SERVICE [stopped|starting|ready|stopping]\n",
+	        argv0);
 }
 
 int
@@ -236,7 +473,10 @@ main(int argc, char * const argv[])
 
 	argv0 = basename(argv[0]);
 
-	if (argc != 3) {
+	if ((argc != 3) &&
+	    !((argc == 2) && (!strcmp(argv[1], "daemon-reload") ||
+	                      !strcmp(argv[1], "events"))) &&
+	    !((argc == 4) && !strcmp(argv[1], "wait"))) {
 		err("missing arguments");
 		usage();
 		return EXIT_FAILURE;
@@ -246,7 +486,18 @@ main(int argc, char * const argv[])
 	if (tinit_open_sock(&sock, (uint16_t)random()))
 		return EXIT_FAILURE;
 
-	if (!strcmp(argv[1], "status"))
+	if (argc == 2) {
+		if (!strcmp(argv[1], "events"))
+			err = show_events(&sock);
+		else {
+			err = tinit_reload_repo(&sock);
+			if (err)
+				err("cannot reload services: %s (%d)",
+				    strerror(-err),
+				    -err);
+		}
+	}
+	else if (!strcmp(argv[1], "status"))
 	    err = show_status(&sock, argv[2]);
 	else if (!strcmp(argv[1], "start"))
 	    err = do_svc_cmd(&sock, argv[2], "start", tinit_start_svc);
@@ -258,6 +509,10 @@ main(int argc, char * const argv[])
 	    err = do_svc_cmd(&sock, argv[2], "reload", tinit_reload_svc);
 	else if (!strcmp(argv[1], "switch"))
 	    err = do_svc_cmd(&sock, argv[2], "target", tinit_switch_target);
+	else if (!strcmp(argv[1], "logs"))
+	    err = show_logs(&sock, argv[2]);
+	else if (!strcmp(argv[1], "wait"))
+	    err = wait_svc(&sock, argv[2], (argc == 4) ? argv[3] : NULL);
 	else {
 		err("'%s': unknown command", argv[1]);
 		usage();
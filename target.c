@@ -1,12 +1,17 @@
+#include "target.h"
 #include "repo.h"
 #include "svc.h"
 #include "conf.h"
 #include "sigchan.h"
 #include "log.h"
+#include "watch.h"
+#include "preload.h"
+#include "notif.h"
 #include <utils/path.h>
 #include <dirent.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <time.h>
 #include <sys/types.h>
 
 /*
@@ -44,6 +49,36 @@
 	 (TINIT_SVC_NAME_MAX - 1) + \
 	 1)
 
+/* Name of the last successfully started target. */
+static char tinit_target_curr[TINIT_SVC_NAME_MAX];
+
+static void
+tinit_target_set_current(const char * name)
+{
+	assert(name);
+
+	if (name != tinit_target_curr) {
+		strncpy(tinit_target_curr, name, sizeof(tinit_target_curr) - 1);
+		tinit_target_curr[sizeof(tinit_target_curr) - 1] = '\0';
+	}
+
+	tinit_watch_target(CONFIG_TINIT_SYSCONFDIR, tinit_target_curr);
+}
+
+void
+tinit_target_resume(const char * name)
+{
+	assert(name);
+
+	tinit_target_set_current(name);
+}
+
+const char *
+tinit_target_current(void)
+{
+	return tinit_target_curr[0] ? tinit_target_curr : NULL;
+}
+
 struct tinit_target_folder {
 	DIR *  dir;
 	size_t dlen;
@@ -114,7 +149,7 @@ tinit_target_walk_folder(const struct tinit_target_folder * folder)
 	assert(folder->dpath[0] == '/');
 	assert(folder->spath);
 
-	const struct tinit_repo * repo;
+	struct tinit_repo * repo;
 
 	repo = tinit_repo_get();
 
@@ -159,7 +194,7 @@ tinit_target_walk_folder(const struct tinit_target_folder * folder)
 			continue;
 		}
 
-		svc = tinit_repo_search_bypath(repo, base);
+		svc = tinit_repo_fetch_bypath(repo, base);
 		if (svc)
 			return svc;
 
@@ -362,6 +397,10 @@ tinit_target_start(const char *           dir_path,
 	struct svc *             svc;
 
 	ret = tinit_target_init_iter(&iter, dir_path, name);
+
+	/* Target walk is over: release boot configurations left unused. */
+	tinit_preload_finish();
+
 	if (ret)
 		return ret;
 
@@ -376,9 +415,17 @@ tinit_target_start(const char *           dir_path,
 	if (ret)
 		goto fini;
 
+	/* Wire services loaded on demand while walking target. */
+	tinit_repo_rewire(tinit_repo_get());
+
 	tinit_target_foreach_svc(&iter, s, svc)
 		svc_start(svc);
 
+	tinit_target_set_current(name);
+
+	/* Load services unreachable from target once boot is over. */
+	tinit_repo_defer_complete(tinit_repo_get());
+
 	tinit_debug("%s/%s: target started.", dir_path, name);
 
 fini:
@@ -387,35 +434,349 @@ fini:
 	return ret;
 }
 
-void
-tinit_target_stop(struct tinit_sigchan * chan)
+/******************************************************************************
+ * Shutdown waves.
+ ******************************************************************************/
+
+/*
+ * At shutdown, services are stopped by waves derived from the starton graph
+ * so that consumers drain before their providers: wave 0 holds services no
+ * other running service starts on, and a provider always belongs to a wave
+ * following the ones of its consumers.
+ * Within a wave, services are stopped by priority class, least important class
+ * first. Services of a class are stopped in parallel. The next class, or the
+ * first class of the next wave, is stopped once all services of the current one
+ * have stopped, or CONFIG_TINIT_STOP_WAVE_TMOUT seconds after it was started
+ * so that a slow service cannot stall the whole shutdown.
+ * Explicit stopon ordering still applies on top of waves.
+ *
+ * When given a shutdown budget, time left is shared evenly among remaining
+ * classes of remaining waves, i.e. a class deadline may be shortened. Once the
+ * budget is exhausted, services still running are reported and the signal
+ * channel is closed so that tinit_killall() kills whatever is left.
+ */
+
+struct tinit_target_shutdown {
+	struct utimer timer;
+	struct utimer budget;
+	uint64_t      start;
+	uint64_t      end;
+	unsigned int  wave;
+	unsigned int  cls;
+	unsigned int  last;
+	bool          expired;
+};
+
+static struct tinit_target_shutdown tinit_target_shut;
+
+/* Least important services are requested to stop first within a wave. */
+static const enum conf_prio tinit_target_stop_order[] = {
+	CONF_IDLE_PRIO,
+	CONF_NORMAL_PRIO,
+	CONF_CRITICAL_PRIO
+};
+
+#define TINIT_TARGET_CLASS_NR stroll_array_nr(tinit_target_stop_order)
+
+/*
+ * Assign each service the wave it should be stopped with.
+ *
+ * Return: index of last wave.
+ */
+static unsigned int
+tinit_target_build_waves(struct tinit_repo * repo)
 {
-	struct tinit_repo * repo;
-	struct svc *        svc;
-	unsigned int        cnt = 0;
+	struct svc * svc;
+	unsigned int last = 0;
+	bool         changed;
+
+	tinit_repo_foreach(repo, svc)
+		svc->stop_wave = 0;
+
+	/*
+	 * Push providers behind their consumers till stable. Since starton
+	 * loops are rejected at registration time, this completes within as
+	 * many passes as the longest starton chain.
+	 */
+	do {
+		changed = false;
+
+		tinit_repo_foreach(repo, svc) {
+			unsigned int n;
+			struct svc * src;
+
+			if ((svc->state == TINIT_SVC_STOPPED_STAT) ||
+			    !svc->starton_notif)
+				continue;
+
+			notif_foreach_sink_poll_src(svc->starton_notif,
+			                            n,
+			                            src) {
+				if ((src->state == TINIT_SVC_STOPPED_STAT) ||
+				    (src->stop_wave > svc->stop_wave))
+					continue;
+
+				src->stop_wave = svc->stop_wave + 1;
+				if (src->stop_wave > last)
+					last = src->stop_wave;
+				changed = true;
+			}
+		}
+	} while (changed);
+
+	return last;
+}
+
+/* Return monotonic time in milliseconds. */
+static uint64_t
+tinit_target_now_msec(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return ((uint64_t)now.tv_sec * 1000ULL) +
+	       ((uint64_t)now.tv_nsec / 1000000ULL);
+}
+
+/*
+ * Report services of the current class of the current wave, or of all waves
+ * (@all), still not stopped.
+ */
+static void
+tinit_target_report_overrun(const struct tinit_target_shutdown * shut,
+                            struct tinit_repo *                  repo,
+                            bool                                 all)
+{
+	unsigned long long elapsed;
+	const struct svc * svc;
+
+	elapsed = (unsigned long long)
+	          (tinit_target_now_msec() - shut->start);
 
-	repo = tinit_repo_get();
 	tinit_repo_foreach(repo, svc) {
 		if (svc->state == TINIT_SVC_STOPPED_STAT)
 			continue;
 
+		if (!all &&
+		    ((svc->stop_wave != shut->wave) ||
+		     (conf_get_prio(svc->conf) !=
+		      tinit_target_stop_order[shut->cls])))
+			continue;
+
+		tinit_warn("%s: shutdown wave %u: still %s after %llu ms.",
+		           conf_get_name(svc->conf),
+		           svc->stop_wave,
+		           (svc->state == TINIT_SVC_STOPPING_STAT) ?
+		           "stopping" : "running",
+		           elapsed);
+	}
+}
+
+static bool
+tinit_target_class_stopped(struct tinit_repo * repo,
+                           unsigned int        wave,
+                           enum conf_prio      prio)
+{
+	const struct svc * svc;
+
+	tinit_repo_foreach(repo, svc) {
+		if ((svc->stop_wave == wave) &&
+		    (conf_get_prio(svc->conf) == prio) &&
+		    (svc->state != TINIT_SVC_STOPPED_STAT))
+			return false;
+	}
+
+	return true;
+}
+
+static bool
+tinit_target_all_stopped(struct tinit_repo * repo)
+{
+	const struct svc * svc;
+
+	tinit_repo_foreach(repo, svc) {
+		if (svc->state != TINIT_SVC_STOPPED_STAT)
+			return false;
+	}
+
+	return true;
+}
+
+static void
+tinit_target_stop_class(struct tinit_target_shutdown * shut,
+                        struct tinit_repo *            repo,
+                        unsigned int                   wave,
+                        unsigned int                   cls)
+{
+	assert(cls < TINIT_TARGET_CLASS_NR);
+
+	enum conf_prio prio = tinit_target_stop_order[cls];
+	unsigned long  tmout = CONFIG_TINIT_STOP_WAVE_TMOUT * 1000UL;
+	struct svc *   svc;
+
+	shut->wave = wave;
+	shut->cls = cls;
+
+	if (shut->end) {
+		uint64_t     now = tinit_target_now_msec();
+		uint64_t     share = 0;
+		unsigned int left;
+
+		/* Share time left among this class and the following ones. */
+		left = ((shut->last - wave) * TINIT_TARGET_CLASS_NR) +
+		       (TINIT_TARGET_CLASS_NR - cls);
+		if (now < shut->end)
+			share = (shut->end - now) / left;
+
+		if (share < tmout)
+			tmout = (unsigned long)share;
+	}
+
+	utimer_arm_msec(&shut->timer, tmout);
+
+	tinit_debug("shutdown: stopping wave %u class %u...", wave, cls);
+
+	tinit_repo_foreach(repo, svc) {
+		if ((svc->stop_wave != wave) ||
+		    (conf_get_prio(svc->conf) != prio))
+			continue;
+
 		if ((svc->state == TINIT_SVC_STARTING_STAT) ||
-		    (svc->state == TINIT_SVC_READY_STAT)) {
-			/* Stop active services. */
+		    (svc->state == TINIT_SVC_READY_STAT))
 			svc_stop(svc);
+	}
+}
 
-			/*
-			 * svc_stop() might have marked the service as
-			 * stopped.
-			 */
-			if (svc->state == TINIT_SVC_STOPPED_STAT)
-				continue;
-		}
+static bool
+tinit_target_is_last_class(const struct tinit_target_shutdown * shut)
+{
+	return (shut->wave == shut->last) &&
+	       (shut->cls == (TINIT_TARGET_CLASS_NR - 1));
+}
+
+/* Move on to next class of current wave, or to first class of next wave. */
+static void
+tinit_target_stop_next(struct tinit_target_shutdown * shut,
+                       struct tinit_repo *            repo)
+{
+	assert(!tinit_target_is_last_class(shut));
 
-		cnt++;
+	if (shut->cls < (TINIT_TARGET_CLASS_NR - 1))
+		tinit_target_stop_class(shut, repo, shut->wave, shut->cls + 1);
+	else
+		tinit_target_stop_class(shut, repo, shut->wave + 1, 0);
+}
+
+/*
+ * Move on to following classes and waves as long as the current class is over.
+ *
+ * Return: true once all services are stopped, false otherwise.
+ */
+static bool
+tinit_target_step_stop(void)
+{
+	struct tinit_target_shutdown * shut = &tinit_target_shut;
+	struct tinit_repo *            repo = tinit_repo_get();
+
+	if (shut->expired)
+		/* Budget exhausted: remaining processes are to be killed. */
+		return true;
+
+	while (!tinit_target_is_last_class(shut) &&
+	       tinit_target_class_stopped(repo,
+	                                  shut->wave,
+	                                  tinit_target_stop_order[shut->cls]))
+		tinit_target_stop_next(shut, repo);
+
+	if (!tinit_target_all_stopped(repo))
+		return false;
+
+	utimer_cancel(&shut->timer);
+	utimer_cancel(&shut->budget);
+
+	tinit_info("shutdown: services stopped in %llu ms.",
+	           (unsigned long long)(tinit_target_now_msec() - shut->start));
+
+	return true;
+}
+
+static void
+tinit_target_expire_wave(struct utimer * timer)
+{
+	struct tinit_target_shutdown * shut =
+		containerof(timer, struct tinit_target_shutdown, timer);
+
+	if (!tinit_target_is_last_class(shut)) {
+		tinit_warn("shutdown: wave %u class %u deadline expired.",
+		           shut->wave,
+		           shut->cls);
+		tinit_target_report_overrun(shut, tinit_repo_get(), false);
+		tinit_target_stop_next(shut, tinit_repo_get());
 	}
 
-	tinit_sigchan_stop(chan, cnt);
+	if (tinit_target_step_stop())
+		/*
+		 * Services may have stopped without any child process being
+		 * reaped: wake signal channel up so that it closes.
+		 */
+		tinit_sigchan_defer();
+}
+
+static void
+tinit_target_expire_budget(struct utimer * timer)
+{
+	struct tinit_target_shutdown * shut =
+		containerof(timer, struct tinit_target_shutdown, budget);
+
+	tinit_warn("shutdown: budget exhausted, "
+	           "killing remaining processes...");
+	tinit_target_report_overrun(shut, tinit_repo_get(), true);
+
+	utimer_cancel(&shut->timer);
+	shut->expired = true;
+
+	/* See tinit_target_expire_wave(). */
+	tinit_sigchan_defer();
+}
+
+void
+tinit_target_stop(struct tinit_sigchan * chan, unsigned int budget)
+{
+	struct tinit_target_shutdown * shut = &tinit_target_shut;
+	struct tinit_repo *            repo;
+	struct svc *                   svc;
+
+	repo = tinit_repo_get();
+
+	/* Do not restart services being reconfigured. */
+	tinit_repo_foreach(repo, svc)
+		svc->restart = false;
+
+	utimer_init(&shut->timer);
+	utimer_setup(&shut->timer, tinit_target_expire_wave);
+	utimer_init(&shut->budget);
+	utimer_setup(&shut->budget, tinit_target_expire_budget);
+
+	shut->start = tinit_target_now_msec();
+	shut->end = 0;
+	shut->expired = false;
+	if (budget) {
+		shut->end = shut->start + (budget * 1000ULL);
+		utimer_arm_sec(&shut->budget, budget);
+	}
+
+	shut->last = tinit_target_build_waves(repo);
+
+	tinit_debug("shutdown: %u wave(s) to stop.", shut->last + 1);
+
+	tinit_target_stop_class(shut, repo, 0, 0);
+
+	tinit_sigchan_stop(chan, tinit_target_step_stop);
+
+	if (tinit_target_step_stop())
+		/* Nothing to wait for: see tinit_target_expire_wave(). */
+		tinit_sigchan_defer();
 }
 
 int
@@ -426,6 +787,11 @@ tinit_target_switch(const char * dir_path, const char * name)
 	struct svc *              svc;
 	int                       ret;
 
+	/* Target may include services not loaded at boot time. */
+	ret = tinit_repo_complete(tinit_repo_get());
+	if (ret)
+		return ret;
+
 	ret = tinit_target_init_iter(&iter, dir_path, name);
 	if (ret)
 		return ret;
@@ -463,6 +829,8 @@ tinit_target_switch(const char * dir_path, const char * name)
 		}
 	}
 
+	tinit_target_set_current(name);
+
 	tinit_debug("%s/%s: target started.", dir_path, name);
 
 fini:
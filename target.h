@@ -10,10 +10,33 @@ tinit_target_start(const char *           dir_path,
                    struct tinit_sigchan * chan,
                    const struct upoll *   poller);
 
+/*
+ * tinit_target_stop() - Stop all services at shutdown time.
+ *
+ * @chan:   signal channel to switch to shutdown mode
+ * @budget: maximum number of seconds granted to services to stop, 0 meaning
+ *          no limit
+ */
 extern void
-tinit_target_stop(struct tinit_sigchan * chan);
+tinit_target_stop(struct tinit_sigchan * chan, unsigned int budget);
 
 extern int
 tinit_target_switch(const char * dir_path, const char * name);
 
+/*
+ * tinit_target_resume() - Mark target as current without starting it.
+ *
+ * @name: name of target already running, i.e. before init re-execution.
+ */
+extern void
+tinit_target_resume(const char * name);
+
+/*
+ * tinit_target_current() - Return name of the last started target.
+ *
+ * Return: target name or NULL if no target has been started yet.
+ */
+extern const char *
+tinit_target_current(void);
+
 #endif /* _TINIT_TARGET_H */
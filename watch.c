@@ -0,0 +1,301 @@
+#include "watch.h"
+#include "repo.h"
+#include "target.h"
+#include "log.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+#include <sys/inotify.h>
+
+#define TINIT_WATCH_SVC_EVTS \
+	(IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_ONLYDIR)
+
+#define TINIT_WATCH_TARGET_EVTS \
+	(IN_CREATE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_ONLYDIR)
+
+/*
+ * Maximum number of service configuration file names processed at once. Extra
+ * events trigger a full reload.
+ */
+#define TINIT_WATCH_NAMES_NR (32U)
+
+struct tinit_watch {
+	struct upoll_worker work;
+	int                 fd;
+	int                 svc_wd;
+	int                 conf_wd;
+	int                 target_wd;
+	const char *        target_dir;
+	char                target_name[TINIT_SVC_NAME_MAX];
+};
+
+static struct tinit_watch tinit_watch_inst = {
+	.fd        = -1,
+	.svc_wd    = -1,
+	.conf_wd   = -1,
+	.target_wd = -1
+};
+
+struct tinit_watch_batch {
+	unsigned int nr;
+	const char * names[TINIT_WATCH_NAMES_NR];
+	bool         reload;
+	bool         target;
+	bool         rewatch;
+};
+
+static int
+tinit_watch_add(const struct tinit_watch * watch,
+                const char *               path,
+                uint32_t                   mask)
+{
+	assert(watch);
+	assert(watch->fd >= 0);
+	assert(path);
+	assert(mask);
+
+	int wd;
+
+	wd = inotify_add_watch(watch->fd, path, mask);
+	if (wd < 0) {
+		int err = errno;
+
+		assert(err != EBADF);
+		assert(err != EFAULT);
+
+		tinit_warn("watch: '%s': cannot monitor directory: %s (%d).",
+		           path,
+		           strerror(err),
+		           err);
+		return -err;
+	}
+
+	return wd;
+}
+
+static void
+tinit_watch_rewatch_target(struct tinit_watch * watch)
+{
+	assert(watch);
+	assert(watch->fd >= 0);
+
+	char * path;
+
+	if (watch->target_wd >= 0) {
+		inotify_rm_watch(watch->fd, watch->target_wd);
+		watch->target_wd = -1;
+	}
+
+	if (!watch->target_dir || !watch->target_name[0])
+		return;
+
+	if (asprintf(&path,
+	             "%s/%s",
+	             watch->target_dir,
+	             watch->target_name) < 0) {
+		tinit_warn("watch: cannot monitor target: %s (%d).",
+		           strerror(ENOMEM),
+		           ENOMEM);
+		return;
+	}
+
+	/* inotify_add_watch() follows symbolic links, i.e. 'current' one. */
+	watch->target_wd = tinit_watch_add(watch,
+	                                   path,
+	                                   TINIT_WATCH_TARGET_EVTS);
+
+	free(path);
+}
+
+void
+tinit_watch_target(const char * dir_path, const char * name)
+{
+	assert(dir_path);
+	assert(name);
+
+	struct tinit_watch * watch = &tinit_watch_inst;
+
+	watch->target_dir = dir_path;
+	if (name != watch->target_name) {
+		strncpy(watch->target_name, name, sizeof(watch->target_name) - 1);
+		watch->target_name[sizeof(watch->target_name) - 1] = '\0';
+	}
+
+	if (watch->fd >= 0)
+		tinit_watch_rewatch_target(watch);
+}
+
+static void
+tinit_watch_process_evt(struct tinit_watch *           watch,
+                        const struct inotify_event *   evt,
+                        struct tinit_watch_batch *     batch)
+{
+	assert(watch);
+	assert(evt);
+	assert(batch);
+
+	if (evt->mask & IN_Q_OVERFLOW) {
+		/* Events lost: rescan everything. */
+		batch->reload = true;
+		batch->target = true;
+		return;
+	}
+
+	if (evt->wd == watch->svc_wd) {
+		if (!evt->len || (evt->mask & IN_ISDIR))
+			return;
+
+		if (batch->nr < stroll_array_nr(batch->names))
+			batch->names[batch->nr++] = evt->name;
+		else
+			batch->reload = true;
+	}
+	else if (evt->wd == watch->conf_wd) {
+		/* Target symbolic link / directory replaced. */
+		if (evt->len &&
+		    !strncmp(evt->name,
+		             watch->target_name,
+		             sizeof(watch->target_name))) {
+			batch->target = true;
+			batch->rewatch = true;
+		}
+	}
+	else if (evt->wd == watch->target_wd) {
+		if (evt->mask & IN_IGNORED)
+			/* Target directory removed. */
+			watch->target_wd = -1;
+		else
+			batch->target = true;
+	}
+}
+
+static int
+tinit_watch_dispatch(struct upoll_worker * worker,
+                     uint32_t              state __unused,
+                     const struct upoll *  poller __unused)
+{
+	assert(worker);
+	assert(state & EPOLLIN);
+	assert(!(state & EPOLLOUT));
+	assert(!(state & EPOLLRDHUP));
+	assert(!(state & EPOLLPRI));
+	assert(poller);
+
+	struct tinit_watch *     watch = containerof(worker,
+	                                             struct tinit_watch,
+	                                             work);
+	struct tinit_watch_batch batch = { 0, };
+	struct tinit_repo *      repo = tinit_repo_get();
+	union {
+		char                 buff[4096];
+		struct inotify_event align;
+	}                        evts;
+	const char *             buff = evts.buff;
+
+	while (true) {
+		ssize_t                      ret;
+		const struct inotify_event * evt;
+
+		ret = read(watch->fd, evts.buff, sizeof(evts.buff));
+		if (ret < 0) {
+			assert(errno != EBADF);
+			assert(errno != EFAULT);
+			assert(errno != EINVAL);
+
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		batch.nr = 0;
+		for (evt = (const struct inotify_event *)buff;
+		     (const char *)evt < &buff[ret];
+		     evt = (const struct inotify_event *)
+		           ((const char *)evt + sizeof(*evt) + evt->len))
+			tinit_watch_process_evt(watch, evt, &batch);
+
+		/* Event names point into buff: apply them before next read. */
+		if (batch.nr && !batch.reload)
+			tinit_repo_update(repo, batch.names, batch.nr);
+	}
+
+	if (batch.reload)
+		tinit_repo_reload(repo);
+
+	if (batch.target) {
+		if (batch.rewatch)
+			tinit_watch_rewatch_target(watch);
+
+		if (watch->target_dir && watch->target_name[0])
+			tinit_target_switch(watch->target_dir,
+			                    watch->target_name);
+	}
+
+	return 0;
+}
+
+int
+tinit_watch_open(const struct upoll * poller)
+{
+	assert(poller);
+
+	struct tinit_watch * watch = &tinit_watch_inst;
+	int                  err;
+
+	watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (watch->fd < 0) {
+		err = -errno;
+		goto err;
+	}
+
+	watch->svc_wd = tinit_watch_add(watch,
+	                                CONFIG_TINIT_INCLUDE_DIR,
+	                                TINIT_WATCH_SVC_EVTS);
+	if (watch->svc_wd < 0) {
+		err = watch->svc_wd;
+		goto close;
+	}
+
+	/* Failing to monitor targets is not fatal. */
+	watch->conf_wd = tinit_watch_add(watch,
+	                                 CONFIG_TINIT_SYSCONFDIR,
+	                                 TINIT_WATCH_TARGET_EVTS);
+	tinit_watch_rewatch_target(watch);
+
+	watch->work.dispatch = tinit_watch_dispatch;
+	err = upoll_register(poller, watch->fd, EPOLLIN, &watch->work);
+	if (err)
+		goto close;
+
+	tinit_debug("watch: opened.");
+
+	return 0;
+
+close:
+	close(watch->fd);
+	watch->fd = -1;
+err:
+	tinit_err("watch: cannot open: %s (%d).", strerror(-err), -err);
+
+	return err;
+}
+
+void
+tinit_watch_close(const struct upoll * poller)
+{
+	assert(poller);
+
+	struct tinit_watch * watch = &tinit_watch_inst;
+
+	if (watch->fd < 0)
+		return;
+
+	upoll_unregister(poller, watch->fd);
+	close(watch->fd);
+
+	watch->fd = -1;
+	watch->svc_wd = -1;
+	watch->conf_wd = -1;
+	watch->target_wd = -1;
+}
@@ -0,0 +1,33 @@
+#ifndef _TINIT_WATCH_H
+#define _TINIT_WATCH_H
+
+#include "common.h"
+#include <utils/poll.h>
+
+/*
+ * Configuration watcher.
+ *
+ * Monitors CONFIG_TINIT_INCLUDE_DIR, CONFIG_TINIT_SYSCONFDIR and the current
+ * target directory using inotify so that service configuration and target
+ * changes are applied without rebooting.
+ */
+
+extern int
+tinit_watch_open(const struct upoll * poller);
+
+extern void
+tinit_watch_close(const struct upoll * poller);
+
+/*
+ * tinit_watch_target() - Monitor content of the given target directory.
+ *
+ * @dir_path: path to directory holding targets
+ * @name:     name of target to monitor
+ *
+ * May be called before tinit_watch_open(), in which case monitoring will start
+ * at opening time.
+ */
+extern void
+tinit_watch_target(const char * dir_path, const char * name);
+
+#endif /* _TINIT_WATCH_H */